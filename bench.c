@@ -0,0 +1,289 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <json_generator.h>
+
+#define BENCH_SAMPLES       4096
+#define BENCH_ITERATIONS    200
+#define BENCH_BUF_SIZE      4096
+
+static float samples[BENCH_SAMPLES];
+static size_t flushed_len;
+static size_t flush_calls;
+
+static void flush_count(char *buf, void *priv)
+{
+    flushed_len += strlen(buf);
+    flush_calls++;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Sensor like readings, Eg. temperatures between -20 and 60 with 2 decimals */
+static void bench_init_samples(void)
+{
+    uint32_t seed = 12345;
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        seed = seed * 1103515245 + 12345;
+        samples[i] = (float)((int)((seed >> 8) % 8000) - 2000) / 100.0f;
+    }
+}
+
+/* Replica of the original snprintf based json_gen_arr_set_float(), for comparison */
+static void bench_snprintf_array(char *buf, size_t buf_size)
+{
+    char *free_ptr = buf;
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        char str[30];
+        snprintf(str, sizeof(str), "%s%.*f", i ? "," : "", JSON_FLOAT_PRECISION, samples[i]);
+        size_t len = strlen(str);
+        if ((size_t)(free_ptr - buf) + len >= buf_size) {
+            *free_ptr = '\0';
+            flush_count(buf, NULL);
+            free_ptr = buf;
+        }
+        memcpy(free_ptr, str, len);
+        free_ptr += len;
+    }
+    *free_ptr = '\0';
+    flush_count(buf, NULL);
+}
+
+static void bench_json_gen_array(char *buf, size_t buf_size, json_gen_float_fmt_t fmt, bool is_double)
+{
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, buf_size, flush_count, NULL);
+    json_gen_str_set_float_format(&jstr, fmt, JSON_FLOAT_PRECISION);
+    json_gen_start_array(&jstr);
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        if (is_double) {
+            json_gen_arr_set_double(&jstr, samples[i]);
+        } else {
+            json_gen_arr_set_float(&jstr, samples[i]);
+        }
+    }
+    json_gen_end_array(&jstr);
+    json_gen_str_end(&jstr);
+}
+
+#define BENCH_RECORDS       2000
+#define BENCH_ARRAY_LEN     256
+#define BENCH_FIELDS        32
+#define BENCH_NESTING       32
+
+static const size_t bench_buf_sizes[] = {64, 512, 4096, 65536};
+
+typedef struct {
+    uint64_t bytes;
+    uint64_t flushes;
+} bench_counts_t;
+
+static int flush_count_v2(const char *buf, size_t len, void *priv)
+{
+    bench_counts_t *counts = (bench_counts_t *)priv;
+    counts->bytes += len;
+    counts->flushes++;
+    return 0;
+}
+
+/* Each workload generates one record and returns the number of values added */
+typedef size_t (*bench_workload_t)(json_gen_str_t *jstr, int record);
+
+static size_t bench_ints(json_gen_str_t *jstr, int record)
+{
+    json_gen_start_array(jstr);
+    for (int i = 0; i < BENCH_ARRAY_LEN; i++) {
+        json_gen_arr_set_int(jstr, (record * 7919 + i * 104729) % 2000000 - 1000000);
+    }
+    json_gen_end_array(jstr);
+    return BENCH_ARRAY_LEN;
+}
+
+static size_t bench_floats(json_gen_str_t *jstr, int record)
+{
+    json_gen_start_array(jstr);
+    for (int i = 0; i < BENCH_ARRAY_LEN; i++) {
+        json_gen_arr_set_double(jstr, samples[(record + i) % BENCH_SAMPLES]);
+    }
+    json_gen_end_array(jstr);
+    return BENCH_ARRAY_LEN;
+}
+
+static const char *bench_names[BENCH_FIELDS] = {
+    "id", "name", "email", "city", "country", "zip", "phone", "company",
+    "title", "dept", "manager", "status", "created", "updated", "owner", "group",
+    "tag0", "tag1", "tag2", "tag3", "tag4", "tag5", "tag6", "tag7",
+    "note0", "note1", "note2", "note3", "note4", "note5", "note6", "note7",
+};
+
+static size_t bench_add_strings(json_gen_str_t *jstr, const char *val)
+{
+    json_gen_start_object(jstr);
+    for (int i = 0; i < BENCH_FIELDS; i++) {
+        json_gen_obj_set_string(jstr, bench_names[i], val);
+    }
+    json_gen_end_object(jstr);
+    return BENCH_FIELDS;
+}
+
+static size_t bench_strings(json_gen_str_t *jstr, int record)
+{
+    return bench_add_strings(jstr, "The quick brown fox jumps over the lazy dog");
+}
+
+static size_t bench_strings_escaped(json_gen_str_t *jstr, int record)
+{
+    json_gen_str_set_escape(jstr, true);
+    return bench_add_strings(jstr, "The \"quick\" brown fox\njumps over the \\lazy\\ dog");
+}
+
+static size_t bench_nested(json_gen_str_t *jstr, int record)
+{
+    json_gen_start_object(jstr);
+    for (int i = 0; i < BENCH_NESTING; i++) {
+        json_gen_obj_set_int(jstr, "level", i);
+        json_gen_push_object(jstr, "child");
+    }
+    json_gen_obj_set_int(jstr, "leaf", record);
+    for (int i = 0; i <= BENCH_NESTING; i++) {
+        json_gen_end_object(jstr);
+    }
+    return BENCH_NESTING + 1;
+}
+
+static char wide_names[BENCH_ARRAY_LEN][16];
+
+static size_t bench_wide(json_gen_str_t *jstr, int record)
+{
+    json_gen_start_object(jstr);
+    for (int i = 0; i < BENCH_ARRAY_LEN; i++) {
+        json_gen_obj_set_int(jstr, wide_names[i], record + i);
+    }
+    json_gen_end_object(jstr);
+    return BENCH_ARRAY_LEN;
+}
+
+static const struct {
+    const char *name;
+    bench_workload_t run;
+} bench_workloads[] = {
+    {"int", bench_ints},
+    {"float", bench_floats},
+    {"string", bench_strings},
+    {"string_escaped", bench_strings_escaped},
+    {"nested", bench_nested},
+    {"wide", bench_wide},
+};
+
+static void bench_print_row(const char *workload, size_t buf_size, uint64_t records, uint64_t ops,
+        const bench_counts_t *counts, uint64_t elapsed_ns)
+{
+    double secs = elapsed_ns / 1e9;
+    printf("%s,%zu,%llu,%llu,%llu,%llu,%.2f,%.0f,%.2f\n", workload, buf_size,
+            (unsigned long long)records, (unsigned long long)ops,
+            (unsigned long long)counts->bytes, (unsigned long long)counts->flushes,
+            (double)elapsed_ns / ops, records / secs, counts->bytes / secs / 1e6);
+}
+
+/* Records are generated as newline delimited JSON in a single JSON string, so that
+ * the flushes depend only on the buffer size
+ */
+static void bench_run_workload(size_t w, char *buf, size_t buf_size)
+{
+    bench_counts_t counts = {0};
+    json_gen_str_t jstr;
+    uint64_t ops = 0;
+    json_gen_str_start_v2(&jstr, buf, buf_size, flush_count_v2, &counts);
+    uint64_t start = now_ns();
+    for (int r = 0; r < BENCH_RECORDS; r++) {
+        json_gen_record_begin(&jstr);
+        ops += bench_workloads[w].run(&jstr, r);
+        json_gen_record_end(&jstr);
+    }
+    json_gen_str_end(&jstr);
+    bench_print_row(bench_workloads[w].name, buf_size, BENCH_RECORDS, ops, &counts,
+            now_ns() - start);
+}
+
+/* Comparison of the float formatting against the original snprintf based implementation */
+static void bench_run_floats(char *buf, size_t buf_size)
+{
+    static const struct {
+        const char *name;
+        json_gen_float_fmt_t fmt;
+        bool is_double;
+    } cases[] = {
+        {"float_fixed", JSON_GEN_FLOAT_FMT_FIXED, false},
+        {"float_shortest", JSON_GEN_FLOAT_FMT_SHORTEST, false},
+        {"double_shortest", JSON_GEN_FLOAT_FMT_SHORTEST, true},
+    };
+    uint64_t ops = (uint64_t)BENCH_SAMPLES * BENCH_ITERATIONS;
+    bench_counts_t counts = {0};
+    flushed_len = 0;
+    flush_calls = 0;
+    uint64_t start = now_ns();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        bench_snprintf_array(buf, buf_size);
+    }
+    counts.bytes = flushed_len;
+    counts.flushes = flush_calls;
+    bench_print_row("float_snprintf", buf_size, BENCH_ITERATIONS, ops, &counts, now_ns() - start);
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        flushed_len = 0;
+        flush_calls = 0;
+        start = now_ns();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            bench_json_gen_array(buf, buf_size, cases[c].fmt, cases[c].is_double);
+        }
+        counts.bytes = flushed_len;
+        counts.flushes = flush_calls;
+        bench_print_row(cases[c].name, buf_size, BENCH_ITERATIONS, ops, &counts, now_ns() - start);
+    }
+}
+
+/* Output is CSV, for tracking over time. An optional argument selects a single workload */
+int main(int argc, char **argv)
+{
+    static char buf[65536];
+    const char *only = argc > 1 ? argv[1] : NULL;
+    bench_init_samples();
+    for (int i = 0; i < BENCH_ARRAY_LEN; i++) {
+        snprintf(wide_names[i], sizeof(wide_names[i]), "field_%d", i);
+    }
+    printf("workload,buf_size,records,ops,bytes,flushes,ns_per_op,records_per_s,mb_per_s\n");
+    for (size_t w = 0; w < sizeof(bench_workloads) / sizeof(bench_workloads[0]); w++) {
+        if (only && strcmp(only, bench_workloads[w].name) != 0) {
+            continue;
+        }
+        for (size_t b = 0; b < sizeof(bench_buf_sizes) / sizeof(bench_buf_sizes[0]); b++) {
+            bench_run_workload(w, buf, bench_buf_sizes[b]);
+        }
+    }
+    if (!only || strcmp(only, "float_cmp") == 0) {
+        bench_run_floats(buf, BENCH_BUF_SIZE);
+    }
+    return 0;
+}
@@ -15,314 +15,4288 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <math.h>
+#ifdef JSON_GEN_ENABLE_STATS
+#include <time.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #include <json_generator.h>
 
 #define MAX_INT_IN_STR  	24
 #define MAX_FLOAT_IN_STR 	30
 
-static inline int json_gen_get_empty_len(json_gen_str_t *jstr)
+static inline size_t json_gen_get_empty_len(json_gen_str_t *jstr)
+{
+	return jstr->end_ptr - jstr->free_ptr;
+}
+
+/* Returns a pointer to the free space in the buffer if at least len bytes are
+ * available without flushing, else NULL. The data written there must be
+ * accounted for by json_gen_advance()
+ */
+static inline char *json_gen_get_space(json_gen_str_t *jstr, size_t len)
+{
+	if (jstr->buf && len <= json_gen_get_empty_len(jstr)) {
+		return jstr->free_ptr;
+	}
+	return NULL;
+}
+
+static inline void json_gen_advance(json_gen_str_t *jstr, size_t len)
+{
+	jstr->free_ptr += len;
+	jstr->total_len += len;
+}
+
+/* Instrumentation, compiled in only with JSON_GEN_ENABLE_STATS */
+#ifdef JSON_GEN_ENABLE_STATS
+static uint64_t json_gen_stats_now_ns(void)
+{
+	struct timespec ts;
+#ifdef CLOCK_MONOTONIC
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+	timespec_get(&ts, TIME_UTC);
+#endif
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline void json_gen_stats_value(json_gen_str_t *jstr, uint64_t start)
+{
+	if (jstr->total_len - start > jstr->stats.max_value_len) {
+		jstr->stats.max_value_len = jstr->total_len - start;
+	}
+}
+
+static inline void json_gen_stats_open(json_gen_str_t *jstr)
+{
+	if (++jstr->stats_depth > jstr->stats.max_depth) {
+		jstr->stats.max_depth = jstr->stats_depth;
+	}
+}
+
+static inline void json_gen_stats_close(json_gen_str_t *jstr)
+{
+	if (jstr->stats_depth) {
+		jstr->stats_depth--;
+	}
+}
+
+#define json_gen_stats_copied(jstr, len) ((jstr)->stats.bytes_copied += (len))
+
+/* Wraps the body of a value setter and returns its result */
+#define JSON_GEN_MEASURE_VALUE(jstr, call) \
+	uint64_t value_start = (jstr)->total_len; \
+	int ret = (call); \
+	json_gen_stats_value(jstr, value_start); \
+	return ret
+#else /* !JSON_GEN_ENABLE_STATS */
+#define json_gen_stats_now_ns() 0
+#define json_gen_stats_value(jstr, start)
+#define json_gen_stats_open(jstr)
+#define json_gen_stats_close(jstr)
+#define json_gen_stats_copied(jstr, len)
+#define JSON_GEN_MEASURE_VALUE(jstr, call) return (call)
+#endif /* !JSON_GEN_ENABLE_STATS */
+
+/* The usable part of the buffer ends either at the end of the buffer or at the
+ * point where the maximum length would be reached, whichever is earlier. This
+ * way, the fast paths need not check the maximum length separately.
+ */
+static inline void json_gen_update_end_ptr(json_gen_str_t *jstr)
+{
+	uint64_t allowed = jstr->max_len - jstr->total_len;
+	jstr->end_ptr = jstr->buf_end;
+	if (allowed < (uint64_t)(jstr->buf_end - jstr->free_ptr)) {
+		jstr->end_ptr = jstr->free_ptr + allowed;
+	}
+}
+
+/* Errors are sticky. No more data is accepted once an error is set */
+static int json_gen_set_error(json_gen_str_t *jstr, int err)
+{
+	jstr->err = err;
+	jstr->end_ptr = jstr->free_ptr;
+	return err;
+}
+
+/* JSON_GEN_AGAIN only reports the backpressure of a non blocking output. The data
+ * has still been accepted, so calls adding several values carry on, and report it
+ * at the end.
+ */
+#define json_gen_failed(ret) ((ret) != 0 && (ret) != JSON_GEN_AGAIN)
+
+static inline int json_gen_keep_again(int prev, int ret)
+{
+	return prev == JSON_GEN_AGAIN && ret == 0 ? JSON_GEN_AGAIN : ret;
+}
+
+/* The public calls report JSON_GEN_AGAIN as long as data is waiting in the spill
+ * buffer, whichever internal write hit the backpressure, Eg. one within a name.
+ */
+static inline int json_gen_result(json_gen_str_t *jstr, int ret)
+{
+	return ret == 0 && jstr->spill_sent != jstr->spill_len ? JSON_GEN_AGAIN : ret;
+}
+
+/* Switch to the buffer provided by a sink */
+static inline void json_gen_set_buf(json_gen_str_t *jstr, char *buf, size_t buf_size)
+{
+	jstr->buf = buf;
+	jstr->buf_size = buf_size;
+	jstr->free_ptr = buf;
+	jstr->buf_end = buf + buf_size;
+	json_gen_update_end_ptr(jstr);
+}
+
+static int json_gen_growable_flush(json_gen_sink_t *sink, const char *data, size_t len,
+		size_t need, char **buf, size_t *buf_size);
+
+static inline bool json_gen_is_growable(json_gen_str_t *jstr)
+{
+	return jstr->sink && jstr->sink->flush == json_gen_growable_flush;
+}
+
+/* With record aligned flushes, the incomplete record at the end of the buffer is
+ * held back and carried over to the start of the next buffer. So are open MessagePack
+ * headers, which get updated at the end. This is skipped if it would leave no
+ * space, for growable buffers, which keep all the data anyway, and for non blocking
+ * outputs, which may write out any part of the buffer.
+ */
+static size_t json_gen_get_carry(json_gen_str_t *jstr, size_t need)
+{
+	size_t carry = 0;
+	if (jstr->record_aligned && jstr->record_end) {
+		carry = jstr->free_ptr - jstr->record_end;
+	}
+	if (jstr->bin_depth) {
+		uint64_t back = jstr->total_len - jstr->bin_levels[0].pos;
+		if (back <= (uint64_t)(jstr->free_ptr - jstr->buf) && back > carry) {
+			carry = (size_t)back;
+		}
+	}
+	if (!carry || json_gen_is_growable(jstr) || jstr->write_cb) {
+		return 0;
+	}
+	if (!jstr->sink && carry + need >= (size_t)(jstr->buf_end - jstr->buf)) {
+		return 0;
+	}
+	return carry;
+}
+
+/* Write as much as the non blocking output takes, till it would block */
+static int64_t json_gen_async_send(json_gen_str_t *jstr, const char *data, size_t len)
+{
+	size_t sent = 0;
+	while (sent < len) {
+		int64_t n = jstr->write_cb(data + sent, len - sent, jstr->priv);
+		if (n < 0 || (uint64_t)n > len - sent) {
+			return -1;
+		}
+		if (n == 0) {
+			break;
+		}
+		sent += (size_t)n;
+	}
+	return (int64_t)sent;
+}
+
+/* Write out the spill buffer, if there is anything in it */
+static int json_gen_async_drain(json_gen_str_t *jstr)
+{
+	if (jstr->spill_sent == jstr->spill_len) {
+		return 0;
+	}
+	int64_t n = json_gen_async_send(jstr, jstr->spill + jstr->spill_sent,
+			jstr->spill_len - jstr->spill_sent);
+	if (n < 0) {
+		return json_gen_set_error(jstr, -1);
+	}
+	jstr->spill_sent += (size_t)n;
+	if (jstr->spill_sent < jstr->spill_len) {
+		return JSON_GEN_AGAIN;
+	}
+	jstr->spill_len = jstr->spill_sent = 0;
+	return 0;
+}
+
+static int json_gen_async_spill(json_gen_str_t *jstr, const char *data, size_t len)
+{
+	if (jstr->spill_sent) {
+		jstr->spill_len -= jstr->spill_sent;
+		memmove(jstr->spill, jstr->spill + jstr->spill_sent, jstr->spill_len);
+		jstr->spill_sent = 0;
+	}
+	if (len > jstr->spill_cap - jstr->spill_len) {
+		size_t cap = jstr->spill_cap ? jstr->spill_cap : len;
+		while (cap - jstr->spill_len < len) {
+			cap *= 2;
+		}
+		char *spill = realloc(jstr->spill, cap);
+		if (!spill) {
+			return json_gen_set_error(jstr, -1);
+		}
+		jstr->spill = spill;
+		jstr->spill_cap = cap;
+	}
+	memcpy(jstr->spill + jstr->spill_len, data, len);
+	jstr->spill_len += len;
+	return 0;
+}
+
+/* Write out len bytes at the start of the buffer to the non blocking output, after
+ * whatever is already waiting. The rest is spilled, so that the whole buffer can be
+ * used again right away.
+ */
+static int json_gen_async_write(json_gen_str_t *jstr, size_t len)
+{
+	int64_t sent = 0;
+	int ret = json_gen_async_drain(jstr);
+	if (ret == 0) {
+		sent = json_gen_async_send(jstr, jstr->buf, len);
+		if (sent < 0) {
+			return json_gen_set_error(jstr, -1);
+		}
+	} else if (ret != JSON_GEN_AGAIN) {
+		return ret;
+	}
+	if ((size_t)sent < len && json_gen_async_spill(jstr, jstr->buf + sent, len - sent) != 0) {
+		return jstr->err;
+	}
+	jstr->free_ptr = jstr->buf;
+	return jstr->spill_len ? JSON_GEN_AGAIN : 0;
+}
+
+/* Pass len bytes at the start of the buffer on to the flush callback or the sink.
+ * A new buffer from the sink must have space for the carry and need bytes.
+ */
+static int json_gen_flush_out(json_gen_str_t *jstr, size_t len, size_t need, size_t carry)
+{
+	if (jstr->write_cb) {
+		return json_gen_async_write(jstr, len);
+	}
+	if (jstr->sink) {
+		char *buf = NULL;
+		size_t buf_size = 0;
+		if (jstr->sink->flush(jstr->sink, jstr->buf, len, need + carry, &buf, &buf_size) != 0 ||
+				!buf || buf_size < carry + (need ? need : 1)) {
+			return json_gen_set_error(jstr, -1);
+		}
+		json_gen_set_buf(jstr, buf, buf_size);
+	} else {
+		if (jstr->flush_cb_v2) {
+			if (jstr->flush_cb_v2(jstr->buf, len, jstr->priv) != 0) {
+				return json_gen_set_error(jstr, -1);
+			}
+		} else {
+			/* Report error if the buffer is full and no flush callback
+			 * is registered
+			 */
+			if (!jstr->flush_cb) {
+				*jstr->free_ptr = '\0';
+				return -1;
+			}
+			char saved = jstr->buf[len];
+			jstr->buf[len] = '\0';
+			jstr->flush_cb(jstr->buf, jstr->priv);
+			jstr->buf[len] = saved;
+		}
+		jstr->free_ptr = jstr->buf;
+	}
+	return 0;
+}
+
+/* Flush out the data in the buffer and start afresh. For sinks, need is the
+ * minimum space required in the new buffer.
+ */
+static int json_gen_flush(json_gen_str_t *jstr, size_t need)
+{
+	if (jstr->err) {
+		return jstr->err;
+	}
+	size_t carry = json_gen_get_carry(jstr, need);
+	size_t len = jstr->free_ptr - jstr->buf - carry;
+	const char *carry_ptr = jstr->buf + len;
+#ifdef JSON_GEN_ENABLE_STATS
+	uint64_t flush_start = json_gen_stats_now_ns();
+	int ret = json_gen_flush_out(jstr, len, need, carry);
+	jstr->stats.flushes += !json_gen_failed(ret);
+	jstr->stats.flush_ns += json_gen_stats_now_ns() - flush_start;
+#else
+	int ret = json_gen_flush_out(jstr, len, need, carry);
+#endif
+	if (json_gen_failed(ret)) {
+		return ret;
+	}
+	if (carry) {
+		memmove(jstr->buf, carry_ptr, carry);
+		jstr->free_ptr += carry;
+	}
+	jstr->record_end = NULL;
+	json_gen_update_end_ptr(jstr);
+	return ret;
+}
+
+/* Slow path of json_gen_add_to_str_n(), taken only when the incoming data
+ * does not fit in the space left in the buffer. The buffer is filled up
+ * completely and flushed out as many times as required.
+ */
+static int json_gen_add_to_str_slow(json_gen_str_t *jstr, const char *str, size_t len)
+{
+	if (jstr->err) {
+		return jstr->err;
+	}
+	uint64_t allowed = jstr->max_len - jstr->total_len;
+	if (len > allowed) {
+		/* Output whatever fits, so that exactly max_len bytes get flushed out */
+		if (allowed && json_gen_failed(json_gen_add_to_str_slow(jstr, str, allowed))) {
+			return jstr->err;
+		}
+		return json_gen_set_error(jstr, JSON_GEN_ERR_LIMIT);
+	}
+	if (jstr->buf == NULL) {
+		jstr->total_len += len;
+		return 0;
+	}
+	int ret = 0;
+	while (1) {
+		size_t len_remaining = json_gen_get_empty_len(jstr);
+		size_t copy_len = len_remaining > len ? len : len_remaining;
+		memcpy(jstr->free_ptr, str, copy_len);
+		json_gen_stats_copied(jstr, copy_len);
+		str += copy_len;
+		json_gen_advance(jstr, copy_len);
+		len -= copy_len;
+		if (len) {
+			ret = json_gen_keep_again(ret, json_gen_flush(jstr, 1));
+			if (json_gen_failed(ret)) {
+				return ret;
+			}
+		} else
+			break;
+	}
+	return ret;
+}
+
+/* This will add the incoming string of given length to the JSON string
+ * buffer and flush it out if the buffer is full. Note that the data being
+ * flushed out will always be equal to the size of the buffer unless
+ * this is the last chunk being flushed out on json_gen_end_str()
+ */
+static inline int json_gen_add_to_str_n(json_gen_str_t *jstr, const char *str, size_t len)
+{
+	if (len <= json_gen_get_empty_len(jstr) && jstr->buf) {
+		if (len) {
+			memcpy(jstr->free_ptr, str, len);
+			json_gen_stats_copied(jstr, len);
+			json_gen_advance(jstr, len);
+		}
+		return 0;
+	}
+	return json_gen_add_to_str_slow(jstr, str, len);
+}
+
+/* Pass data straight to the output, if it can take data from outside the buffers */
+static int json_gen_bypass_out(json_gen_str_t *jstr, const char *data, size_t len)
+{
+	if (jstr->write_cb) {
+		int64_t sent = 0;
+		if (jstr->spill_len == jstr->spill_sent) {
+			sent = json_gen_async_send(jstr, data, len);
+		}
+		if (sent < 0 || ((size_t)sent < len &&
+					json_gen_async_spill(jstr, data + sent, len - sent) != 0)) {
+			return json_gen_set_error(jstr, -1);
+		}
+		return jstr->spill_len ? JSON_GEN_AGAIN : 0;
+	}
+	if (jstr->sink) {
+		return jstr->sink->write(jstr->sink, data, len) == 0 ? 0 : json_gen_set_error(jstr, -1);
+	}
+	return jstr->flush_cb_v2(data, len, jstr->priv) == 0 ? 0 : json_gen_set_error(jstr, -1);
+}
+
+/* Large pre-formatted data is not copied through the buffer, if the output can
+ * take it directly. The buffer is flushed out first, to keep the order.
+ */
+static int json_gen_add_raw(json_gen_str_t *jstr, const char *data, size_t len)
+{
+	bool direct = jstr->write_cb || (jstr->sink ? jstr->sink->write != NULL :
+			jstr->flush_cb_v2 != NULL);
+	if (!direct || !jstr->buf || len < (size_t)(jstr->buf_end - jstr->buf) || jstr->err ||
+			jstr->record_aligned || jstr->bin_depth || len > jstr->max_len - jstr->total_len) {
+		return json_gen_add_to_str_n(jstr, data, len);
+	}
+	int ret = 0;
+	if (jstr->free_ptr != jstr->buf) {
+		ret = json_gen_flush(jstr, 1);
+		if (json_gen_failed(ret)) {
+			return ret;
+		}
+	}
+	ret = json_gen_keep_again(ret, json_gen_bypass_out(jstr, data, len));
+	if (json_gen_failed(ret)) {
+		return ret;
+	}
+	jstr->total_len += len;
+	json_gen_update_end_ptr(jstr);
+	return ret;
+}
+
+/* Same as json_gen_add_to_str_n(), but for the NULL terminated strings */
+static int json_gen_add_to_str(json_gen_str_t *jstr, const char *str)
+{
+	if (!str) {
+		return 0;
+	}
+	return json_gen_add_to_str_n(jstr, str, strlen(str));
+}
+
+/* Fast path for the single character structural tokens like , { } [ ] */
+static inline int json_gen_add_char(json_gen_str_t *jstr, char c)
+{
+	if (json_gen_get_empty_len(jstr) > 0) {
+		*jstr->free_ptr++ = c;
+		jstr->total_len++;
+		return 0;
+	}
+	return json_gen_add_to_str_slow(jstr, &c, 1);
+}
+
+/* For string literals, the length is known at compile time */
+#define json_gen_add_literal(jstr, lit) \
+	json_gen_add_to_str_n(jstr, lit, sizeof(lit) - 1)
+
+static const char json_gen_digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static inline int json_gen_u32_digits(uint32_t val)
+{
+	if (val < 10) return 1;
+	if (val < 100) return 2;
+	if (val < 1000) return 3;
+	if (val < 10000) return 4;
+	if (val < 100000) return 5;
+	if (val < 1000000) return 6;
+	if (val < 10000000) return 7;
+	if (val < 100000000) return 8;
+	if (val < 1000000000) return 9;
+	return 10;
+}
+
+static inline int json_gen_u64_digits(uint64_t val)
+{
+	int digits = 0;
+	while (val > UINT32_MAX) {
+		val /= 100000000;
+		digits += 8;
+	}
+	return digits + json_gen_u32_digits((uint32_t)val);
+}
+
+/* Write the digits of val backwards from end, two at a time */
+static inline void json_gen_write_u32_digits(char *end, uint32_t val)
+{
+	while (val >= 100) {
+		uint32_t idx = (val % 100) * 2;
+		val /= 100;
+		end -= 2;
+		memcpy(end, &json_gen_digit_pairs[idx], 2);
+	}
+	if (val >= 10) {
+		memcpy(end - 2, &json_gen_digit_pairs[val * 2], 2);
+	} else {
+		*--end = (char)('0' + val);
+	}
+}
+
+/* Format an unsigned number into out, which should have space for at least
+ * MAX_INT_IN_STR bytes. Returns the number of bytes written. No NULL termination
+ * is added.
+ */
+static size_t json_gen_fmt_u64(char *out, uint64_t val)
+{
+	if (val <= UINT32_MAX) {
+		int len = json_gen_u32_digits((uint32_t)val);
+		json_gen_write_u32_digits(out + len, (uint32_t)val);
+		return len;
+	}
+	int len = json_gen_u64_digits(val);
+	char *end = out + len;
+	while (val > UINT32_MAX) {
+		uint32_t lo = (uint32_t)(val % 100000000);
+		val /= 100000000;
+		/* Lower 8 digits, including any leading zeros */
+		for (int i = 0; i < 4; i++) {
+			end -= 2;
+			memcpy(end, &json_gen_digit_pairs[(lo % 100) * 2], 2);
+			lo /= 100;
+		}
+	}
+	json_gen_write_u32_digits(end, (uint32_t)val);
+	return len;
+}
+
+static size_t json_gen_fmt_i64(char *out, int64_t val)
+{
+	if (val < 0) {
+		*out = '-';
+		return 1 + json_gen_fmt_u64(out + 1, (uint64_t)0 - (uint64_t)val);
+	}
+	return json_gen_fmt_u64(out, (uint64_t)val);
+}
+
+/* Add a formatted number to the JSON string. The number is formatted straight
+ * into the buffer if there is enough room for the longest possible number. Else,
+ * it is formatted into a scratch buffer and added from there so that it can be
+ * split across a flush.
+ */
+static int json_gen_add_number(json_gen_str_t *jstr, uint64_t val, bool is_signed)
+{
+	char str[MAX_INT_IN_STR];
+	char *p = json_gen_get_space(jstr, MAX_INT_IN_STR);
+	size_t len;
+	if (is_signed) {
+		len = json_gen_fmt_i64(p ? p : str, (int64_t)val);
+	} else {
+		len = json_gen_fmt_u64(p ? p : str, val);
+	}
+	if (p) {
+		json_gen_advance(jstr, len);
+		return 0;
+	}
+	return json_gen_add_to_str_n(jstr, str, len);
+}
+
+/* Shortest round-trip formatting of floating point numbers, based on the Grisu2
+ * algorithm from "Printing Floating-Point Numbers Quickly and Accurately with
+ * Integers" by Florian Loitsch. The output always reads back to the same value
+ * and is the shortest such representation in almost all cases.
+ */
+typedef struct {
+	uint64_t f;
+	int e;
+} json_gen_diyfp_t;
+
+typedef struct {
+	uint64_t f;
+	int e;
+	int k;
+} json_gen_cached_power_t;
+
+#define JSON_GEN_GRISU_ALPHA            (-60)
+#define JSON_GEN_CACHED_POWERS_MIN_EXP  (-300)
+#define JSON_GEN_CACHED_POWERS_STEP     8
+
+/* Normalized 64 bit approximations of 10^k for k = -300, -292, ..., 324 */
+static const json_gen_cached_power_t json_gen_cached_powers[] = {
+	{ 0xAB70FE17C79AC6CAULL, -1060,  -300 },
+	{ 0xFF77B1FCBEBCDC4FULL, -1034,  -292 },
+	{ 0xBE5691EF416BD60CULL, -1007,  -284 },
+	{ 0x8DD01FAD907FFC3CULL,  -980,  -276 },
+	{ 0xD3515C2831559A83ULL,  -954,  -268 },
+	{ 0x9D71AC8FADA6C9B5ULL,  -927,  -260 },
+	{ 0xEA9C227723EE8BCBULL,  -901,  -252 },
+	{ 0xAECC49914078536DULL,  -874,  -244 },
+	{ 0x823C12795DB6CE57ULL,  -847,  -236 },
+	{ 0xC21094364DFB5637ULL,  -821,  -228 },
+	{ 0x9096EA6F3848984FULL,  -794,  -220 },
+	{ 0xD77485CB25823AC7ULL,  -768,  -212 },
+	{ 0xA086CFCD97BF97F4ULL,  -741,  -204 },
+	{ 0xEF340A98172AACE5ULL,  -715,  -196 },
+	{ 0xB23867FB2A35B28EULL,  -688,  -188 },
+	{ 0x84C8D4DFD2C63F3BULL,  -661,  -180 },
+	{ 0xC5DD44271AD3CDBAULL,  -635,  -172 },
+	{ 0x936B9FCEBB25C996ULL,  -608,  -164 },
+	{ 0xDBAC6C247D62A584ULL,  -582,  -156 },
+	{ 0xA3AB66580D5FDAF6ULL,  -555,  -148 },
+	{ 0xF3E2F893DEC3F126ULL,  -529,  -140 },
+	{ 0xB5B5ADA8AAFF80B8ULL,  -502,  -132 },
+	{ 0x87625F056C7C4A8BULL,  -475,  -124 },
+	{ 0xC9BCFF6034C13053ULL,  -449,  -116 },
+	{ 0x964E858C91BA2655ULL,  -422,  -108 },
+	{ 0xDFF9772470297EBDULL,  -396,  -100 },
+	{ 0xA6DFBD9FB8E5B88FULL,  -369,   -92 },
+	{ 0xF8A95FCF88747D94ULL,  -343,   -84 },
+	{ 0xB94470938FA89BCFULL,  -316,   -76 },
+	{ 0x8A08F0F8BF0F156BULL,  -289,   -68 },
+	{ 0xCDB02555653131B6ULL,  -263,   -60 },
+	{ 0x993FE2C6D07B7FACULL,  -236,   -52 },
+	{ 0xE45C10C42A2B3B06ULL,  -210,   -44 },
+	{ 0xAA242499697392D3ULL,  -183,   -36 },
+	{ 0xFD87B5F28300CA0EULL,  -157,   -28 },
+	{ 0xBCE5086492111AEBULL,  -130,   -20 },
+	{ 0x8CBCCC096F5088CCULL,  -103,   -12 },
+	{ 0xD1B71758E219652CULL,   -77,    -4 },
+	{ 0x9C40000000000000ULL,   -50,     4 },
+	{ 0xE8D4A51000000000ULL,   -24,    12 },
+	{ 0xAD78EBC5AC620000ULL,     3,    20 },
+	{ 0x813F3978F8940984ULL,    30,    28 },
+	{ 0xC097CE7BC90715B3ULL,    56,    36 },
+	{ 0x8F7E32CE7BEA5C70ULL,    83,    44 },
+	{ 0xD5D238A4ABE98068ULL,   109,    52 },
+	{ 0x9F4F2726179A2245ULL,   136,    60 },
+	{ 0xED63A231D4C4FB27ULL,   162,    68 },
+	{ 0xB0DE65388CC8ADA8ULL,   189,    76 },
+	{ 0x83C7088E1AAB65DBULL,   216,    84 },
+	{ 0xC45D1DF942711D9AULL,   242,    92 },
+	{ 0x924D692CA61BE758ULL,   269,   100 },
+	{ 0xDA01EE641A708DEAULL,   295,   108 },
+	{ 0xA26DA3999AEF774AULL,   322,   116 },
+	{ 0xF209787BB47D6B85ULL,   348,   124 },
+	{ 0xB454E4A179DD1877ULL,   375,   132 },
+	{ 0x865B86925B9BC5C2ULL,   402,   140 },
+	{ 0xC83553C5C8965D3DULL,   428,   148 },
+	{ 0x952AB45CFA97A0B3ULL,   455,   156 },
+	{ 0xDE469FBD99A05FE3ULL,   481,   164 },
+	{ 0xA59BC234DB398C25ULL,   508,   172 },
+	{ 0xF6C69A72A3989F5CULL,   534,   180 },
+	{ 0xB7DCBF5354E9BECEULL,   561,   188 },
+	{ 0x88FCF317F22241E2ULL,   588,   196 },
+	{ 0xCC20CE9BD35C78A5ULL,   614,   204 },
+	{ 0x98165AF37B2153DFULL,   641,   212 },
+	{ 0xE2A0B5DC971F303AULL,   667,   220 },
+	{ 0xA8D9D1535CE3B396ULL,   694,   228 },
+	{ 0xFB9B7CD9A4A7443CULL,   720,   236 },
+	{ 0xBB764C4CA7A44410ULL,   747,   244 },
+	{ 0x8BAB8EEFB6409C1AULL,   774,   252 },
+	{ 0xD01FEF10A657842CULL,   800,   260 },
+	{ 0x9B10A4E5E9913129ULL,   827,   268 },
+	{ 0xE7109BFBA19C0C9DULL,   853,   276 },
+	{ 0xAC2820D9623BF429ULL,   880,   284 },
+	{ 0x80444B5E7AA7CF85ULL,   907,   292 },
+	{ 0xBF21E44003ACDD2DULL,   933,   300 },
+	{ 0x8E679C2F5E44FF8FULL,   960,   308 },
+	{ 0xD433179D9C8CB841ULL,   986,   316 },
+	{ 0x9E19DB92B4E31BA9ULL,  1013,   324 }
+};
+
+static inline json_gen_diyfp_t json_gen_diyfp(uint64_t f, int e)
+{
+	json_gen_diyfp_t x = {f, e};
+	return x;
+}
+
+/* Returns (x * y) / 2^64, rounded */
+static json_gen_diyfp_t json_gen_diyfp_mul(json_gen_diyfp_t x, json_gen_diyfp_t y)
+{
+	uint64_t u_lo = x.f & 0xFFFFFFFFu, u_hi = x.f >> 32;
+	uint64_t v_lo = y.f & 0xFFFFFFFFu, v_hi = y.f >> 32;
+	uint64_t p0 = u_lo * v_lo;
+	uint64_t p1 = u_lo * v_hi;
+	uint64_t p2 = u_hi * v_lo;
+	uint64_t p3 = u_hi * v_hi;
+	uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+	q += (uint64_t)1 << 31;
+	uint64_t h = p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32);
+	return json_gen_diyfp(h, x.e + y.e + 64);
+}
+
+static inline json_gen_diyfp_t json_gen_diyfp_normalize(json_gen_diyfp_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	int shift = __builtin_clzll(x.f);
+	x.f <<= shift;
+	x.e -= shift;
+#else
+	while ((x.f >> 63) == 0) {
+		x.f <<= 1;
+		x.e--;
+	}
+#endif
+	return x;
+}
+
+/* Compute the normalized value along with the boundaries m- and m+ of the
+ * interval of numbers which round to it. The boundaries share the exponent of m+.
+ * precision is the number of significand bits, including the hidden bit.
+ */
+static void json_gen_compute_boundaries(uint64_t bits, int precision, int bias,
+		json_gen_diyfp_t *m_minus, json_gen_diyfp_t *v, json_gen_diyfp_t *m_plus)
+{
+	const uint64_t hidden_bit = (uint64_t)1 << (precision - 1);
+	const uint64_t biased_e = bits >> (precision - 1);
+	const uint64_t fraction = bits & (hidden_bit - 1);
+	json_gen_diyfp_t val;
+	if (biased_e == 0) {
+		val = json_gen_diyfp(fraction, 1 - bias);
+	} else {
+		val = json_gen_diyfp(fraction + hidden_bit, (int)biased_e - bias);
+	}
+	/* The lower boundary is closer if the significand is a power of two */
+	bool lower_closer = (fraction == 0 && biased_e > 1);
+	json_gen_diyfp_t plus = json_gen_diyfp_normalize(json_gen_diyfp(2 * val.f + 1, val.e - 1));
+	json_gen_diyfp_t minus = lower_closer ?
+			json_gen_diyfp(4 * val.f - 1, val.e - 2) :
+			json_gen_diyfp(2 * val.f - 1, val.e - 1);
+	minus.f <<= (minus.e - plus.e);
+	minus.e = plus.e;
+	*m_minus = minus;
+	*v = json_gen_diyfp_normalize(val);
+	*m_plus = plus;
+}
+
+static json_gen_cached_power_t json_gen_get_cached_power(int e)
+{
+	/* Find k such that alpha <= e + 64 + cached.e, rounding up to the step */
+	const int f = JSON_GEN_GRISU_ALPHA - e - 1;
+	const int k = (f * 78913) / (1 << 18) + (f > 0);
+	const int index = (-JSON_GEN_CACHED_POWERS_MIN_EXP + k + (JSON_GEN_CACHED_POWERS_STEP - 1))
+			/ JSON_GEN_CACHED_POWERS_STEP;
+	return json_gen_cached_powers[index];
+}
+
+static inline int json_gen_find_largest_pow10(uint32_t n, uint32_t *pow10)
+{
+	static const uint32_t pow10s[] = {1, 10, 100, 1000, 10000, 100000, 1000000,
+			10000000, 100000000, 1000000000};
+	int digits = json_gen_u32_digits(n);
+	*pow10 = pow10s[digits - 1];
+	return digits;
+}
+
+static void json_gen_grisu2_round(char *buf, int len, uint64_t dist, uint64_t delta,
+		uint64_t rest, uint64_t ten_k)
+{
+	while (rest < dist && delta - rest >= ten_k &&
+			(rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+		buf[len - 1]--;
+		rest += ten_k;
+	}
+}
+
+/* Generate the shortest digits of w which lie within (m-, m+) */
+static int json_gen_grisu2_digit_gen(char *buf, int *decimal_exponent,
+		json_gen_diyfp_t m_minus, json_gen_diyfp_t w, json_gen_diyfp_t m_plus)
+{
+	uint64_t delta = m_plus.f - m_minus.f;
+	uint64_t dist = m_plus.f - w.f;
+	const int shift = -m_plus.e;
+	const uint64_t one = (uint64_t)1 << shift;
+	uint32_t p1 = (uint32_t)(m_plus.f >> shift);
+	uint64_t p2 = m_plus.f & (one - 1);
+	int len = 0;
+	uint32_t pow10;
+	int n = json_gen_find_largest_pow10(p1, &pow10);
+
+	/* Integral part */
+	while (n > 0) {
+		uint32_t d = p1 / pow10;
+		p1 %= pow10;
+		buf[len++] = (char)('0' + d);
+		n--;
+		uint64_t rest = ((uint64_t)p1 << shift) + p2;
+		if (rest <= delta) {
+			*decimal_exponent += n;
+			json_gen_grisu2_round(buf, len, dist, delta, rest, (uint64_t)pow10 << shift);
+			return len;
+		}
+		pow10 /= 10;
+	}
+
+	/* Fractional part */
+	int m = 0;
+	while (1) {
+		p2 *= 10;
+		buf[len++] = (char)('0' + (p2 >> shift));
+		p2 &= one - 1;
+		m++;
+		delta *= 10;
+		dist *= 10;
+		if (p2 <= delta) {
+			break;
+		}
+	}
+	*decimal_exponent -= m;
+	json_gen_grisu2_round(buf, len, dist, delta, p2, one);
+	return len;
+}
+
+/* Generates the digits of a positive, finite, non zero number into buf. The
+ * value is buf * 10^decimal_exponent. Returns the number of digits.
+ */
+static int json_gen_grisu2(char *buf, int *decimal_exponent, uint64_t bits,
+		int precision, int bias)
+{
+	json_gen_diyfp_t m_minus, v, m_plus;
+	json_gen_compute_boundaries(bits, precision, bias, &m_minus, &v, &m_plus);
+	json_gen_cached_power_t cached = json_gen_get_cached_power(m_plus.e);
+	json_gen_diyfp_t c_minus_k = json_gen_diyfp(cached.f, cached.e);
+	json_gen_diyfp_t w = json_gen_diyfp_mul(v, c_minus_k);
+	json_gen_diyfp_t w_minus = json_gen_diyfp_mul(m_minus, c_minus_k);
+	json_gen_diyfp_t w_plus = json_gen_diyfp_mul(m_plus, c_minus_k);
+	/* Move the boundaries inwards to account for the rounding errors */
+	w_minus.f++;
+	w_plus.f--;
+	*decimal_exponent = -cached.k;
+	return json_gen_grisu2_digit_gen(buf, decimal_exponent, w_minus, w, w_plus);
+}
+
+/* Convert the digits and decimal exponent generated by grisu2 into the final
+ * representation, using the exponent notation only for very large or small
+ * numbers. buf should have space for at least MAX_FLOAT_IN_STR bytes.
+ */
+static size_t json_gen_format_digits(char *buf, int len, int decimal_exponent, int max_exp)
+{
+	const int k = len;
+	const int n = len + decimal_exponent;
+
+	if (k <= n && n <= max_exp) {
+		/* digits[000].0 */
+		memset(buf + k, '0', n - k);
+		buf[n] = '.';
+		buf[n + 1] = '0';
+		return n + 2;
+	}
+	if (0 < n && n <= max_exp) {
+		/* dig.its */
+		memmove(buf + n + 1, buf + n, k - n);
+		buf[n] = '.';
+		return k + 1;
+	}
+	if (-4 < n && n <= 0) {
+		/* 0.[000]digits */
+		memmove(buf + 2 - n, buf, k);
+		buf[0] = '0';
+		buf[1] = '.';
+		memset(buf + 2, '0', -n);
+		return 2 - n + k;
+	}
+	/* d.igitse[-]x */
+	size_t pos = 1;
+	if (k > 1) {
+		memmove(buf + 2, buf + 1, k - 1);
+		buf[1] = '.';
+		pos = k + 1;
+	}
+	buf[pos++] = 'e';
+	int exp = n - 1;
+	if (exp < 0) {
+		buf[pos++] = '-';
+		exp = -exp;
+	}
+	pos += json_gen_fmt_u64(buf + pos, (uint64_t)exp);
+	return pos;
+}
+
+static size_t json_gen_fmt_double_shortest(char *out, double val)
+{
+	uint64_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	char *p = out;
+	if (bits >> 63) {
+		*p++ = '-';
+		bits &= ~((uint64_t)1 << 63);
+	}
+	if (bits == 0) {
+		memcpy(p, "0.0", 3);
+		return (p - out) + 3;
+	}
+	int decimal_exponent;
+	int len = json_gen_grisu2(p, &decimal_exponent, bits, 53, 1075);
+	return (p - out) + json_gen_format_digits(p, len, decimal_exponent, 15);
+}
+
+static size_t json_gen_fmt_float_shortest(char *out, float val)
+{
+	uint32_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	char *p = out;
+	if (bits >> 31) {
+		*p++ = '-';
+		bits &= ~((uint32_t)1 << 31);
+	}
+	if (bits == 0) {
+		memcpy(p, "0.0", 3);
+		return (p - out) + 3;
+	}
+	int decimal_exponent;
+	int len = json_gen_grisu2(p, &decimal_exponent, bits, 24, 150);
+	return (p - out) + json_gen_format_digits(p, len, decimal_exponent, 6);
+}
+
+static const uint64_t json_gen_pow10_u64[JSON_GEN_MAX_FLOAT_PRECISION + 1] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+	100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+	1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+	1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL
+};
+
+/* Fixed point formatting with the given number of digits after the decimal point,
+ * rounded like printf() does, on the exact value, with ties to even. Numbers too large
+ * to be scaled to a 64 bit integer fall back to the shortest representation, of a
+ * float if is_double is false.
+ */
+static size_t json_gen_fmt_fixed(char *out, double val, int precision, bool is_double)
+{
+	char *p = out;
+	double pow10 = (double)json_gen_pow10_u64[precision];
+	double scaled = fabs(val) * pow10;
+	if (!(scaled < 9.2e18)) {
+		return is_double ? json_gen_fmt_double_shortest(out, val) :
+				json_gen_fmt_float_shortest(out, (float)val);
+	}
+	double whole = floor(scaled);
+	uint64_t r = (uint64_t)whole;
+	double diff = scaled - whole - 0.5;
+	/* The rounding error of the product matters only close to a tie. It is exactly
+	 * given by fma(), as the powers of 10 are exact doubles.
+	 */
+	if (fabs(diff) > scaled * 0x1p-52) {
+		r += diff > 0;
+	} else if (scaled >= 0x1p53) {
+		/* whole is even, so the ties of the error round the same */
+		r += (int64_t)nearbyint(fma(fabs(val), pow10, -scaled));
+	} else {
+		double err = fma(fabs(val), pow10, -scaled);
+		if (diff > -err || (diff == -err && (r & 1))) {
+			r++;
+		} else if (diff == -0.5 && err == -0.5 && (r & 1)) {
+			r--;
+		}
+	}
+	if (signbit(val)) {
+		*p++ = '-';
+	}
+	p += json_gen_fmt_u64(p, r / json_gen_pow10_u64[precision]);
+	if (precision > 0) {
+		uint64_t frac = r % json_gen_pow10_u64[precision];
+		*p++ = '.';
+		char *end = p + precision;
+		while (end > p) {
+			*--end = (char)('0' + frac % 10);
+			frac /= 10;
+		}
+		p += precision;
+	}
+	return p - out;
+}
+
+/* Format the number as per the float format configured for the JSON string.
+ * is_double is false for single precision values. Non finite numbers cannot be
+ * represented in JSON and are emitted as null.
+ */
+static size_t json_gen_fmt_real(json_gen_str_t *jstr, char *out, double val, bool is_double)
+{
+	if (!isfinite(val)) {
+		memcpy(out, "null", 4);
+		return 4;
+	}
+	switch (jstr->float_fmt) {
+		case JSON_GEN_FLOAT_FMT_FIXED:
+			return json_gen_fmt_fixed(out, val, jstr->float_precision, is_double);
+		case JSON_GEN_FLOAT_FMT_SHORTEST:
+			break;
+		case JSON_GEN_FLOAT_FMT_AUTO:
+		default:
+			if (!is_double) {
+				return json_gen_fmt_fixed(out, val, jstr->float_precision, false);
+			}
+			break;
+	}
+	if (is_double) {
+		return json_gen_fmt_double_shortest(out, val);
+	}
+	return json_gen_fmt_float_shortest(out, (float)val);
+}
+
+/* Same as json_gen_add_number(), for floating point numbers */
+static int json_gen_add_real(json_gen_str_t *jstr, double val, bool is_double)
+{
+	char str[MAX_FLOAT_IN_STR];
+	char *p = json_gen_get_space(jstr, MAX_FLOAT_IN_STR);
+	size_t len = json_gen_fmt_real(jstr, p ? p : str, val, is_double);
+	if (p) {
+		json_gen_advance(jstr, len);
+		return 0;
+	}
+	return json_gen_add_to_str_n(jstr, str, len);
+}
+
+
+void json_gen_str_start(json_gen_str_t *jstr, char *buf, size_t buf_size,
+		json_gen_flush_cb_t flush_cb, void *priv)
+{
+	memset(jstr, 0, sizeof(json_gen_str_t));
+	jstr->buf = buf;
+	jstr->buf_size = buf_size;
+	jstr->flush_cb = flush_cb;
+	jstr->free_ptr = buf;
+	/* Last byte is reserved for the NULL termination */
+	jstr->buf_end = buf ? buf + buf_size - 1 : NULL;
+	jstr->end_ptr = jstr->buf_end;
+	jstr->max_len = UINT64_MAX;
+	jstr->priv = priv;
+	jstr->float_precision = JSON_FLOAT_PRECISION;
+	jstr->stats_start_ns = json_gen_stats_now_ns();
+}
+
+void json_gen_str_start_v2(json_gen_str_t *jstr, char *buf, size_t buf_size,
+		json_gen_flush_cb_v2_t flush_cb, void *priv)
+{
+	json_gen_str_start(jstr, NULL, 0, NULL, priv);
+	jstr->flush_cb_v2 = flush_cb;
+	if (buf) {
+		json_gen_set_buf(jstr, buf, buf_size);
+	}
+}
+
+void json_gen_str_start_async(json_gen_str_t *jstr, char *buf, size_t buf_size,
+		json_gen_write_cb_t write_cb, void *priv)
+{
+	json_gen_str_start(jstr, NULL, 0, NULL, priv);
+	jstr->write_cb = write_cb;
+	json_gen_set_buf(jstr, buf, buf_size);
+}
+
+int json_gen_str_resume(json_gen_str_t *jstr)
+{
+	if (!jstr->write_cb) {
+		return 0;
+	}
+	/* Data within the limit, or of an invalid document, is still written out */
+	if (jstr->err == -1) {
+		return -1;
+	}
+	return json_gen_async_drain(jstr);
+}
+
+size_t json_gen_str_backlog(const json_gen_str_t *jstr)
+{
+	return jstr->spill_len - jstr->spill_sent;
+}
+
+int json_gen_str_fail(json_gen_str_t *jstr, int err)
+{
+	if (!jstr->err) {
+		json_gen_set_error(jstr, err);
+	}
+	return jstr->err;
+}
+
+int json_gen_str_start_sink(json_gen_str_t *jstr, json_gen_sink_t *sink)
+{
+	json_gen_str_start(jstr, NULL, 0, NULL, NULL);
+	char *buf = NULL;
+	size_t buf_size = 0;
+	/* A flush without any data just fetches the initial buffer */
+	if (sink->flush(sink, NULL, 0, 0, &buf, &buf_size) != 0 || !buf || !buf_size) {
+		return -1;
+	}
+	jstr->sink = sink;
+	json_gen_set_buf(jstr, buf, buf_size);
+	return 0;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define json_gen_atomic_load(p)     __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define json_gen_atomic_store(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#else
+#define json_gen_atomic_load(p)     (*(p))
+#define json_gen_atomic_store(p, v) (*(p) = (v))
+#endif
+
+/* Wait till the given buffer is handed back by json_gen_double_buf_release() */
+static int json_gen_double_buf_wait(json_gen_double_buf_t *dbuf, int idx)
+{
+	while (json_gen_atomic_load(&dbuf->busy[idx])) {
+		if (!dbuf->wait_cb || dbuf->wait_cb(dbuf->priv) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Hand over the data in the current buffer and switch to the other one */
+static int json_gen_double_buf_send(json_gen_double_buf_t *dbuf, const char *data, size_t len)
+{
+	json_gen_atomic_store(&dbuf->busy[dbuf->cur], 1);
+	if (dbuf->flush_cb(data, len, dbuf->priv) != 0) {
+		json_gen_atomic_store(&dbuf->busy[dbuf->cur], 0);
+		return -1;
+	}
+	dbuf->cur ^= 1;
+	return 0;
+}
+
+static int json_gen_double_buf_flush(json_gen_sink_t *sink, const char *data, size_t len,
+		size_t need, char **buf, size_t *buf_size)
+{
+	json_gen_double_buf_t *dbuf = (json_gen_double_buf_t *)sink;
+	if (len && json_gen_double_buf_send(dbuf, data, len) != 0) {
+		return -1;
+	}
+	if (json_gen_double_buf_wait(dbuf, dbuf->cur) != 0) {
+		return -1;
+	}
+	*buf = dbuf->bufs[dbuf->cur];
+	*buf_size = dbuf->buf_size;
+	return 0;
+}
+
+static int json_gen_double_buf_end(json_gen_sink_t *sink, const char *data, size_t len)
+{
+	json_gen_double_buf_t *dbuf = (json_gen_double_buf_t *)sink;
+	int ret = 0;
+	if (len && json_gen_double_buf_send(dbuf, data, len) != 0) {
+		ret = -1;
+	}
+	/* The buffers belong to the caller, so wait for both to be handed back */
+	if (json_gen_double_buf_wait(dbuf, 0) != 0 || json_gen_double_buf_wait(dbuf, 1) != 0) {
+		ret = -1;
+	}
+	return ret;
+}
+
+int json_gen_str_start_double_buf(json_gen_str_t *jstr, json_gen_double_buf_t *dbuf,
+		char *buf_a, char *buf_b, size_t buf_size,
+		json_gen_flush_cb_v2_t flush_cb, json_gen_wait_cb_t wait_cb, void *priv)
+{
+	if (!buf_a || !buf_b || !buf_size || !flush_cb || !wait_cb) {
+		return -1;
+	}
+	memset(dbuf, 0, sizeof(json_gen_double_buf_t));
+	dbuf->sink.flush = json_gen_double_buf_flush;
+	dbuf->sink.end = json_gen_double_buf_end;
+	dbuf->bufs[0] = buf_a;
+	dbuf->bufs[1] = buf_b;
+	dbuf->buf_size = buf_size;
+	dbuf->flush_cb = flush_cb;
+	dbuf->wait_cb = wait_cb;
+	dbuf->priv = priv;
+	return json_gen_str_start_sink(jstr, &dbuf->sink);
+}
+
+void json_gen_double_buf_release(json_gen_double_buf_t *dbuf, const char *buf)
+{
+	for (int i = 0; i < 2; i++) {
+		if (buf == dbuf->bufs[i]) {
+			json_gen_atomic_store(&dbuf->busy[i], 0);
+		}
+	}
+}
+
+static void *json_gen_default_realloc(void *ptr, size_t size, void *ctx)
+{
+	return realloc(ptr, size);
+}
+
+static void json_gen_default_free(void *ptr, void *ctx)
+{
+	free(ptr);
+}
+
+static const json_gen_allocator_t json_gen_default_allocator = {
+	json_gen_default_realloc,
+	json_gen_default_free,
+	NULL,
+};
+
+/* The buffer grows geometrically, keeping all the data generated so far. One
+ * byte is always kept spare for the NULL termination.
+ */
+static int json_gen_growable_flush(json_gen_sink_t *sink, const char *data, size_t len,
+		size_t need, char **buf, size_t *buf_size)
+{
+	json_gen_growable_t *gbuf = (json_gen_growable_t *)sink;
+	gbuf->len += len;
+	size_t new_size = gbuf->size ? gbuf->size * 2 : 256;
+	if (new_size < gbuf->len + need + 1) {
+		new_size = gbuf->len + need + 1;
+	}
+	char *new_buf = gbuf->alloc.realloc(gbuf->buf, new_size, gbuf->alloc.ctx);
+	if (!new_buf) {
+		return -1;
+	}
+	gbuf->buf = new_buf;
+	gbuf->size = new_size;
+	*buf = new_buf + gbuf->len;
+	*buf_size = new_size - gbuf->len - 1;
+	return 0;
+}
+
+static int json_gen_growable_end(json_gen_sink_t *sink, const char *data, size_t len)
+{
+	json_gen_growable_t *gbuf = (json_gen_growable_t *)sink;
+	if (!gbuf->buf) {
+		return -1;
+	}
+	gbuf->len += len;
+	gbuf->buf[gbuf->len] = '\0';
+	return 0;
+}
+
+int json_gen_str_start_growable(json_gen_str_t *jstr, json_gen_growable_t *gbuf,
+		size_t initial_size, const json_gen_allocator_t *alloc)
+{
+	memset(gbuf, 0, sizeof(json_gen_growable_t));
+	gbuf->sink.flush = json_gen_growable_flush;
+	gbuf->sink.end = json_gen_growable_end;
+	gbuf->alloc = alloc ? *alloc : json_gen_default_allocator;
+	/* The first flush doubles the size, so start with half of it */
+	gbuf->size = initial_size / 2;
+	return json_gen_str_start_sink(jstr, &gbuf->sink);
+}
+
+char *json_gen_str_end_growable(json_gen_str_t *jstr, size_t *len)
+{
+	json_gen_growable_t *gbuf = (json_gen_growable_t *)jstr->sink;
+	if (!gbuf || gbuf->sink.flush != json_gen_growable_flush) {
+		return NULL;
+	}
+	if (json_gen_str_end(jstr) < 0) {
+		if (gbuf->buf) {
+			gbuf->alloc.free(gbuf->buf, gbuf->alloc.ctx);
+		}
+		gbuf->buf = NULL;
+		gbuf->len = 0;
+	}
+	if (len) {
+		*len = gbuf->len;
+	}
+	return gbuf->buf;
+}
+
+void json_gen_str_set_escape(json_gen_str_t *jstr, bool enable)
+{
+	jstr->escape = enable;
+}
+
+void json_gen_str_set_record_aligned(json_gen_str_t *jstr, bool enable)
+{
+	jstr->record_aligned = enable;
+}
+
+void json_gen_str_set_max_len(json_gen_str_t *jstr, uint64_t max_len)
+{
+	jstr->max_len = max_len ? max_len : UINT64_MAX;
+	if (jstr->err) {
+		return;
+	}
+	if (jstr->total_len > jstr->max_len) {
+		json_gen_set_error(jstr, JSON_GEN_ERR_LIMIT);
+		return;
+	}
+	json_gen_update_end_ptr(jstr);
+}
+
+void json_gen_str_set_float_format(json_gen_str_t *jstr, json_gen_float_fmt_t fmt, int precision)
+{
+	if (precision < 0) {
+		precision = 0;
+	} else if (precision > JSON_GEN_MAX_FLOAT_PRECISION) {
+		precision = JSON_GEN_MAX_FLOAT_PRECISION;
+	}
+	jstr->float_fmt = fmt;
+	jstr->float_precision = precision;
+}
+
+/* Binary formats. The same call sequence is mapped to CBOR or MessagePack items.
+ * Names and values are written out as is, nothing depends on comma_req.
+ */
+#define JSON_GEN_MAJOR_UINT         0
+#define JSON_GEN_MAJOR_NINT         1
+#define JSON_GEN_MAJOR_BYTES        2
+#define JSON_GEN_MAJOR_TEXT         3
+#define JSON_GEN_MAJOR_ARRAY        4
+#define JSON_GEN_MAJOR_MAP          5
+#define JSON_GEN_CBOR_INDEFINITE    31
+#define JSON_GEN_CBOR_FALSE         0xf4
+#define JSON_GEN_CBOR_TRUE          0xf5
+#define JSON_GEN_CBOR_NULL          0xf6
+#define JSON_GEN_CBOR_FLOAT32       0xfa
+#define JSON_GEN_CBOR_FLOAT64       0xfb
+#define JSON_GEN_CBOR_BREAK         0xff
+
+#define JSON_GEN_MSGPACK_NIL        0xc0
+#define JSON_GEN_MSGPACK_FALSE      0xc2
+#define JSON_GEN_MSGPACK_TRUE       0xc3
+#define JSON_GEN_MSGPACK_FLOAT32    0xca
+#define JSON_GEN_MSGPACK_FLOAT64    0xcb
+#define JSON_GEN_MSGPACK_UINT8      0xcc
+#define JSON_GEN_MSGPACK_INT8       0xd0
+#define JSON_GEN_MSGPACK_BIN8       0xc4
+#define JSON_GEN_MSGPACK_BIN16      0xc5
+#define JSON_GEN_MSGPACK_BIN32      0xc6
+#define JSON_GEN_MSGPACK_FIXSTR     0xa0
+#define JSON_GEN_MSGPACK_STR8       0xd9
+#define JSON_GEN_MSGPACK_STR16      0xda
+#define JSON_GEN_MSGPACK_STR32      0xdb
+#define JSON_GEN_MSGPACK_ARRAY32    0xdd
+#define JSON_GEN_MSGPACK_MAP32      0xdf
+
+static inline void json_gen_put_be(uint8_t *out, uint64_t val, int bytes)
+{
+	for (int i = bytes - 1; i >= 0; i--) {
+		out[i] = (uint8_t)val;
+		val >>= 8;
+	}
+}
+
+static inline int json_gen_bin_add(json_gen_str_t *jstr, const uint8_t *data, size_t len)
+{
+	return json_gen_add_to_str_n(jstr, (const char *)data, len);
+}
+
+/* Initial byte and argument of a CBOR data item, in the shortest form */
+static size_t json_gen_cbor_head(uint8_t *out, uint8_t major, uint64_t val)
+{
+	major <<= 5;
+	if (val < 24) {
+		out[0] = major | (uint8_t)val;
+		return 1;
+	}
+	int bytes = val <= UINT8_MAX ? 1 : val <= UINT16_MAX ? 2 : val <= UINT32_MAX ? 4 : 8;
+	/* Additional information 24 to 27 for 1 to 8 bytes */
+	out[0] = major | (uint8_t)(24 + (bytes == 1 ? 0 : bytes == 2 ? 1 : bytes == 4 ? 2 : 3));
+	json_gen_put_be(out + 1, val, bytes);
+	return bytes + 1;
+}
+
+/* Unsigned and signed types share the same layout, 8 to 64 bits */
+static size_t json_gen_msgpack_sized(uint8_t *out, uint8_t base, uint64_t val, int bytes)
+{
+	out[0] = base + (bytes == 1 ? 0 : bytes == 2 ? 1 : bytes == 4 ? 2 : 3);
+	json_gen_put_be(out + 1, val, bytes);
+	return bytes + 1;
+}
+
+static size_t json_gen_msgpack_uint(uint8_t *out, uint64_t val)
+{
+	if (val < 128) {
+		out[0] = (uint8_t)val;
+		return 1;
+	}
+	int bytes = val <= UINT8_MAX ? 1 : val <= UINT16_MAX ? 2 : val <= UINT32_MAX ? 4 : 8;
+	return json_gen_msgpack_sized(out, JSON_GEN_MSGPACK_UINT8, val, bytes);
+}
+
+static size_t json_gen_msgpack_int(uint8_t *out, int64_t val)
+{
+	if (val >= 0) {
+		return json_gen_msgpack_uint(out, (uint64_t)val);
+	}
+	if (val >= -32) {
+		out[0] = (uint8_t)val;
+		return 1;
+	}
+	int bytes = val >= INT8_MIN ? 1 : val >= INT16_MIN ? 2 : val >= INT32_MIN ? 4 : 8;
+	return json_gen_msgpack_sized(out, JSON_GEN_MSGPACK_INT8, (uint64_t)val, bytes);
+}
+
+static int json_gen_bin_unsupported(json_gen_str_t *jstr)
+{
+	if (jstr->err) {
+		return jstr->err;
+	}
+	return json_gen_set_error(jstr, JSON_GEN_ERR_INVALID);
+}
+
+/* MessagePack containers are counted in their parent */
+static inline void json_gen_bin_count(json_gen_str_t *jstr)
+{
+	if (jstr->bin_depth) {
+		jstr->bin_levels[jstr->bin_depth - 1].count++;
+	}
+}
+
+static int json_gen_bin_set_uint64(json_gen_str_t *jstr, uint64_t val)
+{
+	uint8_t tmp[9];
+	size_t len;
+	json_gen_bin_count(jstr);
+	if (jstr->format == JSON_GEN_FORMAT_CBOR) {
+		len = json_gen_cbor_head(tmp, JSON_GEN_MAJOR_UINT, val);
+	} else {
+		len = json_gen_msgpack_uint(tmp, val);
+	}
+	return json_gen_bin_add(jstr, tmp, len);
+}
+
+static int json_gen_bin_set_int64(json_gen_str_t *jstr, int64_t val)
+{
+	uint8_t tmp[9];
+	size_t len;
+	json_gen_bin_count(jstr);
+	if (jstr->format == JSON_GEN_FORMAT_CBOR) {
+		/* Negative integers are encoded as -1 - val */
+		len = val >= 0 ? json_gen_cbor_head(tmp, JSON_GEN_MAJOR_UINT, (uint64_t)val) :
+				json_gen_cbor_head(tmp, JSON_GEN_MAJOR_NINT, ~(uint64_t)val);
+	} else {
+		len = json_gen_msgpack_int(tmp, val);
+	}
+	return json_gen_bin_add(jstr, tmp, len);
+}
+
+static int json_gen_bin_set_real(json_gen_str_t *jstr, double val, bool is_double)
+{
+	uint8_t tmp[9];
+	bool cbor = jstr->format == JSON_GEN_FORMAT_CBOR;
+	json_gen_bin_count(jstr);
+	if (is_double) {
+		uint64_t bits;
+		memcpy(&bits, &val, sizeof(bits));
+		tmp[0] = cbor ? JSON_GEN_CBOR_FLOAT64 : JSON_GEN_MSGPACK_FLOAT64;
+		json_gen_put_be(tmp + 1, bits, 8);
+		return json_gen_bin_add(jstr, tmp, 9);
+	}
+	float f = (float)val;
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	tmp[0] = cbor ? JSON_GEN_CBOR_FLOAT32 : JSON_GEN_MSGPACK_FLOAT32;
+	json_gen_put_be(tmp + 1, bits, 4);
+	return json_gen_bin_add(jstr, tmp, 5);
+}
+
+static int json_gen_bin_set_simple(json_gen_str_t *jstr, uint8_t cbor, uint8_t msgpack)
+{
+	uint8_t c = jstr->format == JSON_GEN_FORMAT_CBOR ? cbor : msgpack;
+	json_gen_bin_count(jstr);
+	return json_gen_bin_add(jstr, &c, 1);
+}
+
+/* Used for the names as well, which are not counted */
+static int json_gen_bin_add_string(json_gen_str_t *jstr, const char *str, size_t len)
+{
+	uint8_t tmp[9];
+	size_t head_len;
+	if (jstr->format == JSON_GEN_FORMAT_CBOR) {
+		head_len = json_gen_cbor_head(tmp, JSON_GEN_MAJOR_TEXT, len);
+	} else if (len < 32) {
+		tmp[0] = JSON_GEN_MSGPACK_FIXSTR | (uint8_t)len;
+		head_len = 1;
+	} else {
+		int bytes = len <= UINT8_MAX ? 1 : len <= UINT16_MAX ? 2 : 4;
+		tmp[0] = bytes == 1 ? JSON_GEN_MSGPACK_STR8 : bytes == 2 ? JSON_GEN_MSGPACK_STR16 :
+				JSON_GEN_MSGPACK_STR32;
+		json_gen_put_be(tmp + 1, len, bytes);
+		head_len = bytes + 1;
+	}
+	json_gen_bin_add(jstr, tmp, head_len);
+	return json_gen_add_to_str_n(jstr, str, len);
+}
+
+static int json_gen_bin_set_string(json_gen_str_t *jstr, const char *str, size_t len)
+{
+	json_gen_bin_count(jstr);
+	return json_gen_bin_add_string(jstr, str, len);
+}
+
+/* Binary data needs no text encoding in the binary formats */
+static int json_gen_bin_set_bytes(json_gen_str_t *jstr, const uint8_t *data, size_t len)
+{
+	uint8_t tmp[9];
+	size_t head_len;
+	json_gen_bin_count(jstr);
+	if (jstr->format == JSON_GEN_FORMAT_CBOR) {
+		head_len = json_gen_cbor_head(tmp, JSON_GEN_MAJOR_BYTES, len);
+	} else {
+		int bytes = len <= UINT8_MAX ? 1 : len <= UINT16_MAX ? 2 : 4;
+		tmp[0] = bytes == 1 ? JSON_GEN_MSGPACK_BIN8 : bytes == 2 ? JSON_GEN_MSGPACK_BIN16 :
+				JSON_GEN_MSGPACK_BIN32;
+		json_gen_put_be(tmp + 1, len, bytes);
+		head_len = bytes + 1;
+	}
+	json_gen_bin_add(jstr, tmp, head_len);
+	return json_gen_bin_add(jstr, data, len);
+}
+
+/* MessagePack headers are written with a 32 bit length, which gets filled in at the end */
+static int json_gen_msgpack_open(json_gen_str_t *jstr, uint8_t type)
+{
+	if (jstr->bin_depth == JSON_GEN_MAX_DEPTH + 1) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	json_gen_bin_count(jstr);
+	json_gen_bin_level_t *level = &jstr->bin_levels[jstr->bin_depth++];
+	level->pos = jstr->total_len;
+	level->count = 0;
+	uint8_t tmp[5] = {type};
+	return json_gen_bin_add(jstr, tmp, sizeof(tmp));
+}
+
+static int json_gen_msgpack_close(json_gen_str_t *jstr)
+{
+	if (!jstr->bin_depth) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	json_gen_bin_level_t *level = &jstr->bin_levels[--jstr->bin_depth];
+	if (jstr->err || !jstr->buf) {
+		return jstr->err;
+	}
+	/* Growable buffers keep all the data flushed so far, just before the buffer */
+	uint64_t back = jstr->total_len - level->pos;
+	if (back > (uint64_t)(jstr->free_ptr - jstr->buf) && !json_gen_is_growable(jstr)) {
+		return json_gen_set_error(jstr, -1);
+	}
+	json_gen_put_be((uint8_t *)(jstr->free_ptr - back) + 1, level->count, 4);
+	return 0;
+}
+
+static int json_gen_bin_open(json_gen_str_t *jstr, bool is_array)
+{
+	if (jstr->format == JSON_GEN_FORMAT_MSGPACK) {
+		return json_gen_msgpack_open(jstr, is_array ? JSON_GEN_MSGPACK_ARRAY32 :
+				JSON_GEN_MSGPACK_MAP32);
+	}
+	uint8_t c = ((is_array ? JSON_GEN_MAJOR_ARRAY : JSON_GEN_MAJOR_MAP) << 5) |
+			JSON_GEN_CBOR_INDEFINITE;
+	return json_gen_bin_add(jstr, &c, 1);
+}
+
+static int json_gen_bin_close(json_gen_str_t *jstr)
+{
+	if (jstr->format == JSON_GEN_FORMAT_MSGPACK) {
+		return json_gen_msgpack_close(jstr);
+	}
+	uint8_t c = JSON_GEN_CBOR_BREAK;
+	return json_gen_bin_add(jstr, &c, 1);
+}
+
+/* Long strings are indefinite length strings of definite length chunks in CBOR */
+static int json_gen_bin_add_to_long_string(json_gen_str_t *jstr, const char *str, size_t len)
+{
+	if (jstr->format == JSON_GEN_FORMAT_MSGPACK) {
+		if (jstr->bin_depth) {
+			jstr->bin_levels[jstr->bin_depth - 1].count += (uint32_t)len;
+		}
+		return json_gen_add_to_str_n(jstr, str, len);
+	}
+	return json_gen_bin_add_string(jstr, str, len);
+}
+
+static int json_gen_bin_start_long_string(json_gen_str_t *jstr, const char *str, size_t len)
+{
+	if (jstr->format == JSON_GEN_FORMAT_MSGPACK) {
+		json_gen_msgpack_open(jstr, JSON_GEN_MSGPACK_STR32);
+	} else {
+		uint8_t c = (JSON_GEN_MAJOR_TEXT << 5) | JSON_GEN_CBOR_INDEFINITE;
+		json_gen_bin_add(jstr, &c, 1);
+	}
+	if (!len) {
+		return jstr->err;
+	}
+	return json_gen_bin_add_to_long_string(jstr, str, len);
+}
+
+/* Pretty printing puts every element on a line of its own, indented as per the
+ * nesting depth. It is kept out of the compact path, apart from one check of the
+ * indent, and compiled out altogether with JSON_GEN_NO_PRETTY.
+ */
+#ifndef JSON_GEN_NO_PRETTY
+#define json_gen_is_pretty(jstr) ((jstr)->indent)
+#else
+#define json_gen_is_pretty(jstr) false
+#endif
+
+/* A newline followed by a run of spaces, for adding the indentation in one go */
+#define JSON_GEN_INDENT_RUN_LEN 64
+static const char json_gen_indent_run[JSON_GEN_INDENT_RUN_LEN + 2] = "\n"
+	"                                                                ";
+
+static int json_gen_pretty_newline(json_gen_str_t *jstr)
+{
+	size_t len = (size_t)jstr->indent_depth * jstr->indent + 1;
+	const char *run = json_gen_indent_run;
+	while (len > JSON_GEN_INDENT_RUN_LEN) {
+		json_gen_add_to_str_n(jstr, run, JSON_GEN_INDENT_RUN_LEN);
+		len -= JSON_GEN_INDENT_RUN_LEN;
+		/* Only the first chunk has the newline */
+		run = json_gen_indent_run + 1;
+	}
+	return json_gen_add_to_str_n(jstr, run, len);
+}
+
+/* Separator before an element. Elements at the top level stay on the same line */
+static int json_gen_pretty_comma(json_gen_str_t *jstr)
+{
+	int ret = 0;
+	if (jstr->comma_req) {
+		ret = json_gen_add_char(jstr, ',');
+	}
+	jstr->indent_empty = false;
+	if (jstr->indent_depth) {
+		ret = json_gen_pretty_newline(jstr);
+	}
+	return ret;
+}
+
+static inline void json_gen_pretty_open(json_gen_str_t *jstr)
+{
+	jstr->indent_depth++;
+	jstr->indent_empty = true;
+}
+
+/* Empty objects and arrays are closed on the same line, Eg. {} */
+static void json_gen_pretty_close(json_gen_str_t *jstr)
+{
+	if (jstr->indent_depth) {
+		jstr->indent_depth--;
+	}
+	if (!jstr->indent_empty) {
+		json_gen_pretty_newline(jstr);
+	}
+	jstr->indent_empty = false;
+}
+
+int json_gen_str_set_indent(json_gen_str_t *jstr, uint8_t indent)
+{
+#ifndef JSON_GEN_NO_PRETTY
+	if (jstr->total_len || jstr->format || indent > JSON_GEN_MAX_INDENT) {
+		return -1;
+	}
+	jstr->indent = indent;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/* Start and end of objects and arrays, for all the formats */
+static inline int json_gen_add_open(json_gen_str_t *jstr, char c)
+{
+	json_gen_stats_open(jstr);
+	if (jstr->format) {
+		return json_gen_bin_open(jstr, c == '[');
+	}
+	if (json_gen_is_pretty(jstr)) {
+		json_gen_pretty_open(jstr);
+	}
+	return json_gen_add_char(jstr, c);
+}
+
+static inline int json_gen_add_close(json_gen_str_t *jstr, char c)
+{
+	json_gen_stats_close(jstr);
+	if (jstr->format) {
+		return json_gen_bin_close(jstr);
+	}
+	if (json_gen_is_pretty(jstr)) {
+		json_gen_pretty_close(jstr);
+	}
+	return json_gen_add_char(jstr, c);
+}
+
+int json_gen_str_set_format(json_gen_str_t *jstr, json_gen_format_t format)
+{
+	if (jstr->total_len || format > JSON_GEN_FORMAT_MSGPACK || (format && jstr->indent)) {
+		return -1;
+	}
+	/* The headers cannot be updated once written out to a non blocking output */
+	if (format == JSON_GEN_FORMAT_MSGPACK && jstr->write_cb) {
+		return -1;
+	}
+	if (format == JSON_GEN_FORMAT_MSGPACK && !jstr->bin_levels) {
+		/* One more level for a long string */
+		jstr->bin_levels = malloc((JSON_GEN_MAX_DEPTH + 1) * sizeof(json_gen_bin_level_t));
+		if (!jstr->bin_levels) {
+			return -1;
+		}
+	}
+	jstr->format = format;
+	return 0;
+}
+
+/* Grow a buffer to hold at least len bytes, doubling its capacity */
+static int json_gen_grow_buf(char **buf, size_t *cap, size_t len)
+{
+	if (len <= *cap) {
+		return 0;
+	}
+	size_t new_cap = *cap ? *cap : 64;
+	while (new_cap < len) {
+		new_cap *= 2;
+	}
+	char *new_buf = realloc(*buf, new_cap);
+	if (!new_buf) {
+		return -1;
+	}
+	*buf = new_buf;
+	*cap = new_cap;
+	return 0;
+}
+
+/* Duplicate keys. The keys of all the open objects are copied, in the order they were
+ * added, with an open addressing hash table indexing them. Since an object ends only
+ * after all the objects nested in it, the keys dropped are always the most recent
+ * ones. Their slots can just be cleared, as none of the remaining keys were probed
+ * past them.
+ */
+#define JSON_GEN_KEYS_MIN_SLOTS     32
+#define JSON_GEN_KEY_SKIPPED        1
+
+typedef struct {
+	/* Offset of the copy of the key */
+	size_t offset;
+	size_t len;
+	uint32_t hash;
+	/* Where this is in the hash table */
+	uint32_t slot;
+} json_gen_key_entry_t;
+
+struct json_gen_key_tracker {
+	/* Index of the key plus 1, or 0 for an empty slot */
+	uint32_t *table;
+	uint32_t mask;
+	json_gen_key_entry_t *entries;
+	uint32_t num_entries;
+	uint32_t entries_cap;
+	/* Copies of the keys, so that the caller can reuse its buffers */
+	char *text;
+	size_t text_len;
+	size_t text_cap;
+	/* Number of entries at the start of each open object */
+	uint32_t starts[JSON_GEN_MAX_DEPTH + 1];
+	uint32_t depth;
+	json_gen_dup_keys_t mode;
+};
+
+static void json_gen_keys_free(json_gen_str_t *jstr)
+{
+	if (jstr->keys) {
+		free(jstr->keys->table);
+		free(jstr->keys->entries);
+		free(jstr->keys->text);
+		free(jstr->keys);
+		jstr->keys = NULL;
+	}
+}
+
+int json_gen_str_set_dup_keys(json_gen_str_t *jstr, json_gen_dup_keys_t mode)
+{
+	if (jstr->total_len || mode > JSON_GEN_DUP_KEYS_SKIP) {
+		return -1;
+	}
+	if (mode == JSON_GEN_DUP_KEYS_ALLOW) {
+		json_gen_keys_free(jstr);
+		return 0;
+	}
+	if (!jstr->keys) {
+		json_gen_key_tracker_t *keys = calloc(1, sizeof(json_gen_key_tracker_t));
+		if (!keys) {
+			return -1;
+		}
+		keys->table = calloc(JSON_GEN_KEYS_MIN_SLOTS, sizeof(uint32_t));
+		if (!keys->table) {
+			free(keys);
+			return -1;
+		}
+		keys->mask = JSON_GEN_KEYS_MIN_SLOTS - 1;
+		jstr->keys = keys;
+	}
+	jstr->keys->mode = mode;
+	return 0;
+}
+
+/* FNV-1a */
+static inline uint32_t json_gen_key_hash(const char *key, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static inline void json_gen_keys_place(json_gen_key_tracker_t *keys, uint32_t index)
+{
+	uint32_t slot = keys->entries[index].hash & keys->mask;
+	while (keys->table[slot]) {
+		slot = (slot + 1) & keys->mask;
+	}
+	keys->table[slot] = index + 1;
+	keys->entries[index].slot = slot;
+}
+
+/* Keep the table at most half full. The keys are placed again in the order they
+ * were added, so that they can still be dropped by just clearing their slots.
+ */
+static int json_gen_keys_grow(json_gen_key_tracker_t *keys)
+{
+	if (keys->num_entries == keys->entries_cap) {
+		uint32_t cap = keys->entries_cap ? keys->entries_cap * 2 : JSON_GEN_KEYS_MIN_SLOTS / 2;
+		json_gen_key_entry_t *entries = realloc(keys->entries, cap * sizeof(json_gen_key_entry_t));
+		if (!entries) {
+			return -1;
+		}
+		keys->entries = entries;
+		keys->entries_cap = cap;
+	}
+	if ((keys->num_entries + 1) * 2 <= keys->mask + 1) {
+		return 0;
+	}
+	uint32_t num_slots = (keys->mask + 1) * 2;
+	uint32_t *table = calloc(num_slots, sizeof(uint32_t));
+	if (!table) {
+		return -1;
+	}
+	free(keys->table);
+	keys->table = table;
+	keys->mask = num_slots - 1;
+	for (uint32_t i = 0; i < keys->num_entries; i++) {
+		json_gen_keys_place(keys, i);
+	}
+	return 0;
+}
+
+/* Returns 0 if the key is new and has been added, JSON_GEN_KEY_SKIPPED if the member
+ * is to be left out, or an error
+ */
+static int json_gen_track_key(json_gen_str_t *jstr, const char *key, size_t len, bool can_skip)
+{
+	json_gen_key_tracker_t *keys = jstr->keys;
+	uint32_t hash = json_gen_key_hash(key, len);
+	/* Only the keys of the innermost object count */
+	uint32_t first = 0;
+	if (keys->depth) {
+		first = keys->starts[keys->depth <= JSON_GEN_MAX_DEPTH ? keys->depth - 1 : JSON_GEN_MAX_DEPTH];
+	}
+	for (uint32_t slot = hash & keys->mask; keys->table[slot]; slot = (slot + 1) & keys->mask) {
+		uint32_t index = keys->table[slot] - 1;
+		const json_gen_key_entry_t *entry = &keys->entries[index];
+		if (index >= first && entry->hash == hash && entry->len == len &&
+				(!len || memcmp(keys->text + entry->offset, key, len) == 0)) {
+			if (can_skip && keys->mode == JSON_GEN_DUP_KEYS_SKIP) {
+				return JSON_GEN_KEY_SKIPPED;
+			}
+			return jstr->err ? jstr->err : json_gen_set_error(jstr, JSON_GEN_ERR_INVALID);
+		}
+	}
+	if (json_gen_keys_grow(keys) != 0 ||
+			json_gen_grow_buf(&keys->text, &keys->text_cap, keys->text_len + len) != 0) {
+		return json_gen_set_error(jstr, -1);
+	}
+	json_gen_key_entry_t *entry = &keys->entries[keys->num_entries];
+	if (len) {
+		memcpy(keys->text + keys->text_len, key, len);
+	}
+	entry->offset = keys->text_len;
+	entry->len = len;
+	keys->text_len += len;
+	entry->hash = hash;
+	json_gen_keys_place(keys, keys->num_entries++);
+	return 0;
+}
+
+/* Leaves out the member with a duplicate key, or fails, if the keys are tracked */
+#define JSON_GEN_TRACK_KEY(jstr, key, key_len, can_skip) \
+	do { \
+		if ((jstr)->keys) { \
+			int key_ret = json_gen_track_key(jstr, key, key_len, can_skip); \
+			if (key_ret) { \
+				return key_ret == JSON_GEN_KEY_SKIPPED ? json_gen_result(jstr, 0) : key_ret; \
+			} \
+		} \
+	} while (0)
+
+/* Pre-rendered keys are tracked by the name within ,"": */
+#define JSON_GEN_TRACK_KEY_K(jstr, k, can_skip) \
+	JSON_GEN_TRACK_KEY(jstr, (k)->str + 2, (k)->len - 4, can_skip)
+
+static inline void json_gen_keys_open(json_gen_str_t *jstr)
+{
+	json_gen_key_tracker_t *keys = jstr->keys;
+	if (keys) {
+		/* Any deeper objects share the keys of the deepest one tracked */
+		if (keys->depth <= JSON_GEN_MAX_DEPTH) {
+			keys->starts[keys->depth] = keys->num_entries;
+		}
+		keys->depth++;
+	}
+}
+
+static inline void json_gen_keys_close(json_gen_str_t *jstr)
+{
+	json_gen_key_tracker_t *keys = jstr->keys;
+	if (keys && keys->depth && --keys->depth <= JSON_GEN_MAX_DEPTH) {
+		while (keys->num_entries > keys->starts[keys->depth]) {
+			json_gen_key_entry_t *entry = &keys->entries[--keys->num_entries];
+			keys->table[entry->slot] = 0;
+			keys->text_len = entry->offset;
+		}
+	}
+}
+
+/* The nesting is tracked with one bit per level, set for arrays. Any call which
+ * would produce invalid JSON sets the JSON_GEN_ERR_INVALID error. All of this
+ * is compiled out for trusted builds.
+ */
+#ifndef JSON_GEN_TRUSTED
+#define JSON_GEN_STATE_LONG_STR     0x01
+#define JSON_GEN_STATE_NAME         0x02
+
+static int json_gen_invalid(json_gen_str_t *jstr)
+{
+	if (jstr->err) {
+		return jstr->err;
+	}
+	return json_gen_set_error(jstr, JSON_GEN_ERR_INVALID);
+}
+
+static inline bool json_gen_in_array(json_gen_str_t *jstr)
+{
+	uint32_t level = jstr->depth - 1;
+	return (jstr->nest_stack[level / 64] >> (level % 64)) & 1;
+}
+
+/* Values without a name can be added at the top level, in an array, or after
+ * json_gen_obj_set_name_n()
+ */
+static inline void json_gen_check_elem(json_gen_str_t *jstr)
+{
+	if (jstr->state) {
+		if (jstr->state & JSON_GEN_STATE_LONG_STR) {
+			json_gen_invalid(jstr);
+		}
+		jstr->state &= ~JSON_GEN_STATE_NAME;
+	} else if (jstr->depth && !json_gen_in_array(jstr)) {
+		json_gen_invalid(jstr);
+	}
+}
+
+/* Values with a name can be added only in an object. They are allowed at the top
+ * level as well, for generating fragments.
+ */
+static inline void json_gen_check_member(json_gen_str_t *jstr)
+{
+	if (jstr->state || (jstr->depth && json_gen_in_array(jstr))) {
+		json_gen_invalid(jstr);
+	}
+}
+
+static inline void json_gen_push_level(json_gen_str_t *jstr, bool is_array)
+{
+	if (jstr->depth == JSON_GEN_MAX_DEPTH) {
+		json_gen_invalid(jstr);
+		return;
+	}
+	uint32_t level = jstr->depth++;
+	uint64_t bit = 1ULL << (level % 64);
+	if (is_array) {
+		jstr->nest_stack[level / 64] |= bit;
+	} else {
+		jstr->nest_stack[level / 64] &= ~bit;
+	}
+}
+
+static inline void json_gen_pop_level(json_gen_str_t *jstr, bool is_array)
+{
+	if (jstr->state || !jstr->depth || json_gen_in_array(jstr) != is_array) {
+		json_gen_invalid(jstr);
+		return;
+	}
+	jstr->depth--;
+}
+
+static inline void json_gen_set_state(json_gen_str_t *jstr, uint8_t state)
+{
+	jstr->state |= state;
+}
+
+static inline void json_gen_check_long_string(json_gen_str_t *jstr, bool end)
+{
+	if (!(jstr->state & JSON_GEN_STATE_LONG_STR)) {
+		json_gen_invalid(jstr);
+	} else if (end) {
+		jstr->state &= ~JSON_GEN_STATE_LONG_STR;
+	}
+}
+
+/* Records can begin and end only at the top level */
+static inline void json_gen_check_top(json_gen_str_t *jstr)
+{
+	if (jstr->depth || jstr->state) {
+		json_gen_invalid(jstr);
+	}
+}
+
+/* Close whatever is left open, so that the output is valid JSON */
+static void json_gen_close_all(json_gen_str_t *jstr)
+{
+	if (jstr->err || (!jstr->depth && !jstr->state)) {
+		return;
+	}
+	if (jstr->state & JSON_GEN_STATE_LONG_STR) {
+		if (jstr->format) {
+			json_gen_bin_close(jstr);
+		} else {
+			json_gen_add_char(jstr, '"');
+		}
+	}
+	while (jstr->depth) {
+		json_gen_add_close(jstr, json_gen_in_array(jstr) ? ']' : '}');
+		jstr->depth--;
+	}
+	jstr->state = 0;
+	if (!jstr->err) {
+		jstr->err = JSON_GEN_ERR_INVALID;
+	}
+}
+#else
+#define JSON_GEN_STATE_NAME         0
+#define json_gen_check_elem(jstr)
+#define json_gen_check_member(jstr)
+#define json_gen_check_top(jstr)
+#define json_gen_push_level(jstr, is_array)
+#define json_gen_pop_level(jstr, is_array)
+#define json_gen_set_state(jstr, state)
+#define json_gen_check_long_string(jstr, end)
+#define json_gen_close_all(jstr)
+#endif /* JSON_GEN_TRUSTED */
+
+int64_t json_gen_str_end(json_gen_str_t *jstr)
+{
+    json_gen_close_all(jstr);
+    /* A non blocking output must take everything before the JSON string can end.
+     * Calling this again just retries, since the buffer is empty by then.
+     */
+    if (jstr->write_cb && jstr->err != -1 &&
+            json_gen_async_write(jstr, jstr->free_ptr - jstr->buf) == JSON_GEN_AGAIN) {
+        return JSON_GEN_AGAIN;
+    }
+    free(jstr->spill);
+    free(jstr->bin_levels);
+    json_gen_keys_free(jstr);
+    uint64_t total_len = jstr->total_len;
+    int err = jstr->err;
+    /* Data within the limit, or an invalid but auto closed document, is still flushed out */
+    bool failed = err == -1;
+    size_t len = jstr->free_ptr - jstr->buf;
+    if (jstr->sink) {
+        if (jstr->sink->end) {
+            /* Let the sink release its resources even if the output has failed */
+            if (jstr->sink->end(jstr->sink, jstr->buf, failed ? 0 : len) != 0) {
+                failed = true;
+            }
+        } else if (len && !failed) {
+            char *buf;
+            size_t buf_size;
+            if (jstr->sink->flush(jstr->sink, jstr->buf, len, 0, &buf, &buf_size) != 0) {
+                failed = true;
+            }
+        }
+    } else if (jstr->buf && !failed && !jstr->write_cb) {
+        if (jstr->flush_cb_v2) {
+            if (jstr->flush_cb_v2(jstr->buf, len, jstr->priv) != 0) {
+                failed = true;
+            }
+        } else {
+            *jstr->free_ptr = '\0';
+            if (jstr->flush_cb)
+                jstr->flush_cb(jstr->buf, jstr->priv);
+        }
+    }
+	memset(jstr, 0, sizeof(json_gen_str_t));
+    if (failed) {
+        return -1;
+    }
+    if (err) {
+        return err;
+    }
+    return (int64_t)total_len + 1; /* +1 for the NULL termination */
+}
+
+int json_gen_get_stats(const json_gen_str_t *jstr, json_gen_stats_t *stats)
+{
+#ifdef JSON_GEN_ENABLE_STATS
+	*stats = jstr->stats;
+	stats->bytes = jstr->total_len;
+	stats->bytes_in_place = jstr->total_len - stats->bytes_copied;
+	stats->encode_ns = json_gen_stats_now_ns() - jstr->stats_start_ns - stats->flush_ns;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+char *json_gen_reserve(json_gen_str_t *jstr, size_t n)
+{
+	if (!jstr->buf) {
+		return NULL;
+	}
+	char *p = json_gen_get_space(jstr, n);
+	if (p) {
+		return p;
+	}
+	if (jstr->err) {
+		return NULL;
+	}
+	if (n > jstr->max_len - jstr->total_len) {
+		json_gen_set_error(jstr, JSON_GEN_ERR_LIMIT);
+		return NULL;
+	}
+	/* Flushing would not help if the buffer can never hold n bytes. Sinks may
+	 * however provide a larger buffer.
+	 */
+	if (!jstr->sink && n > (size_t)(jstr->buf_end - jstr->buf)) {
+		return NULL;
+	}
+	if (json_gen_failed(json_gen_flush(jstr, n))) {
+		return NULL;
+	}
+	return json_gen_get_space(jstr, n);
+}
+
+int json_gen_commit(json_gen_str_t *jstr, size_t written)
+{
+	if (!jstr->buf || written > json_gen_get_empty_len(jstr)) {
+		return -1;
+	}
+	json_gen_advance(jstr, written);
+	return 0;
+}
+
+/* String escaping as per RFC 8259. Quotes, backslashes and control characters
+ * need to be escaped. All other bytes, including UTF-8 sequences, are copied as is.
+ */
+static inline bool json_gen_needs_escape(unsigned char c)
+{
+	return c < 0x20 || c == '"' || c == '\\';
+}
+
+#define JSON_GEN_SWAR_ONES  0x0101010101010101ULL
+#define JSON_GEN_SWAR_HIGHS 0x8080808080808080ULL
+
+/* Non zero if any of the 8 bytes in w may need escaping */
+static inline uint64_t json_gen_swar_needs_escape(uint64_t w)
+{
+	uint64_t quote = w ^ (JSON_GEN_SWAR_ONES * '"');
+	uint64_t bslash = w ^ (JSON_GEN_SWAR_ONES * '\\');
+	uint64_t t = (quote - JSON_GEN_SWAR_ONES) & ~quote;
+	t |= (bslash - JSON_GEN_SWAR_ONES) & ~bslash;
+	t |= (w - JSON_GEN_SWAR_ONES * 0x20) & ~w;
+	return t & JSON_GEN_SWAR_HIGHS;
+}
+
+/* Returns the length of the initial part of str which does not need escaping */
+static size_t json_gen_scan_clean(const char *str, size_t len)
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i bslash = _mm_set1_epi8('\\');
+	const __m128i ctrl_max = _mm_set1_epi8(0x1f);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+		/* Unsigned v <= 0x1f is the same as saturated v - 0x1f == 0 */
+		__m128i m = _mm_cmpeq_epi8(_mm_subs_epu8(v, ctrl_max), zero);
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, quote));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, bslash));
+		int mask = _mm_movemask_epi8(m);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const uint8x16_t quote = vdupq_n_u8('"');
+	const uint8x16_t bslash = vdupq_n_u8('\\');
+	const uint8x16_t ctrl_lim = vdupq_n_u8(0x20);
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8((const uint8_t *)str + i);
+		uint8x16_t m = vcltq_u8(v, ctrl_lim);
+		m = vorrq_u8(m, vceqq_u8(v, quote));
+		m = vorrq_u8(m, vceqq_u8(v, bslash));
+		if (vmaxvq_u8(m)) {
+			break;
+		}
+	}
+#endif
+	for (; i + 8 <= len; i += 8) {
+		uint64_t w;
+		memcpy(&w, str + i, sizeof(w));
+		if (json_gen_swar_needs_escape(w)) {
+			break;
+		}
+	}
+	for (; i < len; i++) {
+		if (json_gen_needs_escape((unsigned char)str[i])) {
+			break;
+		}
+	}
+	return i;
+}
+
+/* Add the string with escaping. Runs of bytes which do not need escaping are
+ * copied in bulk and only the remaining ones are handled one at a time.
+ */
+static int json_gen_add_escaped(json_gen_str_t *jstr, const char *str, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	int ret = 0;
+	while (len) {
+		size_t clean = json_gen_scan_clean(str, len);
+		if (clean) {
+			ret = json_gen_keep_again(ret, json_gen_add_to_str_n(jstr, str, clean));
+			str += clean;
+			len -= clean;
+			if (!len) {
+				break;
+			}
+		}
+		unsigned char c = (unsigned char)*str++;
+		len--;
+		char esc[6] = {'\\', (char)c};
+		size_t esc_len = 2;
+		switch (c) {
+			case '"':
+			case '\\':
+				break;
+			case '\b': esc[1] = 'b'; break;
+			case '\f': esc[1] = 'f'; break;
+			case '\n': esc[1] = 'n'; break;
+			case '\r': esc[1] = 'r'; break;
+			case '\t': esc[1] = 't'; break;
+			default:
+				memcpy(esc + 1, "u00", 3);
+				esc[4] = hex[c >> 4];
+				esc[5] = hex[c & 0xf];
+				esc_len = 6;
+				break;
+		}
+		ret = json_gen_keep_again(ret, json_gen_add_to_str_n(jstr, esc, esc_len));
+	}
+	return json_gen_failed(ret) ? -1 : ret;
+}
+
+/* Add the contents of a string, escaping them if enabled for the JSON string */
+static inline int json_gen_add_string_body(json_gen_str_t *jstr, const char *str, size_t len)
+{
+	if (jstr->escape) {
+		return json_gen_add_escaped(jstr, str, len);
+	}
+	return json_gen_add_to_str_n(jstr, str, len);
+}
+
+/* Binary to text encodings. The encoders take whole groups of input bytes, ie.
+ * single bytes for hex and 3 byte groups for base64, and return the number of
+ * characters written.
+ */
+typedef size_t (*json_gen_encode_fn_t)(char *out, const uint8_t *in, size_t len);
+
+static const char json_gen_hex_digits[] = "0123456789abcdef";
+static const char json_gen_base64_chars[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static size_t json_gen_hex_encode(char *out, const uint8_t *in, size_t len)
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i digit = _mm_set1_epi8('0');
+	const __m128i alpha = _mm_set1_epi8('a' - '0' - 10);
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+		__m128i lo = _mm_and_si128(v, nibble);
+		hi = _mm_add_epi8(_mm_add_epi8(hi, digit), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), alpha));
+		lo = _mm_add_epi8(_mm_add_epi8(lo, digit), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), alpha));
+		_mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const uint8x16_t digits = vld1q_u8((const uint8_t *)json_gen_hex_digits);
+	const uint8x16_t nibble = vdupq_n_u8(0x0f);
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8(in + i);
+		uint8x16x2_t o;
+		o.val[0] = vqtbl1q_u8(digits, vshrq_n_u8(v, 4));
+		o.val[1] = vqtbl1q_u8(digits, vandq_u8(v, nibble));
+		vst2q_u8((uint8_t *)out + 2 * i, o);
+	}
+#endif
+	for (; i < len; i++) {
+		out[2 * i] = json_gen_hex_digits[in[i] >> 4];
+		out[2 * i + 1] = json_gen_hex_digits[in[i] & 0xf];
+	}
+	return 2 * len;
+}
+
+#if defined(__SSSE3__)
+/* 12 bytes from the first 16 of v to 16 base64 characters, as described by
+ * Wojciech Mula in "Faster Base64 Encoding and Decoding using AVX2 Instructions"
+ */
+static inline __m128i json_gen_base64_ssse3(__m128i v)
+{
+	/* Each 32 bit lane gets the bytes b1 b0 b2 b1 of a 3 byte group */
+	v = _mm_shuffle_epi8(v, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	__m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)),
+			_mm_set1_epi32(0x04000040));
+	__m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)),
+			_mm_set1_epi32(0x01000010));
+	__m128i idx = _mm_or_si128(t0, t1);
+	/* Map the 6 bit indices to the offsets to be added, by their range */
+	__m128i range = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+	range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx),
+				_mm_set1_epi8(13)));
+	const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'+' - 62, '/' - 63, 'A', 0, 0);
+	return _mm_add_epi8(idx, _mm_shuffle_epi8(offsets, range));
+}
+#endif /* __SSSE3__ */
+
+/* len must be a multiple of 3 */
+static size_t json_gen_base64_encode(char *out, const uint8_t *in, size_t len)
+{
+	size_t i = 0;
+	char *p = out;
+#if defined(__SSSE3__)
+	/* 16 bytes are loaded for every 12 consumed */
+	for (; i + 16 <= len; i += 12, p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+		_mm_storeu_si128((__m128i *)p, json_gen_base64_ssse3(v));
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const uint8x16x4_t chars = {{
+		vld1q_u8((const uint8_t *)json_gen_base64_chars),
+		vld1q_u8((const uint8_t *)json_gen_base64_chars + 16),
+		vld1q_u8((const uint8_t *)json_gen_base64_chars + 32),
+		vld1q_u8((const uint8_t *)json_gen_base64_chars + 48),
+	}};
+	const uint8x16_t sextet = vdupq_n_u8(0x3f);
+	for (; i + 48 <= len; i += 48, p += 64) {
+		uint8x16x3_t v = vld3q_u8(in + i);
+		uint8x16x4_t o;
+		o.val[0] = vqtbl4q_u8(chars, vshrq_n_u8(v.val[0], 2));
+		o.val[1] = vqtbl4q_u8(chars, vandq_u8(vorrq_u8(vshlq_n_u8(v.val[0], 4),
+						vshrq_n_u8(v.val[1], 4)), sextet));
+		o.val[2] = vqtbl4q_u8(chars, vandq_u8(vorrq_u8(vshlq_n_u8(v.val[1], 2),
+						vshrq_n_u8(v.val[2], 6)), sextet));
+		o.val[3] = vqtbl4q_u8(chars, vandq_u8(v.val[2], sextet));
+		vst4q_u8((uint8_t *)p, o);
+	}
+#endif
+	for (; i < len; i += 3, p += 4) {
+		uint32_t w = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+		p[0] = json_gen_base64_chars[w >> 18];
+		p[1] = json_gen_base64_chars[(w >> 12) & 0x3f];
+		p[2] = json_gen_base64_chars[(w >> 6) & 0x3f];
+		p[3] = json_gen_base64_chars[w & 0x3f];
+	}
+	return p - out;
+}
+
+/* Encode the whole groups of the data straight into the buffer, as far as they fit.
+ * Whatever does not fit goes through a small temporary buffer, which lets
+ * json_gen_add_to_str_n() fill up the buffer and flush it out.
+ */
+static int json_gen_add_encoded(json_gen_str_t *jstr, const uint8_t *data, size_t len,
+		size_t in_group, size_t out_group, json_gen_encode_fn_t encode)
+{
+	int ret = 0;
+	while (len >= in_group && !json_gen_failed(ret)) {
+		size_t groups = len / in_group;
+		char *p = json_gen_get_space(jstr, out_group);
+		if (p) {
+			size_t fit = json_gen_get_empty_len(jstr) / out_group;
+			if (groups > fit) {
+				groups = fit;
+			}
+			json_gen_advance(jstr, encode(p, data, groups * in_group));
+		} else {
+			char tmp[64];
+			if (groups > sizeof(tmp) / out_group) {
+				groups = sizeof(tmp) / out_group;
+			}
+			ret = json_gen_keep_again(ret, json_gen_add_to_str_n(jstr, tmp,
+						encode(tmp, data, groups * in_group)));
+		}
+		data += groups * in_group;
+		len -= groups * in_group;
+	}
+	return ret;
+}
+
+static inline void json_gen_handle_comma(json_gen_str_t *jstr)
+{
+	if (json_gen_is_pretty(jstr))
+		json_gen_pretty_comma(jstr);
+	else if (jstr->comma_req && !jstr->format)
+		json_gen_add_char(jstr, ',');
+}
+
+static inline void json_gen_handle_elem(json_gen_str_t *jstr)
+{
+	json_gen_check_elem(jstr);
+	json_gen_handle_comma(jstr);
+}
+
+static inline void json_gen_handle_member(json_gen_str_t *jstr)
+{
+	json_gen_check_member(jstr);
+	json_gen_handle_comma(jstr);
+}
+
+
+static int json_gen_handle_name_n(json_gen_str_t *jstr, const char *name, size_t name_len)
+{
+	if (jstr->format) {
+		return json_gen_bin_add_string(jstr, name, name_len);
+	}
+	/* Emit "name": in one go if it fits in the buffer and needs no escaping */
+	char *p = json_gen_get_space(jstr, name_len + 3);
+	if (p && (!jstr->escape || json_gen_scan_clean(name, name_len) == name_len)) {
+		p[0] = '"';
+		memcpy(p + 1, name, name_len);
+		json_gen_stats_copied(jstr, name_len);
+		p[name_len + 1] = '"';
+		p[name_len + 2] = ':';
+		json_gen_advance(jstr, name_len + 3);
+		return json_gen_is_pretty(jstr) ? json_gen_add_char(jstr, ' ') : 0;
+	}
+	json_gen_add_char(jstr, '"');
+	json_gen_add_string_body(jstr, name, name_len);
+	int ret = json_gen_add_literal(jstr, "\":");
+	return json_gen_is_pretty(jstr) ? json_gen_add_char(jstr, ' ') : ret;
+}
+
+static inline int json_gen_handle_name(json_gen_str_t *jstr, const char *name)
+{
+	return json_gen_handle_name_n(jstr, name, strlen(name));
+}
+
+/* Pre-rendered keys include the comma, which is skipped if not required */
+static inline int json_gen_handle_key(json_gen_str_t *jstr, const json_gen_key_t *key)
+{
+	json_gen_check_member(jstr);
+	if (jstr->format) {
+		/* Skip the ,": prefix and the ": suffix */
+		return json_gen_bin_add_string(jstr, key->str + 2, key->len - 4);
+	}
+	if (json_gen_is_pretty(jstr)) {
+		json_gen_pretty_comma(jstr);
+		json_gen_add_to_str_n(jstr, key->str + 1, key->len - 1);
+		return json_gen_add_char(jstr, ' ');
+	}
+	if (jstr->comma_req) {
+		return json_gen_add_to_str_n(jstr, key->str, key->len);
+	}
+	return json_gen_add_to_str_n(jstr, key->str + 1, key->len - 1);
+}
+
+int json_gen_obj_start_value_n(json_gen_str_t *jstr, const char *name, size_t name_len)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, false);
+	json_gen_handle_member(jstr);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_handle_name_n(jstr, name, name_len));
+}
+
+int json_gen_obj_set_name_n(json_gen_str_t *jstr, const char *name, size_t name_len)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, false);
+	json_gen_handle_member(jstr);
+	jstr->comma_req = false;
+	json_gen_set_state(jstr, JSON_GEN_STATE_NAME);
+	return json_gen_result(jstr, json_gen_handle_name_n(jstr, name, name_len));
+}
+
+int json_gen_obj_start_value(json_gen_str_t *jstr, const char *name)
+{
+	return json_gen_obj_start_value_n(jstr, name, strlen(name));
+}
+
+int json_gen_arr_start_value(json_gen_str_t *jstr)
+{
+	int ret = 0;
+	json_gen_check_elem(jstr);
+	if (json_gen_is_pretty(jstr)) {
+		ret = json_gen_pretty_comma(jstr);
+	} else if (jstr->comma_req && !jstr->format) {
+		ret = json_gen_add_char(jstr, ',');
+	}
+	jstr->comma_req = true;
+	return json_gen_result(jstr, ret);
+}
+
+
+int json_gen_record_begin(json_gen_str_t *jstr)
+{
+	json_gen_check_top(jstr);
+	jstr->comma_req = false;
+	return json_gen_result(jstr, jstr->err);
+}
+
+int json_gen_record_end(json_gen_str_t *jstr)
+{
+	json_gen_check_top(jstr);
+	jstr->comma_req = false;
+	/* Binary records need no separator */
+	int ret = jstr->format ? jstr->err : json_gen_add_char(jstr, '\n');
+	if (ret == 0 && jstr->buf) {
+		jstr->record_end = jstr->free_ptr;
+	}
+	return json_gen_result(jstr, ret);
+}
+
+int json_gen_start_object(json_gen_str_t *jstr)
+{
+	json_gen_handle_elem(jstr);
+	json_gen_push_level(jstr, false);
+	json_gen_keys_open(jstr);
+	jstr->comma_req = false;
+	return json_gen_result(jstr, json_gen_add_open(jstr, '{'));
+}
+
+int json_gen_end_object(json_gen_str_t *jstr)
+{
+	json_gen_pop_level(jstr, false);
+	json_gen_keys_close(jstr);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_add_close(jstr, '}'));
+}
+
+
+int json_gen_start_array(json_gen_str_t *jstr)
+{
+	json_gen_handle_elem(jstr);
+	json_gen_push_level(jstr, true);
+	jstr->comma_req = false;
+	return json_gen_result(jstr, json_gen_add_open(jstr, '['));
+}
+
+int json_gen_end_array(json_gen_str_t *jstr)
+{
+	json_gen_pop_level(jstr, true);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_add_close(jstr, ']'));
+}
+
+int json_gen_push_object_n(json_gen_str_t *jstr, const char *name, size_t name_len)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, false);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	json_gen_push_level(jstr, false);
+	json_gen_keys_open(jstr);
+	jstr->comma_req = false;
+	return json_gen_result(jstr, json_gen_add_open(jstr, '{'));
+}
+
+int json_gen_push_object(json_gen_str_t *jstr, const char *name)
+{
+	return json_gen_push_object_n(jstr, name, strlen(name));
+}
+
+int json_gen_pop_object(json_gen_str_t *jstr)
+{
+	json_gen_pop_level(jstr, false);
+	json_gen_keys_close(jstr);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_add_close(jstr, '}'));
+}
+
+int json_gen_push_object_str_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+		const char *object_str, size_t object_len)
+{
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_add_raw(jstr, object_str, object_len));
+}
+
+int json_gen_push_object_str(json_gen_str_t *jstr, const char *name, const char *object_str)
+{
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	JSON_GEN_TRACK_KEY(jstr, name, strlen(name), true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name(jstr, name);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_add_to_str(jstr, object_str));
+}
+
+int json_gen_push_array_n(json_gen_str_t *jstr, const char *name, size_t name_len)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, false);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	json_gen_push_level(jstr, true);
+	jstr->comma_req = false;
+	return json_gen_result(jstr, json_gen_add_open(jstr, '['));
+}
+
+int json_gen_push_array(json_gen_str_t *jstr, const char *name)
+{
+	return json_gen_push_array_n(jstr, name, strlen(name));
+}
+
+int json_gen_pop_array(json_gen_str_t *jstr)
+{
+	json_gen_pop_level(jstr, true);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_add_close(jstr, ']'));
+}
+
+int json_gen_push_array_str_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+		const char *array_str, size_t array_len)
+{
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_add_raw(jstr, array_str, array_len));
+}
+
+int json_gen_arr_push_raw(json_gen_str_t *jstr, const char *raw, size_t len)
+{
+	json_gen_handle_elem(jstr);
+	json_gen_bin_count(jstr);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_add_raw(jstr, raw, len));
+}
+
+int json_gen_push_array_str(json_gen_str_t *jstr, const char *name, const char *array_str)
+{
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	JSON_GEN_TRACK_KEY(jstr, name, strlen(name), true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name(jstr, name);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_add_to_str(jstr, array_str));
+}
+
+static int json_gen_emit_bool(json_gen_str_t *jstr, bool val)
+{
+	if (jstr->format) {
+		return json_gen_bin_set_simple(jstr, val ? JSON_GEN_CBOR_TRUE : JSON_GEN_CBOR_FALSE,
+				val ? JSON_GEN_MSGPACK_TRUE : JSON_GEN_MSGPACK_FALSE);
+	}
+	jstr->comma_req = true;
+	if (val)
+		return json_gen_add_literal(jstr, "true");
+	else
+		return json_gen_add_literal(jstr, "false");
+}
+
+static int json_gen_set_bool(json_gen_str_t *jstr, bool val)
+{
+	JSON_GEN_MEASURE_VALUE(jstr, json_gen_emit_bool(jstr, val));
+}
+
+int json_gen_obj_set_bool_n(json_gen_str_t *jstr, const char *name, size_t name_len, bool val)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_bool(jstr, val));
+}
+
+int json_gen_obj_set_bool(json_gen_str_t *jstr, const char *name, bool val)
+{
+	return json_gen_obj_set_bool_n(jstr, name, strlen(name), val);
+}
+
+int json_gen_arr_set_bool(json_gen_str_t *jstr, bool val)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_bool(jstr, val));
+}
+
+static int json_gen_emit_int(json_gen_str_t *jstr, int val)
+{
+	if (jstr->format) {
+		return json_gen_bin_set_int64(jstr, val);
+	}
+	jstr->comma_req = true;
+	return json_gen_add_number(jstr, (uint64_t)(int64_t)val, true);
+}
+
+static int json_gen_set_int(json_gen_str_t *jstr, int val)
+{
+	JSON_GEN_MEASURE_VALUE(jstr, json_gen_emit_int(jstr, val));
+}
+
+int json_gen_obj_set_int_n(json_gen_str_t *jstr, const char *name, size_t name_len, int val)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_int(jstr, val));
+}
+
+int json_gen_obj_set_int(json_gen_str_t *jstr, const char *name, int val)
+{
+	return json_gen_obj_set_int_n(jstr, name, strlen(name), val);
+}
+
+int json_gen_arr_set_int(json_gen_str_t *jstr, int val)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_int(jstr, val));
+}
+
+static int json_gen_emit_int64(json_gen_str_t *jstr, int64_t val)
+{
+	if (jstr->format) {
+		return json_gen_bin_set_int64(jstr, val);
+	}
+	jstr->comma_req = true;
+	return json_gen_add_number(jstr, (uint64_t)val, true);
+}
+
+static int json_gen_set_int64(json_gen_str_t *jstr, int64_t val)
+{
+	JSON_GEN_MEASURE_VALUE(jstr, json_gen_emit_int64(jstr, val));
+}
+
+int json_gen_obj_set_int64_n(json_gen_str_t *jstr, const char *name, size_t name_len, int64_t val)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_int64(jstr, val));
+}
+
+int json_gen_obj_set_int64(json_gen_str_t *jstr, const char *name, int64_t val)
+{
+	return json_gen_obj_set_int64_n(jstr, name, strlen(name), val);
+}
+
+int json_gen_arr_set_int64(json_gen_str_t *jstr, int64_t val)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_int64(jstr, val));
+}
+
+static int json_gen_emit_uint64(json_gen_str_t *jstr, uint64_t val)
+{
+	if (jstr->format) {
+		return json_gen_bin_set_uint64(jstr, val);
+	}
+	jstr->comma_req = true;
+	return json_gen_add_number(jstr, val, false);
+}
+
+static int json_gen_set_uint64(json_gen_str_t *jstr, uint64_t val)
+{
+	JSON_GEN_MEASURE_VALUE(jstr, json_gen_emit_uint64(jstr, val));
+}
+
+int json_gen_obj_set_uint32_n(json_gen_str_t *jstr, const char *name, size_t name_len, uint32_t val)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_uint64(jstr, val));
+}
+
+int json_gen_obj_set_uint32(json_gen_str_t *jstr, const char *name, uint32_t val)
+{
+	return json_gen_obj_set_uint32_n(jstr, name, strlen(name), val);
+}
+
+int json_gen_arr_set_uint32(json_gen_str_t *jstr, uint32_t val)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_uint64(jstr, val));
+}
+
+int json_gen_obj_set_uint64_n(json_gen_str_t *jstr, const char *name, size_t name_len, uint64_t val)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_uint64(jstr, val));
+}
+
+int json_gen_obj_set_uint64(json_gen_str_t *jstr, const char *name, uint64_t val)
+{
+	return json_gen_obj_set_uint64_n(jstr, name, strlen(name), val);
+}
+
+int json_gen_arr_set_uint64(json_gen_str_t *jstr, uint64_t val)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_uint64(jstr, val));
+}
+
+static int json_gen_emit_float(json_gen_str_t *jstr, float val)
+{
+	if (jstr->format) {
+		return json_gen_bin_set_real(jstr, val, false);
+	}
+	jstr->comma_req = true;
+	return json_gen_add_real(jstr, val, false);
+}
+
+static int json_gen_set_float(json_gen_str_t *jstr, float val)
+{
+	JSON_GEN_MEASURE_VALUE(jstr, json_gen_emit_float(jstr, val));
+}
+
+int json_gen_obj_set_float_n(json_gen_str_t *jstr, const char *name, size_t name_len, float val)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_float(jstr, val));
+}
+
+int json_gen_obj_set_float(json_gen_str_t *jstr, const char *name, float val)
+{
+	return json_gen_obj_set_float_n(jstr, name, strlen(name), val);
+}
+
+int json_gen_arr_set_float(json_gen_str_t *jstr, float val)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_float(jstr, val));
+}
+
+static int json_gen_emit_double(json_gen_str_t *jstr, double val)
+{
+	if (jstr->format) {
+		return json_gen_bin_set_real(jstr, val, true);
+	}
+	jstr->comma_req = true;
+	return json_gen_add_real(jstr, val, true);
+}
+
+static int json_gen_set_double(json_gen_str_t *jstr, double val)
+{
+	JSON_GEN_MEASURE_VALUE(jstr, json_gen_emit_double(jstr, val));
+}
+
+int json_gen_obj_set_double_n(json_gen_str_t *jstr, const char *name, size_t name_len, double val)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_double(jstr, val));
+}
+
+int json_gen_obj_set_double(json_gen_str_t *jstr, const char *name, double val)
+{
+	return json_gen_obj_set_double_n(jstr, name, strlen(name), val);
+}
+
+int json_gen_arr_set_double(json_gen_str_t *jstr, double val)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_double(jstr, val));
+}
+
+static int json_gen_emit_string_n(json_gen_str_t *jstr, const char *val, size_t val_len)
+{
+	if (jstr->format) {
+		return json_gen_bin_set_string(jstr, val, val_len);
+	}
+	jstr->comma_req = true;
+	/* Emit "val" in one go if it fits in the buffer and needs no escaping */
+	char *p = json_gen_get_space(jstr, val_len + 2);
+	if (p && (!jstr->escape || json_gen_scan_clean(val, val_len) == val_len)) {
+		p[0] = '"';
+		/* val may be NULL for an empty string */
+		if (val_len) {
+			memcpy(p + 1, val, val_len);
+			json_gen_stats_copied(jstr, val_len);
+		}
+		p[val_len + 1] = '"';
+		json_gen_advance(jstr, val_len + 2);
+		return 0;
+	}
+	json_gen_add_char(jstr, '"');
+	json_gen_add_string_body(jstr, val, val_len);
+	return json_gen_add_char(jstr, '"');
+}
+
+static int json_gen_set_string_n(json_gen_str_t *jstr, const char *val, size_t val_len)
+{
+	JSON_GEN_MEASURE_VALUE(jstr, json_gen_emit_string_n(jstr, val, val_len));
+}
+
+int json_gen_obj_set_string_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+		const char *val, size_t val_len)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_string_n(jstr, val, val_len));
+}
+
+int json_gen_obj_set_string(json_gen_str_t *jstr, const char *name, const char *val)
+{
+	return json_gen_obj_set_string_n(jstr, name, strlen(name), val, val ? strlen(val) : 0);
+}
+
+int json_gen_arr_set_string_n(json_gen_str_t *jstr, const char *val, size_t val_len)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_string_n(jstr, val, val_len));
+}
+
+int json_gen_arr_set_string(json_gen_str_t *jstr, const char *val)
+{
+	return json_gen_arr_set_string_n(jstr, val, val ? strlen(val) : 0);
+}
+
+static int json_gen_emit_base64(json_gen_str_t *jstr, const uint8_t *data, size_t len)
+{
+	if (jstr->format) {
+		return json_gen_bin_set_bytes(jstr, data, len);
+	}
+	jstr->comma_req = true;
+	size_t whole = len - len % 3;
+	int ret = json_gen_add_char(jstr, '"');
+	ret = json_gen_keep_again(ret, json_gen_add_encoded(jstr, data, whole, 3, 4,
+				json_gen_base64_encode));
+	if (whole != len) {
+		/* The last 1 or 2 bytes, padded with '=' to 4 characters */
+		uint32_t w = (uint32_t)data[whole] << 16;
+		if (len - whole == 2) {
+			w |= (uint32_t)data[whole + 1] << 8;
+		}
+		char tail[4] = {
+			json_gen_base64_chars[w >> 18],
+			json_gen_base64_chars[(w >> 12) & 0x3f],
+			len - whole == 2 ? json_gen_base64_chars[(w >> 6) & 0x3f] : '=',
+			'=',
+		};
+		ret = json_gen_keep_again(ret, json_gen_add_to_str_n(jstr, tail, sizeof(tail)));
+	}
+	return json_gen_keep_again(ret, json_gen_add_char(jstr, '"'));
+}
+
+static int json_gen_set_base64(json_gen_str_t *jstr, const void *data, size_t len)
+{
+	JSON_GEN_MEASURE_VALUE(jstr, json_gen_emit_base64(jstr, (const uint8_t *)data, len));
+}
+
+int json_gen_obj_set_base64_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+		const void *data, size_t len)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_base64(jstr, data, len));
+}
+
+int json_gen_obj_set_base64(json_gen_str_t *jstr, const char *name, const void *data, size_t len)
+{
+	return json_gen_obj_set_base64_n(jstr, name, strlen(name), data, len);
+}
+
+int json_gen_arr_set_base64(json_gen_str_t *jstr, const void *data, size_t len)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_base64(jstr, data, len));
+}
+
+static int json_gen_emit_hex(json_gen_str_t *jstr, const uint8_t *data, size_t len)
+{
+	if (jstr->format) {
+		return json_gen_bin_set_bytes(jstr, data, len);
+	}
+	jstr->comma_req = true;
+	int ret = json_gen_add_char(jstr, '"');
+	ret = json_gen_keep_again(ret, json_gen_add_encoded(jstr, data, len, 1, 2,
+				json_gen_hex_encode));
+	return json_gen_keep_again(ret, json_gen_add_char(jstr, '"'));
+}
+
+static int json_gen_set_hex(json_gen_str_t *jstr, const void *data, size_t len)
+{
+	JSON_GEN_MEASURE_VALUE(jstr, json_gen_emit_hex(jstr, (const uint8_t *)data, len));
+}
+
+int json_gen_obj_set_hex_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+		const void *data, size_t len)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_hex(jstr, data, len));
+}
+
+int json_gen_obj_set_hex(json_gen_str_t *jstr, const char *name, const void *data, size_t len)
+{
+	return json_gen_obj_set_hex_n(jstr, name, strlen(name), data, len);
+}
+
+int json_gen_arr_set_hex(json_gen_str_t *jstr, const void *data, size_t len)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_hex(jstr, data, len));
+}
+
+static int json_gen_set_long_string(json_gen_str_t *jstr, const char *val, size_t val_len)
+{
+	json_gen_set_state(jstr, JSON_GEN_STATE_LONG_STR);
+	jstr->stats_long_str_pos = jstr->total_len;
+	if (jstr->format) {
+		return json_gen_bin_start_long_string(jstr, val, val_len);
+	}
+	jstr->comma_req = true;
+	json_gen_add_char(jstr, '"');
+	return json_gen_add_string_body(jstr, val, val_len);
+}
+
+int json_gen_obj_start_long_string_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+		const char *val, size_t val_len)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, false);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_long_string(jstr, val, val_len));
+}
+
+int json_gen_obj_start_long_string(json_gen_str_t *jstr, const char *name, const char *val)
+{
+	return json_gen_obj_start_long_string_n(jstr, name, strlen(name),
+			val, val ? strlen(val) : 0);
+}
+
+int json_gen_arr_start_long_string_n(json_gen_str_t *jstr, const char *val, size_t val_len)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_long_string(jstr, val, val_len));
+}
+
+int json_gen_arr_start_long_string(json_gen_str_t *jstr, const char *val)
+{
+	return json_gen_arr_start_long_string_n(jstr, val, val ? strlen(val) : 0);
+}
+
+int json_gen_add_to_long_string_n(json_gen_str_t *jstr, const char *val, size_t val_len)
+{
+	json_gen_check_long_string(jstr, false);
+	if (!val_len) {
+		return json_gen_result(jstr, jstr->err);
+	}
+	if (jstr->format) {
+		return json_gen_result(jstr, json_gen_bin_add_to_long_string(jstr, val, val_len));
+	}
+	return json_gen_result(jstr, json_gen_add_string_body(jstr, val, val_len));
+}
+
+int json_gen_add_to_long_string(json_gen_str_t *jstr, const char *val)
+{
+	return json_gen_add_to_long_string_n(jstr, val, val ? strlen(val) : 0);
+}
+
+static int json_gen_emit_long_string_end(json_gen_str_t *jstr)
+{
+	if (jstr->format) {
+		return json_gen_bin_close(jstr);
+	}
+	return json_gen_add_char(jstr, '"');
+}
+
+int json_gen_end_long_string(json_gen_str_t *jstr)
+{
+	json_gen_check_long_string(jstr, true);
+	int ret = json_gen_emit_long_string_end(jstr);
+	json_gen_stats_value(jstr, jstr->stats_long_str_pos);
+	return json_gen_result(jstr, ret);
+}
+
+static int json_gen_emit_null(json_gen_str_t *jstr)
+{
+	if (jstr->format) {
+		return json_gen_bin_set_simple(jstr, JSON_GEN_CBOR_NULL, JSON_GEN_MSGPACK_NIL);
+	}
+	jstr->comma_req = true;
+	return json_gen_add_literal(jstr, "null");
+}
+
+static int json_gen_set_null(json_gen_str_t *jstr)
+{
+	JSON_GEN_MEASURE_VALUE(jstr, json_gen_emit_null(jstr));
+}
+
+int json_gen_obj_set_null_n(json_gen_str_t *jstr, const char *name, size_t name_len)
+{
+	JSON_GEN_TRACK_KEY(jstr, name, name_len, true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name_n(jstr, name, name_len);
+	return json_gen_result(jstr, json_gen_set_null(jstr));
+}
+
+int json_gen_obj_set_null(json_gen_str_t *jstr, const char *name)
+{
+	return json_gen_obj_set_null_n(jstr, name, strlen(name));
+}
+
+int json_gen_arr_set_null(json_gen_str_t *jstr)
+{
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_null(jstr));
+}
+
+/* Formats the value at index i of a bulk array. out has space for the maximum
+ * length of the value.
+ */
+typedef size_t (*json_gen_elem_fmt_t)(json_gen_str_t *jstr, char *out, const void *vals, size_t i);
+
+/* Adds values to an array in batches. As many values as can fit in the space
+ * left in the buffer are formatted in place in a tight loop. Only the value
+ * which may not fit goes through a scratch buffer and the regular flushing.
+ */
+static int json_gen_arr_set_bulk_pretty(json_gen_str_t *jstr, const void *vals, size_t count,
+		size_t elem_max, json_gen_elem_fmt_t fmt);
+
+static inline int json_gen_arr_set_bulk(json_gen_str_t *jstr, const void *vals, size_t count,
+		size_t elem_max, json_gen_elem_fmt_t fmt)
+{
+	if (json_gen_is_pretty(jstr)) {
+		return json_gen_arr_set_bulk_pretty(jstr, vals, count, elem_max, fmt);
+	}
+	int ret = 0;
+	size_t i = 0;
+	while (i < count) {
+		size_t fit = jstr->buf ? json_gen_get_empty_len(jstr) / (elem_max + 1) : 0;
+		if (fit) {
+			size_t end = count - i < fit ? count : i + fit;
+			char *p = jstr->free_ptr;
+			if (!jstr->comma_req) {
+				p += fmt(jstr, p, vals, i++);
+				jstr->comma_req = true;
+			}
+			for (; i < end; i++) {
+				*p++ = ',';
+				p += fmt(jstr, p, vals, i);
+			}
+			json_gen_advance(jstr, p - jstr->free_ptr);
+		} else {
+			char str[MAX_FLOAT_IN_STR + 1];
+			size_t len = 0;
+			if (jstr->comma_req) {
+				str[len++] = ',';
+			}
+			len += fmt(jstr, str + len, vals, i++);
+			jstr->comma_req = true;
+			ret = json_gen_keep_again(ret, json_gen_add_to_str_n(jstr, str, len));
+			if (json_gen_failed(ret)) {
+				return ret;
+			}
+		}
+	}
+	return ret;
+}
+
+/* Pretty printed, each element needs a line of its own */
+static int json_gen_arr_set_bulk_pretty(json_gen_str_t *jstr, const void *vals, size_t count,
+		size_t elem_max, json_gen_elem_fmt_t fmt)
+{
+	int ret = 0;
+	for (size_t i = 0; i < count; i++) {
+		char str[MAX_FLOAT_IN_STR];
+		json_gen_pretty_comma(jstr);
+		jstr->comma_req = true;
+		char *p = json_gen_get_space(jstr, elem_max);
+		size_t len = fmt(jstr, p ? p : str, vals, i);
+		if (p) {
+			json_gen_advance(jstr, len);
+		} else {
+			ret = json_gen_keep_again(ret, json_gen_add_to_str_n(jstr, str, len));
+			if (json_gen_failed(ret)) {
+				return ret;
+			}
+		}
+	}
+	return ret;
+}
+
+static size_t json_gen_fmt_int32_elem(json_gen_str_t *jstr, char *out, const void *vals, size_t i)
+{
+	return json_gen_fmt_i64(out, ((const int32_t *)vals)[i]);
+}
+
+int json_gen_arr_set_int_array(json_gen_str_t *jstr, const int32_t *vals, size_t count)
+{
+	/* -2147483648 */
+	json_gen_check_elem(jstr);
+	if (jstr->format) {
+		int ret = 0;
+		for (size_t i = 0; i < count && !json_gen_failed(ret); i++) {
+			ret = json_gen_keep_again(ret, json_gen_bin_set_int64(jstr, vals[i]));
+		}
+		return json_gen_result(jstr, ret);
+	}
+	return json_gen_result(jstr, json_gen_arr_set_bulk(jstr, vals, count, 11, json_gen_fmt_int32_elem));
+}
+
+static size_t json_gen_fmt_int64_elem(json_gen_str_t *jstr, char *out, const void *vals, size_t i)
+{
+	return json_gen_fmt_i64(out, ((const int64_t *)vals)[i]);
+}
+
+int json_gen_arr_set_int64_array(json_gen_str_t *jstr, const int64_t *vals, size_t count)
+{
+	json_gen_check_elem(jstr);
+	if (jstr->format) {
+		int ret = 0;
+		for (size_t i = 0; i < count && !json_gen_failed(ret); i++) {
+			ret = json_gen_keep_again(ret, json_gen_bin_set_int64(jstr, vals[i]));
+		}
+		return json_gen_result(jstr, ret);
+	}
+	return json_gen_result(jstr, json_gen_arr_set_bulk(jstr, vals, count, MAX_INT_IN_STR, json_gen_fmt_int64_elem));
+}
+
+static size_t json_gen_fmt_double_elem(json_gen_str_t *jstr, char *out, const void *vals, size_t i)
+{
+	return json_gen_fmt_real(jstr, out, ((const double *)vals)[i], true);
+}
+
+int json_gen_arr_set_double_array(json_gen_str_t *jstr, const double *vals, size_t count)
+{
+	json_gen_check_elem(jstr);
+	if (jstr->format) {
+		int ret = 0;
+		for (size_t i = 0; i < count && !json_gen_failed(ret); i++) {
+			ret = json_gen_keep_again(ret, json_gen_bin_set_real(jstr, vals[i], true));
+		}
+		return json_gen_result(jstr, ret);
+	}
+	return json_gen_result(jstr, json_gen_arr_set_bulk(jstr, vals, count, MAX_FLOAT_IN_STR, json_gen_fmt_double_elem));
+}
+
+static size_t json_gen_fmt_bool_elem(json_gen_str_t *jstr, char *out, const void *vals, size_t i)
+{
+	if (((const bool *)vals)[i]) {
+		memcpy(out, "true", 4);
+		return 4;
+	}
+	memcpy(out, "false", 5);
+	return 5;
+}
+
+int json_gen_arr_set_bool_array(json_gen_str_t *jstr, const bool *vals, size_t count)
 {
-	return (jstr->buf_size - (jstr->free_ptr - jstr->buf) - 1);
+	json_gen_check_elem(jstr);
+	if (jstr->format) {
+		int ret = 0;
+		for (size_t i = 0; i < count && !json_gen_failed(ret); i++) {
+			ret = json_gen_keep_again(ret, json_gen_set_bool(jstr, vals[i]));
+		}
+		return json_gen_result(jstr, ret);
+	}
+	return json_gen_result(jstr, json_gen_arr_set_bulk(jstr, vals, count, 5, json_gen_fmt_bool_elem));
 }
 
-/* This will add the incoming string to the JSON string buffer
- * and flush it out if the buffer is full. Note that the data being
- * flushed out will always be equal to the size of the buffer unless
- * this is the last chunk being flushed out on json_gen_end_str()
- */
-static int json_gen_add_to_str(json_gen_str_t *jstr, const char *str)
+static int json_gen_set_string_array(json_gen_str_t *jstr, const char **vals, size_t count)
 {
-    if (!str) {
-        return 0;
-    }
-	int len = strlen(str);
-    jstr->total_len += len;
-    if (jstr->buf == NULL) {
-        return 0;
-    }
-	const char *cur_ptr = str;
-	while (1) {
-		int len_remaining = json_gen_get_empty_len(jstr);
-		int copy_len = len_remaining > len ? len : len_remaining;
-		memmove(jstr->free_ptr, cur_ptr, copy_len);
-		cur_ptr += copy_len;
-		jstr->free_ptr += copy_len;
-		len -= copy_len;
-		if (len) {
-			*jstr->free_ptr = '\0';
-			/* Report error if the buffer is full and no flush callback
-			 * is registered
-			 */
-			if (!jstr->flush_cb) {
-				return -1;
-			}
-			jstr->flush_cb(jstr->buf, jstr->priv);
-			jstr->free_ptr = jstr->buf;
-		} else
-			break;
+	int ret = 0;
+	/* Strings have no maximum length, but json_gen_set_string_n() already adds
+	 * each of them in one go when it fits
+	 */
+	for (size_t i = 0; i < count && !json_gen_failed(ret); i++) {
+		json_gen_handle_comma(jstr);
+		if (vals[i]) {
+			ret = json_gen_keep_again(ret, json_gen_set_string_n(jstr, vals[i], strlen(vals[i])));
+		} else {
+			ret = json_gen_keep_again(ret, json_gen_set_null(jstr));
+		}
 	}
-	return 0;
+	return ret;
 }
 
+int json_gen_arr_set_string_array(json_gen_str_t *jstr, const char **vals, size_t count)
+{
+	json_gen_check_elem(jstr);
+	return json_gen_result(jstr, json_gen_set_string_array(jstr, vals, count));
+}
 
-void json_gen_str_start(json_gen_str_t *jstr, char *buf, int buf_size,
-		json_gen_flush_cb_t flush_cb, void *priv)
+int json_gen_obj_start_value_k(json_gen_str_t *jstr, const json_gen_key_t *key)
 {
-	memset(jstr, 0, sizeof(json_gen_str_t));
-	jstr->buf = buf;
-	jstr->buf_size = buf_size;
-	jstr->flush_cb = flush_cb;
-	jstr->free_ptr = buf;
-	jstr->priv = priv;
+	JSON_GEN_TRACK_KEY_K(jstr, key, false);
+	int ret = json_gen_handle_key(jstr, key);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, ret);
 }
 
-int json_gen_str_end(json_gen_str_t *jstr)
+int json_gen_obj_set_name_k(json_gen_str_t *jstr, const json_gen_key_t *key)
 {
-    int total_len = jstr->total_len;
-    if (jstr->buf) {
-	    *jstr->free_ptr = '\0';
-	    if (jstr->flush_cb)
-		    jstr->flush_cb(jstr->buf, jstr->priv);
-    }
-	memset(jstr, 0, sizeof(json_gen_str_t));
-    return total_len + 1; /* +1 for the NULL termination */
+	JSON_GEN_TRACK_KEY_K(jstr, key, false);
+	int ret = json_gen_handle_key(jstr, key);
+	jstr->comma_req = false;
+	json_gen_set_state(jstr, JSON_GEN_STATE_NAME);
+	return json_gen_result(jstr, ret);
 }
 
-static inline void json_gen_handle_comma(json_gen_str_t *jstr)
+int json_gen_push_object_k(json_gen_str_t *jstr, const json_gen_key_t *key)
 {
-	if (jstr->comma_req)
-		json_gen_add_to_str(jstr, ",");
+	JSON_GEN_TRACK_KEY_K(jstr, key, false);
+	json_gen_handle_key(jstr, key);
+	json_gen_push_level(jstr, false);
+	json_gen_keys_open(jstr);
+	jstr->comma_req = false;
+	return json_gen_result(jstr, json_gen_add_open(jstr, '{'));
 }
 
+int json_gen_push_array_k(json_gen_str_t *jstr, const json_gen_key_t *key)
+{
+	JSON_GEN_TRACK_KEY_K(jstr, key, false);
+	json_gen_handle_key(jstr, key);
+	json_gen_push_level(jstr, true);
+	jstr->comma_req = false;
+	return json_gen_result(jstr, json_gen_add_open(jstr, '['));
+}
 
-static int json_gen_handle_name(json_gen_str_t *jstr, const char *name)
+int json_gen_obj_set_bool_k(json_gen_str_t *jstr, const json_gen_key_t *key, bool val)
 {
-	json_gen_add_to_str(jstr, "\"");
-	json_gen_add_to_str(jstr, name);
-	return json_gen_add_to_str(jstr, "\":");
+	JSON_GEN_TRACK_KEY_K(jstr, key, true);
+	json_gen_handle_key(jstr, key);
+	return json_gen_result(jstr, json_gen_set_bool(jstr, val));
 }
 
+int json_gen_obj_set_int_k(json_gen_str_t *jstr, const json_gen_key_t *key, int val)
+{
+	JSON_GEN_TRACK_KEY_K(jstr, key, true);
+	json_gen_handle_key(jstr, key);
+	return json_gen_result(jstr, json_gen_set_int(jstr, val));
+}
 
-int json_gen_start_object(json_gen_str_t *jstr)
+int json_gen_obj_set_int64_k(json_gen_str_t *jstr, const json_gen_key_t *key, int64_t val)
 {
-	json_gen_handle_comma(jstr);
-	jstr->comma_req = false;
-	return json_gen_add_to_str(jstr, "{");
+	JSON_GEN_TRACK_KEY_K(jstr, key, true);
+	json_gen_handle_key(jstr, key);
+	return json_gen_result(jstr, json_gen_set_int64(jstr, val));
 }
 
-int json_gen_end_object(json_gen_str_t *jstr)
+int json_gen_obj_set_uint32_k(json_gen_str_t *jstr, const json_gen_key_t *key, uint32_t val)
 {
-	jstr->comma_req = true;
-	return json_gen_add_to_str(jstr, "}");
+	JSON_GEN_TRACK_KEY_K(jstr, key, true);
+	json_gen_handle_key(jstr, key);
+	return json_gen_result(jstr, json_gen_set_uint64(jstr, val));
 }
 
+int json_gen_obj_set_uint64_k(json_gen_str_t *jstr, const json_gen_key_t *key, uint64_t val)
+{
+	JSON_GEN_TRACK_KEY_K(jstr, key, true);
+	json_gen_handle_key(jstr, key);
+	return json_gen_result(jstr, json_gen_set_uint64(jstr, val));
+}
 
-int json_gen_start_array(json_gen_str_t *jstr)
+int json_gen_obj_set_float_k(json_gen_str_t *jstr, const json_gen_key_t *key, float val)
 {
-	json_gen_handle_comma(jstr);
-	jstr->comma_req = false;
-	return json_gen_add_to_str(jstr, "[");
+	JSON_GEN_TRACK_KEY_K(jstr, key, true);
+	json_gen_handle_key(jstr, key);
+	return json_gen_result(jstr, json_gen_set_float(jstr, val));
 }
 
-int json_gen_end_array(json_gen_str_t *jstr)
+int json_gen_obj_set_double_k(json_gen_str_t *jstr, const json_gen_key_t *key, double val)
 {
-	jstr->comma_req = true;
-	return json_gen_add_to_str(jstr, "]");
+	JSON_GEN_TRACK_KEY_K(jstr, key, true);
+	json_gen_handle_key(jstr, key);
+	return json_gen_result(jstr, json_gen_set_double(jstr, val));
 }
 
-int json_gen_push_object(json_gen_str_t *jstr, const char *name)
+int json_gen_obj_set_string_k_n(json_gen_str_t *jstr, const json_gen_key_t *key,
+		const char *val, size_t val_len)
 {
-	json_gen_handle_comma(jstr);
-	json_gen_handle_name(jstr, name);
-	jstr->comma_req = false;
-	return json_gen_add_to_str(jstr, "{");
+	JSON_GEN_TRACK_KEY_K(jstr, key, true);
+	json_gen_handle_key(jstr, key);
+	return json_gen_result(jstr, json_gen_set_string_n(jstr, val, val_len));
 }
 
-int json_gen_pop_object(json_gen_str_t *jstr)
+int json_gen_obj_set_string_k(json_gen_str_t *jstr, const json_gen_key_t *key, const char *val)
 {
-	jstr->comma_req = true;
-	return json_gen_add_to_str(jstr, "}");
+	return json_gen_obj_set_string_k_n(jstr, key, val, val ? strlen(val) : 0);
 }
 
-int json_gen_push_object_str(json_gen_str_t *jstr, const char *name, const char *object_str)
+int json_gen_obj_set_null_k(json_gen_str_t *jstr, const json_gen_key_t *key)
 {
-	json_gen_handle_comma(jstr);
-	json_gen_handle_name(jstr, name);
-	jstr->comma_req = true;
-	return json_gen_add_to_str(jstr, object_str);
+	JSON_GEN_TRACK_KEY_K(jstr, key, true);
+	json_gen_handle_key(jstr, key);
+	return json_gen_result(jstr, json_gen_set_null(jstr));
 }
 
-int json_gen_push_array(json_gen_str_t *jstr, const char *name)
+int json_gen_obj_start_long_string_k(json_gen_str_t *jstr, const json_gen_key_t *key,
+		const char *val)
 {
-	json_gen_handle_comma(jstr);
-	json_gen_handle_name(jstr, name);
+	JSON_GEN_TRACK_KEY_K(jstr, key, false);
+	json_gen_handle_key(jstr, key);
+	return json_gen_result(jstr, json_gen_set_long_string(jstr, val, val ? strlen(val) : 0));
+}
+
+/* Marks the end of a compiled struct. Its literal closes the object */
+#define JSON_GEN_OP_END     0xff
+
+/* A compiled field. The constant part of the JSON before the value, i.e. the
+ * separators, keys and the braces of embedded objects, is merged into a single
+ * literal.
+ */
+struct json_gen_struct_op {
+	size_t offset;
+	size_t count_offset;
+	size_t capacity;
+	size_t elem_size;
+	uint32_t lit_off;
+	uint32_t lit_len;
+	uint32_t sub;
+	uint8_t type;
+	uint8_t elem_type;
+};
+
+typedef struct {
+	struct json_gen_struct_op *ops;
+	uint32_t num_ops;
+	char *lits;
+	uint32_t lits_len;
+	/* Start of the literals still to be attached to the next op */
+	uint32_t pending;
+	/* Structs to be compiled as separate programs. Each struct is compiled only
+	 * once, so recursive structs are supported.
+	 */
+	const json_gen_struct_desc_t *descs[JSON_GEN_MAX_STRUCT_DESCS];
+	uint32_t starts[JSON_GEN_MAX_STRUCT_DESCS];
+	int num_descs;
+} json_gen_struct_compiler_t;
+
+static int json_gen_struct_add_lit(json_gen_struct_compiler_t *c, const char *str, size_t len)
+{
+	char *lits = realloc(c->lits, c->lits_len + len + 1);
+	if (!lits) {
+		return -1;
+	}
+	memcpy(lits + c->lits_len, str, len);
+	c->lits = lits;
+	c->lits_len += len;
+	return 0;
+}
+
+static int json_gen_struct_add_key(json_gen_struct_compiler_t *c, const char *name, bool first)
+{
+	size_t len = strlen(name);
+	if ((!first && json_gen_struct_add_lit(c, ",", 1) != 0) ||
+			json_gen_struct_add_lit(c, "\"", 1) != 0 ||
+			json_gen_struct_add_lit(c, name, len) != 0) {
+		return -1;
+	}
+	return json_gen_struct_add_lit(c, "\":", 2);
+}
+
+/* Adds an op, with the pending literal attached to it */
+static struct json_gen_struct_op *json_gen_struct_add_op(json_gen_struct_compiler_t *c, uint8_t type)
+{
+	struct json_gen_struct_op *ops = realloc(c->ops, (c->num_ops + 1) * sizeof(*ops));
+	if (!ops) {
+		return NULL;
+	}
+	c->ops = ops;
+	struct json_gen_struct_op *op = &ops[c->num_ops++];
+	memset(op, 0, sizeof(*op));
+	op->type = type;
+	op->lit_off = c->pending;
+	op->lit_len = c->lits_len - c->pending;
+	c->pending = c->lits_len;
+	return op;
+}
+
+static size_t json_gen_field_size(json_gen_field_type_t type, const json_gen_struct_desc_t *desc)
+{
+	switch (type) {
+		case JSON_GEN_FIELD_BOOL:
+			return sizeof(bool);
+		case JSON_GEN_FIELD_INT32:
+		case JSON_GEN_FIELD_UINT32:
+			return sizeof(int32_t);
+		case JSON_GEN_FIELD_INT64:
+		case JSON_GEN_FIELD_UINT64:
+			return sizeof(int64_t);
+		case JSON_GEN_FIELD_FLOAT:
+			return sizeof(float);
+		case JSON_GEN_FIELD_DOUBLE:
+			return sizeof(double);
+		case JSON_GEN_FIELD_STRING:
+			return sizeof(const char *);
+		case JSON_GEN_FIELD_OBJECT:
+			return desc ? desc->size : 0;
+		default:
+			return 0;
+	}
+}
+
+static int json_gen_struct_desc_index(json_gen_struct_compiler_t *c,
+		const json_gen_struct_desc_t *desc);
+
+/* Embedded objects are flattened into the fields of the parent, so that their
+ * braces and keys get merged with the literals around them.
+ */
+static int json_gen_struct_compile_fields(json_gen_struct_compiler_t *c,
+		const json_gen_struct_desc_t *desc, size_t base)
+{
+	for (size_t i = 0; i < desc->num_fields; i++) {
+		const json_gen_field_t *field = &desc->fields[i];
+		if (json_gen_struct_add_key(c, field->name, i == 0) != 0) {
+			return -1;
+		}
+		if (field->type == JSON_GEN_FIELD_OBJECT) {
+			if (!field->desc || json_gen_struct_add_lit(c, "{", 1) != 0 ||
+					json_gen_struct_compile_fields(c, field->desc, base + field->offset) != 0 ||
+					json_gen_struct_add_lit(c, "}", 1) != 0) {
+				return -1;
+			}
+			continue;
+		}
+		if (field->type == JSON_GEN_FIELD_ARRAY) {
+			size_t elem_size = json_gen_field_size(field->elem_type, field->desc);
+			if (!elem_size || json_gen_struct_add_lit(c, "[", 1) != 0) {
+				return -1;
+			}
+			struct json_gen_struct_op *op = json_gen_struct_add_op(c, field->type);
+			if (!op) {
+				return -1;
+			}
+			op->offset = base + field->offset;
+			op->count_offset = base + field->count_offset;
+			op->capacity = field->capacity / elem_size;
+			op->elem_size = elem_size;
+			op->elem_type = field->elem_type;
+			if (field->elem_type == JSON_GEN_FIELD_OBJECT) {
+				/* The elements are encoded by a separate program, compiled later */
+				int idx = json_gen_struct_desc_index(c, field->desc);
+				if (idx < 0) {
+					return -1;
+				}
+				op->sub = idx;
+			}
+			if (json_gen_struct_add_lit(c, "]", 1) != 0) {
+				return -1;
+			}
+			continue;
+		}
+		if (field->type > JSON_GEN_FIELD_CHARS) {
+			return -1;
+		}
+		struct json_gen_struct_op *op = json_gen_struct_add_op(c, field->type);
+		if (!op) {
+			return -1;
+		}
+		op->offset = base + field->offset;
+		op->capacity = field->capacity;
+	}
+	return 0;
+}
+
+/* Returns the index of the struct in the list of structs to be compiled as
+ * separate programs, adding it if required
+ */
+static int json_gen_struct_desc_index(json_gen_struct_compiler_t *c,
+		const json_gen_struct_desc_t *desc)
+{
+	if (!desc) {
+		return -1;
+	}
+	for (int i = 0; i < c->num_descs; i++) {
+		if (c->descs[i] == desc) {
+			return i;
+		}
+	}
+	if (c->num_descs == JSON_GEN_MAX_STRUCT_DESCS) {
+		return -1;
+	}
+	c->descs[c->num_descs] = desc;
+	return c->num_descs++;
+}
+
+int json_gen_struct_compile(json_gen_struct_desc_t *desc)
+{
+	json_gen_struct_compiler_t c;
+	memset(&c, 0, sizeof(c));
+	json_gen_struct_free(desc);
+	c.descs[0] = desc;
+	c.num_descs = 1;
+	/* Structs found in arrays get appended to the list while compiling */
+	for (int i = 0; i < c.num_descs; i++) {
+		c.starts[i] = c.num_ops;
+		if (json_gen_struct_add_lit(&c, "{", 1) != 0 ||
+				json_gen_struct_compile_fields(&c, c.descs[i], 0) != 0 ||
+				json_gen_struct_add_lit(&c, "}", 1) != 0 ||
+				!json_gen_struct_add_op(&c, JSON_GEN_OP_END)) {
+			free(c.ops);
+			free(c.lits);
+			return -1;
+		}
+	}
+	for (uint32_t i = 0; i < c.num_ops; i++) {
+		if (c.ops[i].type == JSON_GEN_FIELD_ARRAY && c.ops[i].elem_type == JSON_GEN_FIELD_OBJECT) {
+			c.ops[i].sub = c.starts[c.ops[i].sub];
+		}
+	}
+	desc->ops = c.ops;
+	desc->lits = c.lits;
+	return 0;
+}
+
+void json_gen_struct_free(json_gen_struct_desc_t *desc)
+{
+	free(desc->ops);
+	free(desc->lits);
+	desc->ops = NULL;
+	desc->lits = NULL;
+}
+
+static int json_gen_encode_ops(json_gen_str_t *jstr, const json_gen_struct_desc_t *desc,
+		uint32_t start, const char *base);
+
+static int json_gen_encode_array(json_gen_str_t *jstr, const json_gen_struct_desc_t *desc,
+		const struct json_gen_struct_op *op, const char *base)
+{
+	const char *elems = base + op->offset;
+	size_t count = *(const size_t *)(base + op->count_offset);
+	if (op->capacity) {
+		if (count > op->capacity) {
+			count = op->capacity;
+		}
+	} else {
+		elems = *(const char * const *)elems;
+		if (!elems) {
+			count = 0;
+		}
+	}
 	jstr->comma_req = false;
-	return json_gen_add_to_str(jstr, "[");
+	int ret = 0;
+	switch (op->elem_type) {
+		case JSON_GEN_FIELD_BOOL:
+			return json_gen_arr_set_bulk(jstr, elems, count, 5, json_gen_fmt_bool_elem);
+		case JSON_GEN_FIELD_INT32:
+			return json_gen_arr_set_bulk(jstr, elems, count, 11, json_gen_fmt_int32_elem);
+		case JSON_GEN_FIELD_INT64:
+			return json_gen_arr_set_bulk(jstr, elems, count, MAX_INT_IN_STR, json_gen_fmt_int64_elem);
+		case JSON_GEN_FIELD_DOUBLE:
+			return json_gen_arr_set_bulk(jstr, elems, count, MAX_FLOAT_IN_STR, json_gen_fmt_double_elem);
+		case JSON_GEN_FIELD_STRING:
+			return json_gen_set_string_array(jstr, (const char **)elems, count);
+		case JSON_GEN_FIELD_UINT32:
+			for (size_t i = 0; i < count && !json_gen_failed(ret); i++) {
+				json_gen_handle_comma(jstr);
+				ret = json_gen_keep_again(ret,
+						json_gen_set_uint64(jstr, ((const uint32_t *)elems)[i]));
+			}
+			return ret;
+		case JSON_GEN_FIELD_UINT64:
+			for (size_t i = 0; i < count && !json_gen_failed(ret); i++) {
+				json_gen_handle_comma(jstr);
+				ret = json_gen_keep_again(ret,
+						json_gen_set_uint64(jstr, ((const uint64_t *)elems)[i]));
+			}
+			return ret;
+		case JSON_GEN_FIELD_FLOAT:
+			for (size_t i = 0; i < count && !json_gen_failed(ret); i++) {
+				json_gen_handle_comma(jstr);
+				ret = json_gen_keep_again(ret, json_gen_set_float(jstr, ((const float *)elems)[i]));
+			}
+			return ret;
+		case JSON_GEN_FIELD_OBJECT:
+			for (size_t i = 0; i < count && !json_gen_failed(ret); i++) {
+				if (i) {
+					json_gen_add_char(jstr, ',');
+				}
+				ret = json_gen_keep_again(ret,
+						json_gen_encode_ops(jstr, desc, op->sub, elems + i * op->elem_size));
+			}
+			return ret;
+		default:
+			return -1;
+	}
 }
-int json_gen_pop_array(json_gen_str_t *jstr)
+
+static int json_gen_encode_ops(json_gen_str_t *jstr, const json_gen_struct_desc_t *desc,
+		uint32_t start, const char *base)
+{
+	int ret = 0;
+	for (const struct json_gen_struct_op *op = desc->ops + start; ; op++) {
+		int r = json_gen_add_to_str_n(jstr, desc->lits + op->lit_off, op->lit_len);
+		const char *p = base + op->offset;
+		switch (op->type) {
+			case JSON_GEN_OP_END:
+				return r ? r : ret;
+			case JSON_GEN_FIELD_BOOL:
+				r = json_gen_set_bool(jstr, *(const bool *)p);
+				break;
+			case JSON_GEN_FIELD_INT32:
+				r = json_gen_add_number(jstr, (uint64_t)(int64_t)*(const int32_t *)p, true);
+				break;
+			case JSON_GEN_FIELD_INT64:
+				r = json_gen_add_number(jstr, (uint64_t)*(const int64_t *)p, true);
+				break;
+			case JSON_GEN_FIELD_UINT32:
+				r = json_gen_add_number(jstr, *(const uint32_t *)p, false);
+				break;
+			case JSON_GEN_FIELD_UINT64:
+				r = json_gen_add_number(jstr, *(const uint64_t *)p, false);
+				break;
+			case JSON_GEN_FIELD_FLOAT:
+				r = json_gen_add_real(jstr, *(const float *)p, false);
+				break;
+			case JSON_GEN_FIELD_DOUBLE:
+				r = json_gen_add_real(jstr, *(const double *)p, true);
+				break;
+			case JSON_GEN_FIELD_STRING: {
+				const char *str = *(const char * const *)p;
+				r = str ? json_gen_set_string_n(jstr, str, strlen(str)) : json_gen_set_null(jstr);
+				break;
+			}
+			case JSON_GEN_FIELD_CHARS: {
+				const char *end = memchr(p, '\0', op->capacity);
+				r = json_gen_set_string_n(jstr, p, end ? (size_t)(end - p) : op->capacity);
+				break;
+			}
+			case JSON_GEN_FIELD_ARRAY:
+				r = json_gen_encode_array(jstr, desc, op, base);
+				break;
+		}
+		if (r) {
+			ret = r;
+		}
+	}
+}
+
+/* The programs emit compact JSON, even if the JSON string is pretty printed */
+static int json_gen_encode_ops_compact(json_gen_str_t *jstr, const json_gen_struct_desc_t *desc,
+		const void *obj)
 {
+	uint8_t indent = jstr->indent;
+	jstr->indent = 0;
+	int ret = json_gen_encode_ops(jstr, desc, 0, obj);
+	jstr->indent = indent;
+	return ret;
+}
+
+int json_gen_encode_struct(json_gen_str_t *jstr, const json_gen_struct_desc_t *desc, const void *obj)
+{
+	if (!desc->ops) {
+		return -1;
+	}
+	/* The programs have the names pre-rendered as JSON text */
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	json_gen_handle_elem(jstr);
+	int ret = json_gen_encode_ops_compact(jstr, desc, obj);
 	jstr->comma_req = true;
-	return json_gen_add_to_str(jstr, "]");
+	return json_gen_result(jstr, ret);
 }
 
-int json_gen_push_array_str(json_gen_str_t *jstr, const char *name, const char *array_str)
+int json_gen_obj_set_struct(json_gen_str_t *jstr, const char *name,
+		const json_gen_struct_desc_t *desc, const void *obj)
 {
-	json_gen_handle_comma(jstr);
+	if (!desc->ops) {
+		return -1;
+	}
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	JSON_GEN_TRACK_KEY(jstr, name, strlen(name), true);
+	json_gen_handle_member(jstr);
 	json_gen_handle_name(jstr, name);
+	int ret = json_gen_encode_ops_compact(jstr, desc, obj);
 	jstr->comma_req = true;
-	return json_gen_add_to_str(jstr, array_str);
+	return json_gen_result(jstr, ret);
 }
 
-static int json_gen_set_bool(json_gen_str_t *jstr, bool val)
+int json_gen_prepare_start(json_gen_str_t *jstr, json_gen_prepared_t *prep)
 {
-	jstr->comma_req = true;
-	if (val)
-		return json_gen_add_to_str(jstr, "true");
-	else
-		return json_gen_add_to_str(jstr, "false");
+	memset(prep, 0, sizeof(json_gen_prepared_t));
+	if (json_gen_str_start_growable(jstr, &prep->gbuf, 0, NULL) != 0) {
+		return -1;
+	}
+	jstr->prepared = prep;
+	return 0;
 }
-int json_gen_obj_set_bool(json_gen_str_t *jstr, const char *name, bool val)
+
+int json_gen_prepare_end(json_gen_str_t *jstr)
 {
-	json_gen_handle_comma(jstr);
-	json_gen_handle_name(jstr, name);
-	return json_gen_set_bool(jstr, val);
+	json_gen_prepared_t *prep = jstr->prepared;
+	if (!prep) {
+		return -1;
+	}
+	size_t len = 0;
+	prep->text = json_gen_str_end_growable(jstr, &len);
+	prep->text_len = len;
+	if (!prep->text || prep->failed) {
+		json_gen_prepared_free(prep);
+		return -1;
+	}
+	return 0;
 }
 
-int json_gen_arr_set_bool(json_gen_str_t *jstr, bool val)
+void json_gen_prepared_free(json_gen_prepared_t *prep)
 {
-	json_gen_handle_comma(jstr);
-	return json_gen_set_bool(jstr, val);
+	free(prep->text);
+	free(prep->slots);
+	prep->text = NULL;
+	prep->slots = NULL;
+	prep->text_len = 0;
+	prep->num_slots = 0;
 }
 
-static int json_gen_set_int(json_gen_str_t *jstr, int val)
+/* The slot is at the current end of the text. The generated data is all in the
+ * growable buffer, so its offset is the total length.
+ */
+static int json_gen_add_slot(json_gen_str_t *jstr, json_gen_value_type_t type)
 {
+	json_gen_prepared_t *prep = jstr->prepared;
 	jstr->comma_req = true;
-	char str[MAX_INT_IN_STR];
-	snprintf(str, MAX_INT_IN_STR, "%d", val);
-	return json_gen_add_to_str(jstr, str);
+	json_gen_slot_t *slots = realloc(prep->slots, (prep->num_slots + 1) * sizeof(json_gen_slot_t));
+	if (!slots) {
+		prep->failed = true;
+		return -1;
+	}
+	prep->slots = slots;
+	slots[prep->num_slots].offset = jstr->total_len;
+	slots[prep->num_slots].type = type;
+	return prep->num_slots++;
 }
 
-int json_gen_obj_set_int(json_gen_str_t *jstr, const char *name, int val)
+int json_gen_obj_set_slot(json_gen_str_t *jstr, const char *name, json_gen_value_type_t type)
 {
-	json_gen_handle_comma(jstr);
+	if (!jstr->prepared) {
+		return -1;
+	}
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	JSON_GEN_TRACK_KEY(jstr, name, strlen(name), false);
+	json_gen_handle_member(jstr);
 	json_gen_handle_name(jstr, name);
-	return json_gen_set_int(jstr, val);
+	return json_gen_result(jstr, json_gen_add_slot(jstr, type));
 }
 
-int json_gen_arr_set_int(json_gen_str_t *jstr, int val)
+int json_gen_arr_set_slot(json_gen_str_t *jstr, json_gen_value_type_t type)
 {
-	json_gen_handle_comma(jstr);
-	return json_gen_set_int(jstr, val);
+	if (!jstr->prepared) {
+		return -1;
+	}
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_add_slot(jstr, type));
 }
 
-static int json_gen_set_int64(json_gen_str_t *jstr, int64_t val)
+static int json_gen_add_value(json_gen_str_t *jstr, const json_gen_value_t *val)
 {
-	jstr->comma_req = true;
-	char str[MAX_INT_IN_STR];
-	snprintf(str, MAX_INT_IN_STR, "%lld", val);
-	return json_gen_add_to_str(jstr, str);
+	switch (val->type) {
+		case JSON_GEN_VALUE_NULL:
+			return json_gen_set_null(jstr);
+		case JSON_GEN_VALUE_BOOL:
+			return json_gen_set_bool(jstr, val->u.b);
+		case JSON_GEN_VALUE_INT64:
+			return json_gen_set_int64(jstr, val->u.i64);
+		case JSON_GEN_VALUE_UINT64:
+			return json_gen_set_uint64(jstr, val->u.u64);
+		case JSON_GEN_VALUE_FLOAT:
+			return json_gen_set_float(jstr, val->u.d);
+		case JSON_GEN_VALUE_DOUBLE:
+			return json_gen_set_double(jstr, val->u.d);
+		case JSON_GEN_VALUE_STRING:
+			return json_gen_set_string_n(jstr, val->u.str.ptr, val->u.str.len);
+		case JSON_GEN_VALUE_RAW:
+			jstr->comma_req = true;
+			return json_gen_add_to_str_n(jstr, val->u.str.ptr, val->u.str.len);
+		default:
+			return -1;
+	}
 }
 
-int json_gen_obj_set_int64(json_gen_str_t *jstr, const char *name, int64_t val)
+static int json_gen_render_slots(const json_gen_prepared_t *prep, const json_gen_value_t *values,
+		json_gen_str_t *jstr)
 {
-	json_gen_handle_comma(jstr);
-	json_gen_handle_name(jstr, name);
-	return json_gen_set_int64(jstr, val);
+	int ret = 0;
+	size_t offset = 0;
+	for (size_t i = 0; i < prep->num_slots; i++) {
+		int r = json_gen_add_to_str_n(jstr, prep->text + offset, prep->slots[i].offset - offset);
+		if (!json_gen_failed(r)) {
+			r = json_gen_keep_again(r, json_gen_add_value(jstr, &values[i]));
+		}
+		if (r) {
+			ret = r;
+		}
+		offset = prep->slots[i].offset;
+	}
+	int r = json_gen_add_to_str_n(jstr, prep->text + offset, prep->text_len - offset);
+	jstr->comma_req = true;
+	return r ? r : ret;
 }
 
-int json_gen_arr_set_int64(json_gen_str_t *jstr, int64_t val)
+static bool json_gen_check_values(const json_gen_prepared_t *prep, const json_gen_value_t *values)
 {
-	json_gen_handle_comma(jstr);
-	return json_gen_set_int64(jstr, val);
+	if (!prep->text) {
+		return false;
+	}
+	for (size_t i = 0; i < prep->num_slots; i++) {
+		if (values[i].type != prep->slots[i].type && values[i].type != JSON_GEN_VALUE_NULL) {
+			return false;
+		}
+	}
+	return true;
 }
 
-static int json_gen_set_float(json_gen_str_t *jstr, float val)
+int json_gen_render(const json_gen_prepared_t *prep, const json_gen_value_t *values,
+		json_gen_str_t *jstr)
 {
-	jstr->comma_req = true;
-	char str[MAX_FLOAT_IN_STR];
-	snprintf(str, MAX_FLOAT_IN_STR, "%.*f", JSON_FLOAT_PRECISION, val);
-	return json_gen_add_to_str(jstr, str);
+	if (!json_gen_check_values(prep, values)) {
+		return -1;
+	}
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	json_gen_handle_elem(jstr);
+	return json_gen_result(jstr, json_gen_render_slots(prep, values, jstr));
 }
-int json_gen_obj_set_float(json_gen_str_t *jstr, const char *name, float val)
+
+int json_gen_obj_render(const json_gen_prepared_t *prep, const json_gen_value_t *values,
+		json_gen_str_t *jstr, const char *name)
 {
-	json_gen_handle_comma(jstr);
+	if (!json_gen_check_values(prep, values)) {
+		return -1;
+	}
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	JSON_GEN_TRACK_KEY(jstr, name, strlen(name), true);
+	json_gen_handle_member(jstr);
 	json_gen_handle_name(jstr, name);
-	return json_gen_set_float(jstr, val);
+	return json_gen_result(jstr, json_gen_render_slots(prep, values, jstr));
 }
-int json_gen_arr_set_float(json_gen_str_t *jstr, float val)
+
+/* The most a value can take when formatted in place, or 0 if it has to go through
+ * json_gen_add_value()
+ */
+static size_t json_gen_value_max(json_gen_str_t *jstr, const json_gen_value_t *val)
 {
-	json_gen_handle_comma(jstr);
-	return json_gen_set_float(jstr, val);
+	switch (val->type) {
+		case JSON_GEN_VALUE_NULL:
+			return 4;
+		case JSON_GEN_VALUE_BOOL:
+			return 5;
+		case JSON_GEN_VALUE_INT64:
+		case JSON_GEN_VALUE_UINT64:
+			return MAX_INT_IN_STR;
+		case JSON_GEN_VALUE_FLOAT:
+		case JSON_GEN_VALUE_DOUBLE:
+			return MAX_FLOAT_IN_STR;
+		case JSON_GEN_VALUE_STRING:
+			if (jstr->escape && json_gen_scan_clean(val->u.str.ptr, val->u.str.len) !=
+					val->u.str.len) {
+				return 0;
+			}
+			return val->u.str.len + 2;
+		case JSON_GEN_VALUE_RAW:
+			return val->u.str.len;
+		default:
+			return 0;
+	}
 }
 
-static int json_gen_set_string(json_gen_str_t *jstr, const char *val)
+/* Same as json_gen_add_value(), into space already checked as per json_gen_value_max() */
+static size_t json_gen_fmt_value(json_gen_str_t *jstr, char *out, const json_gen_value_t *val)
 {
-	jstr->comma_req = true;
-	json_gen_add_to_str(jstr, "\"");
-	json_gen_add_to_str(jstr, val);
-	return json_gen_add_to_str(jstr, "\"");
+	switch (val->type) {
+		case JSON_GEN_VALUE_NULL:
+			memcpy(out, "null", 4);
+			return 4;
+		case JSON_GEN_VALUE_BOOL:
+			return json_gen_fmt_bool_elem(jstr, out, &val->u.b, 0);
+		case JSON_GEN_VALUE_INT64:
+			return json_gen_fmt_i64(out, val->u.i64);
+		case JSON_GEN_VALUE_UINT64:
+			return json_gen_fmt_u64(out, val->u.u64);
+		case JSON_GEN_VALUE_FLOAT:
+			return json_gen_fmt_real(jstr, out, (float)val->u.d, false);
+		case JSON_GEN_VALUE_DOUBLE:
+			return json_gen_fmt_real(jstr, out, val->u.d, true);
+		case JSON_GEN_VALUE_STRING:
+			out[0] = '"';
+			memcpy(out + 1, val->u.str.ptr, val->u.str.len);
+			json_gen_stats_copied(jstr, val->u.str.len);
+			out[val->u.str.len + 1] = '"';
+			return val->u.str.len + 2;
+		default:
+			memcpy(out, val->u.str.ptr, val->u.str.len);
+			json_gen_stats_copied(jstr, val->u.str.len);
+			return val->u.str.len;
+	}
 }
 
-int json_gen_obj_set_string(json_gen_str_t *jstr, const char *name, const char *val)
+int json_gen_obj_set_map(json_gen_str_t *jstr, const char **keys, const size_t *key_lens,
+		const json_gen_value_t *values, size_t count)
 {
-	json_gen_handle_comma(jstr);
-	json_gen_handle_name(jstr, name);
-	return json_gen_set_string(jstr, val);
+	bool direct = !jstr->format && !json_gen_is_pretty(jstr);
+	int ret = 0;
+	json_gen_check_member(jstr);
+	for (size_t i = 0; i < count && !json_gen_failed(ret); i++) {
+		const json_gen_value_t *val = &values[i];
+		if (val->type > JSON_GEN_VALUE_RAW) {
+			return -1;
+		}
+		if (jstr->format && val->type == JSON_GEN_VALUE_RAW) {
+			return json_gen_bin_unsupported(jstr);
+		}
+		const char *key = keys[i];
+		size_t key_len = key_lens ? key_lens[i] : strlen(key);
+		if (jstr->keys) {
+			int key_ret = json_gen_track_key(jstr, key, key_len, true);
+			if (key_ret == JSON_GEN_KEY_SKIPPED) {
+				continue;
+			} else if (key_ret) {
+				return key_ret;
+			}
+		}
+		/* ,"key": and the value go in one go, if there is space for the most they can take */
+		size_t value_max = direct ? json_gen_value_max(jstr, val) : 0;
+		char *p = NULL;
+		if (value_max && (!jstr->escape || json_gen_scan_clean(key, key_len) == key_len)) {
+			p = json_gen_get_space(jstr, key_len + 4 + value_max);
+		}
+		if (p) {
+			char *start = p;
+			if (jstr->comma_req) {
+				*p++ = ',';
+			}
+			*p++ = '"';
+			memcpy(p, key, key_len);
+			json_gen_stats_copied(jstr, key_len);
+			p += key_len;
+			*p++ = '"';
+			*p++ = ':';
+			p += json_gen_fmt_value(jstr, p, val);
+			jstr->comma_req = true;
+			json_gen_advance(jstr, p - start);
+		} else {
+			json_gen_handle_member(jstr);
+			json_gen_handle_name_n(jstr, key, key_len);
+			ret = json_gen_keep_again(ret, json_gen_add_value(jstr, val));
+		}
+	}
+	return json_gen_result(jstr, ret);
 }
 
-int json_gen_arr_set_string(json_gen_str_t *jstr, const char *val)
+static int json_gen_retained_flush(const char *buf, size_t len, void *priv)
 {
-	json_gen_handle_comma(jstr);
-	return json_gen_set_string(jstr, val);
+	json_gen_retained_t *doc = (json_gen_retained_t *)priv;
+	if (json_gen_grow_buf(&doc->scratch, &doc->scratch_cap, doc->scratch_len + len) != 0) {
+		return -1;
+	}
+	memcpy(doc->scratch + doc->scratch_len, buf, len);
+	doc->scratch_len += len;
+	return 0;
 }
 
-static int json_gen_set_long_string(json_gen_str_t *jstr, const char *val)
+/* Format a value into the scratch buffer, the same way json_gen_render() would */
+static int json_gen_retained_format(json_gen_retained_t *doc, const json_gen_value_t *val)
 {
-	jstr->comma_req = true;
-	json_gen_add_to_str(jstr, "\"");
-	return json_gen_add_to_str(jstr, val);
+	char buf[MAX_FLOAT_IN_STR + 2];
+	json_gen_str_t jstr;
+	doc->scratch_len = 0;
+	json_gen_str_start_v2(&jstr, buf, sizeof(buf), json_gen_retained_flush, doc);
+	jstr.float_fmt = doc->float_fmt;
+	jstr.float_precision = doc->float_precision;
+	jstr.escape = doc->escape;
+	json_gen_add_value(&jstr, val);
+	return json_gen_str_end(&jstr) < 0 ? -1 : 0;
 }
 
-int json_gen_obj_start_long_string(json_gen_str_t *jstr, const char *name, const char *val)
+/* Strings are not compared, since the caller may have changed the data in place */
+static bool json_gen_retained_same(const json_gen_value_t *a, const json_gen_value_t *b)
 {
-	json_gen_handle_comma(jstr);
-	json_gen_handle_name(jstr, name);
-    return json_gen_set_long_string(jstr, val);
+	if (a->type != b->type) {
+		return false;
+	}
+	switch (a->type) {
+		case JSON_GEN_VALUE_NULL:
+			return true;
+		case JSON_GEN_VALUE_BOOL:
+			return a->u.b == b->u.b;
+		case JSON_GEN_VALUE_INT64:
+			return a->u.i64 == b->u.i64;
+		case JSON_GEN_VALUE_UINT64:
+			return a->u.u64 == b->u.u64;
+		case JSON_GEN_VALUE_FLOAT:
+		case JSON_GEN_VALUE_DOUBLE:
+			/* Bitwise, so that -0 and NaN are handled too */
+			return memcmp(&a->u.d, &b->u.d, sizeof(double)) == 0;
+		default:
+			return false;
+	}
 }
 
-int json_gen_arr_start_long_string(json_gen_str_t *jstr, const char *val)
+static bool json_gen_retained_check(const json_gen_retained_slot_t *slot,
+		const json_gen_value_t *val)
 {
-	json_gen_handle_comma(jstr);
-    return json_gen_set_long_string(jstr, val);
+	return val->type == slot->type || val->type == JSON_GEN_VALUE_NULL;
 }
 
-int json_gen_add_to_long_string(json_gen_str_t *jstr, const char *val)
+int json_gen_retained_start(json_gen_retained_t *doc, const json_gen_prepared_t *prep,
+		const json_gen_value_t *values, const json_gen_str_t *fmt)
+{
+	memset(doc, 0, sizeof(json_gen_retained_t));
+	if (!json_gen_check_values(prep, values)) {
+		return -1;
+	}
+	json_gen_str_t defaults;
+	if (!fmt) {
+		json_gen_str_start(&defaults, NULL, 0, NULL, NULL);
+		fmt = &defaults;
+	}
+	doc->float_fmt = fmt->float_fmt;
+	doc->float_precision = fmt->float_precision;
+	doc->escape = fmt->escape;
+	if (prep->num_slots) {
+		doc->slots = calloc(prep->num_slots, sizeof(json_gen_retained_slot_t));
+		if (!doc->slots) {
+			return -1;
+		}
+	}
+	doc->num_slots = prep->num_slots;
+	size_t offset = 0;
+	for (size_t i = 0; i <= prep->num_slots; i++) {
+		size_t end = i < prep->num_slots ? prep->slots[i].offset : prep->text_len;
+		size_t len = 0;
+		if (i < prep->num_slots) {
+			if (json_gen_retained_format(doc, &values[i]) != 0) {
+				json_gen_retained_free(doc);
+				return -1;
+			}
+			len = doc->scratch_len;
+		}
+		if (json_gen_grow_buf(&doc->text, &doc->text_cap,
+					doc->text_len + end - offset + len) != 0) {
+			json_gen_retained_free(doc);
+			return -1;
+		}
+		memcpy(doc->text + doc->text_len, prep->text + offset, end - offset);
+		doc->text_len += end - offset;
+		if (i < prep->num_slots) {
+			json_gen_retained_slot_t *slot = &doc->slots[i];
+			slot->offset = doc->text_len;
+			slot->len = len;
+			slot->type = prep->slots[i].type;
+			slot->value = values[i];
+			memcpy(doc->text + doc->text_len, doc->scratch, len);
+			doc->text_len += len;
+		}
+		offset = end;
+	}
+	return 0;
+}
+
+int json_gen_retained_set(json_gen_retained_t *doc, size_t index, const json_gen_value_t *value)
 {
-    return json_gen_add_to_str(jstr, val);
+	if (index >= doc->num_slots || !json_gen_retained_check(&doc->slots[index], value)) {
+		return -1;
+	}
+	json_gen_retained_slot_t *slot = &doc->slots[index];
+	if (json_gen_retained_same(&slot->value, value)) {
+		return 0;
+	}
+	if (json_gen_retained_format(doc, value) != 0) {
+		return -1;
+	}
+	size_t len = doc->scratch_len;
+	if (len == slot->len && memcmp(doc->text + slot->offset, doc->scratch, len) == 0) {
+		slot->value = *value;
+		return 0;
+	}
+	/* A value of a different length moves the rest of the text, and the later slots */
+	if (len != slot->len) {
+		size_t text_len = doc->text_len - slot->len + len;
+		if (json_gen_grow_buf(&doc->text, &doc->text_cap, text_len) != 0) {
+			return -1;
+		}
+		size_t tail = slot->offset + slot->len;
+		memmove(doc->text + slot->offset + len, doc->text + tail, doc->text_len - tail);
+		for (size_t i = index + 1; i < doc->num_slots; i++) {
+			doc->slots[i].offset = doc->slots[i].offset - slot->len + len;
+		}
+		doc->text_len = text_len;
+		slot->len = len;
+	}
+	memcpy(doc->text + slot->offset, doc->scratch, len);
+	slot->value = *value;
+	return 1;
 }
 
-int json_gen_end_long_string(json_gen_str_t *jstr)
+int json_gen_retained_update(json_gen_retained_t *doc, const json_gen_value_t *values)
 {
-    return json_gen_add_to_str(jstr, "\"");
+	for (size_t i = 0; i < doc->num_slots; i++) {
+		if (!json_gen_retained_check(&doc->slots[i], &values[i])) {
+			return -1;
+		}
+	}
+	int changed = 0;
+	for (size_t i = 0; i < doc->num_slots; i++) {
+		int ret = json_gen_retained_set(doc, i, &values[i]);
+		if (ret < 0) {
+			return -1;
+		}
+		changed += ret;
+	}
+	return changed;
 }
-static int json_gen_set_null(json_gen_str_t *jstr)
+
+void json_gen_retained_free(json_gen_retained_t *doc)
 {
-	jstr->comma_req = true;
-	return json_gen_add_to_str(jstr, "null");
+	free(doc->text);
+	free(doc->slots);
+	free(doc->scratch);
+	memset(doc, 0, sizeof(json_gen_retained_t));
 }
-int json_gen_obj_set_null(json_gen_str_t *jstr, const char *name)
+
+int json_gen_render_retained(const json_gen_retained_t *doc, json_gen_str_t *jstr)
 {
-	json_gen_handle_comma(jstr);
-	json_gen_handle_name(jstr, name);
-	return json_gen_set_null(jstr);
+	if (!doc->text) {
+		return -1;
+	}
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	json_gen_handle_elem(jstr);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_add_to_str_n(jstr, doc->text, doc->text_len));
 }
 
-int json_gen_arr_set_null(json_gen_str_t *jstr)
+int json_gen_obj_render_retained(const json_gen_retained_t *doc, json_gen_str_t *jstr,
+		const char *name)
 {
-	json_gen_handle_comma(jstr);
-	return json_gen_set_null(jstr);
+	if (!doc->text) {
+		return -1;
+	}
+	if (jstr->format) {
+		return json_gen_bin_unsupported(jstr);
+	}
+	JSON_GEN_TRACK_KEY(jstr, name, strlen(name), true);
+	json_gen_handle_member(jstr);
+	json_gen_handle_name(jstr, name);
+	jstr->comma_req = true;
+	return json_gen_result(jstr, json_gen_add_to_str_n(jstr, doc->text, doc->text_len));
 }
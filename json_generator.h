@@ -25,6 +25,7 @@
 #ifndef _JSON_GENERATOR_H
 #define _JSON_GENERATOR_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -33,11 +34,120 @@ extern "C"
 {
 #endif
 
-/** Float precision i.e. number of digits after decimal point */
+/** Default float precision i.e. number of digits after decimal point.
+ * This can be changed at runtime using json_gen_str_set_float_format()
+ */
 #ifndef JSON_FLOAT_PRECISION
 #define JSON_FLOAT_PRECISION 5
 #endif
 
+/** Maximum float precision supported by json_gen_str_set_float_format() */
+#define JSON_GEN_MAX_FLOAT_PRECISION 17
+
+/** Error returned once the output reaches the limit set by json_gen_str_set_max_len() */
+#define JSON_GEN_ERR_LIMIT (-2)
+
+/** Error returned once an API call would have made the JSON string invalid. Eg.
+ * json_gen_end_array() for an object, or a named value in an array.
+ *
+ * These checks can be compiled out by defining JSON_GEN_TRUSTED, for code which is
+ * known to generate valid JSON.
+ */
+#define JSON_GEN_ERR_INVALID (-3)
+
+/** Returned when the non blocking output of a JSON string started with
+ * json_gen_str_start_async() cannot take more data, and by every API call after that
+ * till the pending data is written out. This is not an error. The data has been
+ * accepted and generation can carry on, but it is better to wait till the output
+ * is writable and call json_gen_str_resume(). See json_gen_str_start_async().
+ */
+#define JSON_GEN_AGAIN (-4)
+
+/** Maximum nesting depth of objects and arrays, can be overridden at build time */
+#ifndef JSON_GEN_MAX_DEPTH
+#define JSON_GEN_MAX_DEPTH 64
+#endif
+
+/** Output formats */
+typedef enum {
+    /** JSON text. This is the default */
+    JSON_GEN_FORMAT_JSON = 0,
+    /** CBOR (RFC 8949). Objects, arrays and long strings are of indefinite length */
+    JSON_GEN_FORMAT_CBOR,
+    /** MessagePack. Objects, arrays and long strings have fixed width headers,
+     * which are updated in place once their length is known
+     */
+    JSON_GEN_FORMAT_MSGPACK,
+} json_gen_format_t;
+
+/** Handling of duplicate keys in objects, set by json_gen_str_set_dup_keys() */
+typedef enum {
+    /** Keys are not tracked. This is the default */
+    JSON_GEN_DUP_KEYS_ALLOW = 0,
+    /** A duplicate key sets the JSON_GEN_ERR_INVALID error */
+    JSON_GEN_DUP_KEYS_REJECT,
+    /** A member with a duplicate key is left out. Objects, arrays, long strings and
+     * custom values are still rejected, since their contents are added later.
+     */
+    JSON_GEN_DUP_KEYS_SKIP,
+} json_gen_dup_keys_t;
+
+/** (For Internal use only) Keys of the open objects */
+typedef struct json_gen_key_tracker json_gen_key_tracker_t;
+
+/** (For Internal use only) An open MessagePack object, array or long string */
+typedef struct {
+    /** Offset of the header from the start of the output */
+    uint64_t pos;
+    /** Number of elements, or bytes for a long string */
+    uint32_t count;
+} json_gen_bin_level_t;
+
+/** Instrumentation counters of a JSON string, read by json_gen_get_stats()
+ *
+ * These are maintained only if the JSON generator is built with
+ * JSON_GEN_ENABLE_STATS defined, so that the default build has no overhead.
+ */
+typedef struct {
+    /** Bytes emitted so far, including those still in the buffer */
+    uint64_t bytes;
+    /** Number of times the buffer was flushed out, through the flush callback
+     * or the sink, excluding the final flush by json_gen_str_end()
+     */
+    uint64_t flushes;
+    /** Time spent inside the flush callbacks or the sink, in nanoseconds */
+    uint64_t flush_ns;
+    /** Time spent otherwise since the JSON string was started, in nanoseconds */
+    uint64_t encode_ns;
+    /** Maximum nesting depth of objects and arrays */
+    uint32_t max_depth;
+    /** Size of the biggest single value, Eg. a string including its quotes and
+     * escapes. Names and objects/arrays as a whole are not counted.
+     */
+    uint64_t max_value_len;
+    /** Bytes copied into the buffer, from the strings passed in, from literals like
+     * true/false, or from temporary buffers for data which did not fit in the space left
+     */
+    uint64_t bytes_copied;
+    /** Remaining bytes, formatted directly in the buffer, Eg. numbers, escapes, or the
+     * data written using json_gen_reserve()
+     */
+    uint64_t bytes_in_place;
+} json_gen_stats_t;
+
+/** Formats for floating point numbers */
+typedef enum {
+    /** Floats are printed with a fixed precision (JSON_FLOAT_PRECISION by default)
+     * and doubles with the shortest representation that reads back to the same value.
+     * This is the default.
+     */
+    JSON_GEN_FLOAT_FMT_AUTO = 0,
+    /** Fixed number of digits after the decimal point, Eg. 45.12000 */
+    JSON_GEN_FLOAT_FMT_FIXED,
+    /** Shortest representation that reads back to the same value, Eg. 45.12 */
+    JSON_GEN_FLOAT_FMT_SHORTEST,
+} json_gen_float_fmt_t;
+
 /** JSON string flush callback prototype
  *
  * This is a prototype of the function that needs to be passed to
@@ -50,6 +160,71 @@ extern "C"
  */
 typedef void (*json_gen_flush_cb_t) (char *buf, void *priv);
 
+/** JSON string flush callback prototype, with explicit length
+ *
+ * This is a prototype of the function that needs to be passed to
+ * json_gen_str_start_v2(). It is the same as \ref json_gen_flush_cb_t, except
+ * that the length of the data is passed along and the data is not NULL
+ * terminated, so the complete buffer is available for the JSON string.
+ *
+ * \param[in] buf Pointer to the JSON data
+ * \param[in] len Length of the JSON data
+ * \param[in] priv Private data to be passed to the flush callback. Will
+ * be the same as the one passed to json_gen_str_start_v2()
+ *
+ * \return 0 on Success
+ * \return -1 on failure, which will be reported by the API which triggered the flush
+ */
+typedef int (*json_gen_flush_cb_v2_t) (const char *buf, size_t len, void *priv);
+
+/** Non blocking write callback prototype
+ *
+ * This is a prototype of the function that needs to be passed to
+ * json_gen_str_start_async(). It should write out as much of the data as it can
+ * without blocking, Eg. using write() or send() on a non blocking socket.
+ *
+ * \param[in] buf Pointer to the JSON data
+ * \param[in] len Length of the JSON data
+ * \param[in] priv Private data passed to json_gen_str_start_async()
+ *
+ * \return Number of bytes written, which can be anything from 0 to len. Less than len
+ * means that the output would block.
+ * \return -1 on failure, which will be reported by the API which triggered the write
+ */
+typedef int64_t (*json_gen_write_cb_t) (const char *buf, size_t len, void *priv);
+
+/** JSON output sink
+ *
+ * A sink takes over the buffer management from the JSON generator. This can be
+ * used for outputs which need to provide a new buffer after every flush, like
+ * double buffering or writing to files. A sink implementation should have this
+ * structure as its first member and be passed to json_gen_str_start_sink().
+ */
+typedef struct json_gen_sink json_gen_sink_t;
+
+typedef struct json_gen_prepared json_gen_prepared_t;
+struct json_gen_sink {
+    /** Consume the data generated so far and provide the buffer to be filled next.
+     * This is invoked with no data to get the initial buffer, and whenever the buffer
+     * gets full. need is the space the caller would like to have in the new buffer
+     * (0 if any size will do). A smaller buffer should still be provided if that is
+     * all that is possible. Should return 0 on success, or -1 on failure, after which
+     * the JSON string cannot be written out any further.
+     */
+    int (*flush)(json_gen_sink_t *sink, const char *data, size_t len, size_t need,
+            char **buf, size_t *buf_size);
+    /** (Optional) Consume the last chunk of data on json_gen_str_end() and release
+     * all resources. If not set, flush() is used for the last chunk.
+     */
+    int (*end)(json_gen_sink_t *sink, const char *data, size_t len);
+    /** (Optional) Consume data which is not in a buffer of the sink, Eg. a large blob
+     * added by json_gen_arr_push_raw(). The buffer has been flushed out before this, and
+     * the data is valid only during the call. If not set, such data is copied into the
+     * buffers. Should return 0 on success, or -1 on failure.
+     */
+    int (*write)(json_gen_sink_t *sink, const char *data, size_t len);
+};
+
 /** JSON String structure
  *
  * Please do not set/modify any elements.
@@ -59,7 +234,7 @@ typedef struct {
     /** Pointer to the JSON buffer provided by the calling function */
 	char *buf;
     /** Size of the above buffer */
-	int buf_size;
+	size_t buf_size;
     /** (Optional) callback function to invoke when the buffer gets full */
 	json_gen_flush_cb_t flush_cb;
     /** (Optional) Private data to pass to the callback function */
@@ -69,7 +244,69 @@ typedef struct {
     /** (For Internal use only) */
 	char *free_ptr;
     /** Total length */
-    int total_len;
+    uint64_t total_len;
+    /** (For Internal use only) */
+    json_gen_float_fmt_t float_fmt;
+    /** (For Internal use only) */
+    uint8_t float_precision;
+    /** (For Internal use only) */
+    bool escape;
+    /** (For Internal use only) */
+    char *end_ptr;
+    /** (Optional) callback function with explicit length, set by json_gen_str_start_v2() */
+    json_gen_flush_cb_v2_t flush_cb_v2;
+    /** (Optional) Sink, set by json_gen_str_start_sink() */
+    json_gen_sink_t *sink;
+    /** (For Internal use only) */
+    int err;
+    /** (For Internal use only) */
+    char *buf_end;
+    /** (For Internal use only) */
+    uint64_t max_len;
+    /** (For Internal use only) Set by json_gen_prepare_start() */
+    json_gen_prepared_t *prepared;
+    /** (For Internal use only) One bit per nesting level, set for arrays */
+    uint64_t nest_stack[(JSON_GEN_MAX_DEPTH + 63) / 64];
+    /** (For Internal use only) */
+    uint32_t depth;
+    /** (For Internal use only) */
+    uint8_t state;
+    /** (For Internal use only) End of the last complete record in the buffer */
+    char *record_end;
+    /** (For Internal use only) */
+    bool record_aligned;
+    /** (For Internal use only) Set by json_gen_str_set_format() */
+    json_gen_format_t format;
+    /** (For Internal use only) */
+    json_gen_bin_level_t *bin_levels;
+    /** (For Internal use only) */
+    uint32_t bin_depth;
+    /** (For Internal use only) Counters, if built with JSON_GEN_ENABLE_STATS */
+    json_gen_stats_t stats;
+    /** (For Internal use only) */
+    uint64_t stats_start_ns;
+    /** (For Internal use only) Start of the open long string */
+    uint64_t stats_long_str_pos;
+    /** (For Internal use only) */
+    uint32_t stats_depth;
+    /** (For Internal use only) Set by json_gen_str_set_indent() */
+    uint8_t indent;
+    /** (For Internal use only) The innermost object or array has no elements yet */
+    bool indent_empty;
+    /** (For Internal use only) */
+    uint32_t indent_depth;
+    /** (Optional) Non blocking write callback, set by json_gen_str_start_async() */
+    json_gen_write_cb_t write_cb;
+    /** (For Internal use only) Data that could not be written out yet */
+    char *spill;
+    /** (For Internal use only) */
+    size_t spill_len;
+    /** (For Internal use only) */
+    size_t spill_cap;
+    /** (For Internal use only) Length at the start of the spill already written out */
+    size_t spill_sent;
+    /** (For Internal use only) Set by json_gen_str_set_dup_keys() */
+    json_gen_key_tracker_t *keys;
 } json_gen_str_t;
 
 /** Start a JSON String
@@ -90,9 +327,257 @@ typedef struct {
  * \param[in] priv Private data to be passed to the flushing function callback.
  * Can be something like a session identifier (Eg. socket). Can be left NULL.
  */
-void json_gen_str_start(json_gen_str_t *jstr, char *buf, int buf_size,
+void json_gen_str_start(json_gen_str_t *jstr, char *buf, size_t buf_size,
 		json_gen_flush_cb_t flush_cb, void *priv);
 
+/** Start a JSON String, with a flush callback taking explicit length
+ *
+ * This is the same as json_gen_str_start(), except that the flush callback
+ * receives the length of the data and the data is not NULL terminated. So, the
+ * flush callback need not scan the data with strlen() and the complete buffer is
+ * used for the JSON string.
+ *
+ * \param[out] jstr Pointer to an allocated \ref json_gen_str_t structure.
+ * \param[out] buf Pointer to an allocated buffer into which the JSON
+ * string will be written
+ * \param[in] buf_size Size of the buffer
+ * \param[in] flush_cb Pointer to the flushing function of type \ref json_gen_flush_cb_v2_t
+ * which will be invoked either when the buffer is full or when json_gen_str_end()
+ * is invoked. Can be left NULL.
+ * \param[in] priv Private data to be passed to the flushing function callback.
+ */
+void json_gen_str_start_v2(json_gen_str_t *jstr, char *buf, size_t buf_size,
+		json_gen_flush_cb_v2_t flush_cb, void *priv);
+
+/** Start a JSON String with a sink
+ *
+ * This is the same as json_gen_str_start(), except that the buffers are managed
+ * by the given sink. See \ref json_gen_sink_t.
+ *
+ * \param[out] jstr Pointer to an allocated \ref json_gen_str_t structure.
+ * \param[in] sink Pointer to the sink. Should stay valid till json_gen_str_end().
+ *
+ * \return 0 on Success
+ * \return -1 if the sink could not provide the initial buffer
+ */
+int json_gen_str_start_sink(json_gen_str_t *jstr, json_gen_sink_t *sink);
+
+/** Start a JSON String with a non blocking output
+ *
+ * This is the same as json_gen_str_start_v2(), except that the write callback may
+ * write out only a part of the data, like write() on a non blocking socket. Whatever
+ * it does not take is moved to a spill buffer, allocated internally, and the
+ * generation carries on with the whole buffer. So, even a long key or string, or
+ * a long string added in parts, can be cut anywhere and resumes from the same byte.
+ *
+ * Any API call made while data is waiting to be written out returns JSON_GEN_AGAIN,
+ * starting with the one during which the output stopped taking data, even if that
+ * happened within a name or separator. The caller should then wait till the output
+ * is writable, Eg. with poll(), and call json_gen_str_resume() till it returns 0,
+ * before adding more data. The spill buffer keeps growing if it does not.
+ * json_gen_str_backlog() gives the number of bytes waiting to be written out.
+ *
+ * json_gen_str_end() too returns JSON_GEN_AGAIN if the data could not be written out
+ * completely. It should then be called again once the output is writable, till it
+ * returns the length of the JSON string, or an error.
+ *
+ * The complete buffer is used for the JSON string, without the NULL termination.
+ * Record aligned flushes are not done and the MessagePack format is not supported.
+ *
+ * \param[out] jstr Pointer to an allocated \ref json_gen_str_t structure.
+ * \param[out] buf Pointer to an allocated buffer into which the JSON
+ * string will be written
+ * \param[in] buf_size Size of the buffer
+ * \param[in] write_cb Callback function of type \ref json_gen_write_cb_t to write out
+ * the data
+ * \param[in] priv Private data to be passed to the callback
+ */
+void json_gen_str_start_async(json_gen_str_t *jstr, char *buf, size_t buf_size,
+        json_gen_write_cb_t write_cb, void *priv);
+
+/** Write out the data held back for a non blocking output
+ *
+ * This should be called once the output of a JSON string started with
+ * json_gen_str_start_async() is writable again.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start_async()
+ *
+ * \return 0 if all the data has been written out. This is also returned for other
+ * JSON strings, which are always written out synchronously.
+ * \return JSON_GEN_AGAIN if the output cannot take more data yet
+ * \return -1 if the write callback reported a failure at any point
+ */
+int json_gen_str_resume(json_gen_str_t *jstr);
+
+/** Get the number of bytes waiting to be written out to a non blocking output
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start_async()
+ *
+ * \return Length of the data held back, 0 if everything has been written out
+ */
+size_t json_gen_str_backlog(const json_gen_str_t *jstr);
+
+/** Memory allocator
+ *
+ * This can be passed to json_gen_str_start_growable() to allocate the buffer
+ * from a custom allocator or arena.
+ */
+typedef struct {
+    /** Same as the standard realloc(), with ptr NULL for a new allocation */
+    void *(*realloc)(void *ptr, size_t size, void *ctx);
+    /** Same as the standard free() */
+    void (*free)(void *ptr, void *ctx);
+    /** Context to be passed to the above functions */
+    void *ctx;
+} json_gen_allocator_t;
+
+/** Growable buffer state
+ *
+ * Please do not set/modify any elements.
+ * Just define this structure and pass a pointer to it to json_gen_str_start_growable()
+ */
+typedef struct {
+    /** (For Internal use only) */
+    json_gen_sink_t sink;
+    /** The buffer. Owned by the caller after json_gen_str_end() */
+    char *buf;
+    /** (For Internal use only) */
+    size_t size;
+    /** Length of the JSON string in the buffer, valid after json_gen_str_end() */
+    size_t len;
+    /** (For Internal use only) */
+    json_gen_allocator_t alloc;
+} json_gen_growable_t;
+
+/** Start a JSON String in a growable buffer
+ *
+ * The JSON string is generated in a buffer allocated internally, which grows
+ * geometrically as required. So, the complete JSON string can be generated in a
+ * single pass, without knowing its length beforehand. The JSON string can be
+ * retrieved using json_gen_str_end_growable().
+ *
+ * \param[out] jstr Pointer to an allocated \ref json_gen_str_t structure.
+ * \param[out] gbuf Pointer to an allocated \ref json_gen_growable_t structure.
+ * Should stay valid till json_gen_str_end_growable().
+ * \param[in] initial_size Initial size of the buffer. Can be 0 for a default size.
+ * \param[in] alloc Allocator to be used. Can be NULL to use the standard realloc()
+ * and free(). The structure is copied internally.
+ *
+ * \return 0 on Success
+ * \return -1 if the initial buffer could not be allocated
+ */
+int json_gen_str_start_growable(json_gen_str_t *jstr, json_gen_growable_t *gbuf,
+		size_t initial_size, const json_gen_allocator_t *alloc);
+
+/** End a JSON String in a growable buffer
+ *
+ * This is the same as json_gen_str_end(), but returns the generated JSON string.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start_growable()
+ * \param[out] len Length of the JSON string, excluding the NULL termination. Can be NULL.
+ *
+ * \return Pointer to the NULL terminated JSON string on Success. This must be freed by
+ * the caller using the free function of the allocator (or the standard free() if no
+ * allocator was passed to json_gen_str_start_growable())
+ * \return NULL if memory allocation failed at any point or the size limit was reached
+ */
+char *json_gen_str_end_growable(json_gen_str_t *jstr, size_t *len);
+
+/** Wait callback prototype for double buffering
+ *
+ * This is invoked when the JSON generator needs a buffer which is still being
+ * written out. It should return after making progress on the pending writes, so
+ * that json_gen_double_buf_release() gets called. Eg. by running the event loop
+ * or waiting on a condition variable signalled on write completion. It will be
+ * invoked repeatedly till the buffer is released.
+ *
+ * \param[in] priv Private data passed to json_gen_str_start_double_buf()
+ *
+ * \return 0 to continue waiting
+ * \return -1 to abort, which will be reported as a failure
+ */
+typedef int (*json_gen_wait_cb_t) (void *priv);
+
+/** Double buffering state
+ *
+ * Please do not set/modify any elements.
+ * Just define this structure and pass a pointer to it to json_gen_str_start_double_buf()
+ */
+typedef struct {
+    /** (For Internal use only) */
+    json_gen_sink_t sink;
+    /** (For Internal use only) */
+    char *bufs[2];
+    /** (For Internal use only) */
+    size_t buf_size;
+    /** (For Internal use only) */
+    int cur;
+    /** (For Internal use only) */
+    volatile int busy[2];
+    /** (For Internal use only) */
+    json_gen_flush_cb_v2_t flush_cb;
+    /** (For Internal use only) */
+    json_gen_wait_cb_t wait_cb;
+    /** (For Internal use only) */
+    void *priv;
+} json_gen_double_buf_t;
+
+/** Start a JSON String with double buffering
+ *
+ * With double buffering, the JSON generator continues filling one buffer while
+ * the other one is being written out asynchronously. The flush callback should
+ * just start the write (Eg. an async send()) and return. Once the write completes,
+ * json_gen_double_buf_release() must be called to hand the buffer back. The
+ * data passed to the flush callback stays valid till then.
+ *
+ * json_gen_str_end() returns only after both the buffers are handed back.
+ *
+ * \param[out] jstr Pointer to an allocated \ref json_gen_str_t structure.
+ * \param[out] dbuf Pointer to an allocated \ref json_gen_double_buf_t structure.
+ * Should stay valid till json_gen_str_end().
+ * \param[in] buf_a Pointer to the first buffer
+ * \param[in] buf_b Pointer to the second buffer
+ * \param[in] buf_size Size of each of the buffers
+ * \param[in] flush_cb Pointer to the flushing function of type \ref json_gen_flush_cb_v2_t
+ * \param[in] wait_cb Pointer to the wait function of type \ref json_gen_wait_cb_t
+ * \param[in] priv Private data to be passed to the callbacks
+ *
+ * \return 0 on Success
+ * \return -1 on invalid arguments
+ */
+int json_gen_str_start_double_buf(json_gen_str_t *jstr, json_gen_double_buf_t *dbuf,
+		char *buf_a, char *buf_b, size_t buf_size,
+		json_gen_flush_cb_v2_t flush_cb, json_gen_wait_cb_t wait_cb, void *priv);
+
+/** Hand back a buffer after writing it out
+ *
+ * This should be called once the asynchronous write of a buffer passed to the flush
+ * callback is complete. It can be called from any thread, including from within
+ * the flush callback itself.
+ *
+ * \param[in] dbuf Pointer to the \ref json_gen_double_buf_t structure
+ * \param[in] buf Pointer to the buffer, as received by the flush callback
+ */
+void json_gen_double_buf_release(json_gen_double_buf_t *dbuf, const char *buf);
+
+/** Fail a JSON string
+ *
+ * This sets an error, as if the output had failed, so that no more data is accepted
+ * and json_gen_str_end() returns it. It is meant for code building on the generator
+ * which cannot complete what it has started adding, Eg. json_gen_arr_set_parallel()
+ * after splicing only some of its chunks. An error set earlier is kept.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] err Error to be set, Eg. -1
+ *
+ * \return The error of the JSON string
+ */
+int json_gen_str_fail(json_gen_str_t *jstr, int err);
+
 /** End JSON string
  *
  * This should be the last function to be called after the entire JSON string
@@ -102,12 +587,245 @@ void json_gen_str_start(json_gen_str_t *jstr, char *buf, int buf_size,
  * json_gen_str_start()
  *
  * \return Total length of the JSON created, including the NULL termination byte.
+ * \return JSON_GEN_AGAIN if the non blocking output of a JSON string started with
+ * json_gen_str_start_async() could not take all the data. This should be called
+ * again once the output is writable.
+ * \return -1 if the flush callback of type \ref json_gen_flush_cb_v2_t, the sink or
+ * the write callback reported a failure at any point.
+ * \return JSON_GEN_ERR_LIMIT if the limit set by json_gen_str_set_max_len() was reached.
+ * \return JSON_GEN_ERR_INVALID if an API call was invalid for the structure of the
+ * JSON string, or if a long string, objects or arrays were left open. Open ones are
+ * closed before the final flush, so that the output still parses.
  */
-int json_gen_str_end(json_gen_str_t *jstr);
+int64_t json_gen_str_end(json_gen_str_t *jstr);
 
-/** Start a JSON object
+/** Get the instrumentation counters of a JSON string
  *
- * This starts a JSON object by adding a '{'
+ * This can be called at any point before json_gen_str_end(), which clears them.
+ * The counters are maintained only if the JSON generator is built with
+ * JSON_GEN_ENABLE_STATS defined.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[out] stats Pointer to an allocated \ref json_gen_stats_t structure
+ *
+ * \return 0 on Success
+ * \return -1 if built without JSON_GEN_ENABLE_STATS
+ */
+int json_gen_get_stats(const json_gen_str_t *jstr, json_gen_stats_t *stats);
+
+/** Limit the total length of the JSON string
+ *
+ * Once the JSON string would grow beyond this length, the data which does not fit
+ * is dropped, nothing more is written and all the APIs return JSON_GEN_ERR_LIMIT.
+ * Exactly max_len bytes get flushed out, which is a truncated JSON string that the
+ * caller should discard. This can be used to bound the output
+ * of untrusted or runaway data, Eg. for multi-GB streams.
+ *
+ * The length excludes the NULL termination byte. There is no limit by default.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] max_len Maximum length in bytes. 0 to remove the limit.
+ */
+void json_gen_str_set_max_len(json_gen_str_t *jstr, uint64_t max_len);
+
+/** Set the format for floating point numbers
+ *
+ * This changes the way the float and double values added after this call are
+ * printed. By default, \ref JSON_GEN_FLOAT_FMT_AUTO is used with a precision of
+ * JSON_FLOAT_PRECISION.
+ *
+ * \note Numbers too large to be printed with the fixed format are printed in the
+ * shortest format. NaN and Infinity cannot be represented in JSON and are
+ * added as null.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] fmt Format to be used, of type \ref json_gen_float_fmt_t
+ * \param[in] precision Number of digits after the decimal point for the fixed format.
+ * Should be between 0 and JSON_GEN_MAX_FLOAT_PRECISION.
+ */
+void json_gen_str_set_float_format(json_gen_str_t *jstr, json_gen_float_fmt_t fmt, int precision);
+
+/** Enable or disable escaping of strings
+ *
+ * When enabled, quotes, backslashes and control characters in names and string
+ * values (including long strings) are escaped as per RFC 8259, so that any string
+ * can be added safely. Escaping is disabled by default, in which case the strings
+ * are copied as is and must already be valid JSON string contents.
+ *
+ * This can be changed at any time, so that trusted or pre-escaped strings can
+ * take the raw path while others are escaped.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] enable true to enable escaping, false to disable
+ */
+void json_gen_str_set_escape(json_gen_str_t *jstr, bool enable);
+
+/** Select the output format
+ *
+ * The same APIs can generate binary CBOR or MessagePack instead of JSON text. Numbers
+ * are written in fixed width binary, floats as 32 bit and doubles as 64 bit, and
+ * strings are length prefixed and never escaped. Records (See json_gen_record_end())
+ * are just concatenated, without newlines. The float format is ignored.
+ *
+ * The APIs which take JSON text, ie. json_gen_push_object_str(), json_gen_push_array_str(),
+ * json_gen_encode_struct(), json_gen_obj_set_struct() and the prepared documents are not
+ * supported for binary formats and set the JSON_GEN_ERR_INVALID error.
+ * json_gen_reserve()/json_gen_commit() write the data as is.
+ *
+ * MessagePack needs the headers of open objects, arrays and long strings to still be in
+ * the buffer when they end. So, the data from the oldest open header onwards is held
+ * back while flushing. If that does not fit in the buffer, json_gen_str_end() returns -1.
+ * Growable buffers have no such limit.
+ *
+ * \note This must be called right after starting the JSON string, before adding any
+ * data. Binary data should be flushed out using a callback with explicit length,
+ * a sink or a growable buffer. It cannot be combined with json_gen_str_set_indent().
+ * MessagePack is not supported for json_gen_str_start_async().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] format Output format, of type \ref json_gen_format_t
+ *
+ * \return 0 on Success
+ * \return -1 if data has already been added, pretty printing has been selected, or
+ * memory allocation failed
+ */
+int json_gen_str_set_format(json_gen_str_t *jstr, json_gen_format_t format);
+
+/** Track the keys of objects and reject or skip duplicates
+ *
+ * The keys of each open object are kept in a small open addressing hash table, and
+ * dropped when the object ends. The keys are copied, so the buffers holding them can
+ * be reused as soon as each call returns. Keys are compared
+ * as passed, before escaping. For pre-rendered keys (See \ref json_gen_key_t), the
+ * name within the quotes is used.
+ *
+ * Only the keys added with the APIs are tracked, not those within pre-rendered JSON,
+ * Eg. json_gen_push_object_str(), or documents added as a whole, Eg. json_gen_render().
+ *
+ * \note This must be called right after starting the JSON string, before adding any
+ * data. The tracking works in trusted builds (JSON_GEN_TRUSTED) too.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] mode Handling of duplicate keys, of type \ref json_gen_dup_keys_t
+ *
+ * \return 0 on Success
+ * \return -1 if data has already been added, or memory allocation failed
+ */
+int json_gen_str_set_dup_keys(json_gen_str_t *jstr, json_gen_dup_keys_t mode);
+
+/** Maximum indentation supported by json_gen_str_set_indent() */
+#define JSON_GEN_MAX_INDENT 16
+
+/** Select pretty printing
+ *
+ * Every element of an object or array is put on a line of its own, indented by the
+ * given number of spaces per nesting level, and names are followed by a space, Eg.
+ * {
+ *   "a": [
+ *     1,
+ *     2
+ *   ],
+ *   "b": {}
+ * }
+ * Structs and the JSON text passed to json_gen_push_object_str() and the like are
+ * still added as is. The compact output takes a path of its own, so it is not slowed
+ * down by this.
+ * Defining JSON_GEN_NO_PRETTY at build time compiles pretty printing out altogether.
+ *
+ * \note This must be called right after starting the JSON string, before adding any
+ * data. Binary formats cannot be pretty printed.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] indent Number of spaces per level, up to JSON_GEN_MAX_INDENT.
+ * 0 for the default compact output.
+ *
+ * \return 0 on Success
+ * \return -1 if data has already been added, the indent is too large, a binary format
+ * has been selected or built with JSON_GEN_NO_PRETTY
+ */
+int json_gen_str_set_indent(json_gen_str_t *jstr, uint8_t indent);
+
+/** Enable or disable record aligned flushes
+ *
+ * When enabled, the buffer is flushed out only up to the end of the last complete
+ * record (See json_gen_record_end()), so that each chunk has whole lines. The incomplete
+ * record is moved to the start of the next buffer. Records longer than the buffer
+ * still get split. This has no effect for growable buffers.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] enable true to enable, false to disable
+ */
+void json_gen_str_set_record_aligned(json_gen_str_t *jstr, bool enable);
+
+/** Reserve space in the JSON buffer
+ *
+ * This returns a pointer into the JSON buffer with at least n contiguous bytes
+ * available, so that data can be written in place without any intermediate copy.
+ * If the space left in the buffer is not enough, the buffer is flushed out first.
+ * The data written must then be accounted for by calling json_gen_commit().
+ *
+ * \note The data is added as is. Use json_gen_obj_start_value() or
+ * json_gen_arr_start_value() first to add a value with the required separators.
+ *
+ * \note Since the buffer may be flushed before it is full, the chunks passed to the
+ * flush callback may be smaller than the buffer size when this API is used.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] n Number of bytes required. Should be less than the buffer size.
+ *
+ * \return Pointer to the reserved space on Success
+ * \return NULL if the JSON string has no buffer (i.e. only the length is being
+ * calculated), n is too large for the buffer, or the buffer is full and no callback
+ * function is passed to json_gen_str_start()
+ */
+char *json_gen_reserve(json_gen_str_t *jstr, size_t n);
+
+/** Commit data written in place
+ *
+ * This accounts for the data written at the pointer returned by json_gen_reserve().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] written Number of bytes actually written. Should not be more than the
+ * number of bytes reserved.
+ *
+ * \return 0 on Success
+ * \return -1 if more bytes are committed than available in the buffer
+ */
+int json_gen_commit(json_gen_str_t *jstr, size_t written);
+
+/** Begin a record of a newline delimited JSON (NDJSON/JSON Lines) stream
+ *
+ * Any number of records can be added to a single JSON string, sharing the same
+ * buffer, so that the data is flushed out only when the buffer is full. Each record
+ * is a complete JSON value, Eg. an object started with json_gen_start_object(),
+ * followed by json_gen_record_end().
+ *
+ * \note This must be called at the top level, outside any object or array
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ *
+ * \return 0 on Success
+ * \return Error of the JSON string, if any
+ */
+int json_gen_record_begin(json_gen_str_t *jstr);
+
+/** End a record of a newline delimited JSON stream
+ *
+ * This adds the newline after the record.
+ *
+ * \note This must be called at the top level, after all the objects and arrays of
+ * the record have been ended
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
@@ -117,11 +835,11 @@ int json_gen_str_end(json_gen_str_t *jstr);
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_start_object(json_gen_str_t *jstr);
+int json_gen_record_end(json_gen_str_t *jstr);
 
-/** End a JSON object
+/** Start a JSON object
  *
- * This ends a JSON object by adding a '}'
+ * This starts a JSON object by adding a '{'
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
@@ -131,7 +849,21 @@ int json_gen_start_object(json_gen_str_t *jstr);
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_end_object(json_gen_str_t *jstr);
+int json_gen_start_object(json_gen_str_t *jstr);
+
+/** End a JSON object
+ *
+ * This ends a JSON object by adding a '}'
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_end_object(json_gen_str_t *jstr);
 
 /** Start a JSON array
  *
@@ -145,401 +877,1934 @@ int json_gen_end_object(json_gen_str_t *jstr);
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_start_array(json_gen_str_t *jstr);
+int json_gen_start_array(json_gen_str_t *jstr);
+
+/** End a JSON object
+ *
+ * This ends a JSON object by adding a ']'
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_end_array(json_gen_str_t *jstr);
+
+/** Push a named JSON object
+ *
+ * This adds a JSON object like "name":{
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the object
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_push_object(json_gen_str_t *jstr, const char *name);
+
+/** Push a named JSON object, with explicit name length
+ *
+ * Same as json_gen_push_object() but the name is passed along with its length, so
+ * it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_push_object_n(json_gen_str_t *jstr, const char *name, size_t name_len);
+
+/** Pop a named JSON object
+ *
+ * This ends a JSON object by adding a '}'. This is basically same as
+ * json_gen_end_object() but included so as to complement json_gen_push_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_pop_object(json_gen_str_t *jstr);
+
+/** Push a JSON object string
+ *
+ * This adds a complete pre-formatted JSON object string to the JSON object.
+ *
+ * Eg. json_gen_push_object_str(jstr, "pre-formatted", "{\"a\":1,\"b\":2}");
+ * This will add "pre-formatted":{"a":1,"b":2}
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the JSON object string
+ * \param[in] object_str The pre-formatted JSON object string
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that.
+ */
+int json_gen_push_object_str(json_gen_str_t *jstr, const char *name, const char *object_str);
+
+/** Push a JSON object string, with explicit lengths
+ *
+ * Same as json_gen_push_object_str() but the name and the pre-formatted JSON
+ * object string are passed along with their lengths, so they need not be NULL
+ * terminated and are not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the JSON object string
+ * \param[in] name_len Length of the name
+ * \param[in] object_str The pre-formatted JSON object string
+ * \param[in] object_len Length of the pre-formatted JSON object string
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_push_object_str_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+		const char *object_str, size_t object_len);
+
+/** Push a named JSON array
+ *
+ * This adds a JSON array like "name":[
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the array
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_push_array(json_gen_str_t *jstr, const char *name);
+
+/** Push a named JSON array, with explicit name length
+ *
+ * Same as json_gen_push_array() but the name is passed along with its length, so
+ * it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_push_array_n(json_gen_str_t *jstr, const char *name, size_t name_len);
+
+/** Pop a named JSON array
+ *
+ * This ends a JSON array by adding a ']'. This is basically same as
+ * json_gen_end_array() but included so as to complement json_gen_push_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_pop_array(json_gen_str_t *jstr);
+
+/** Push a JSON array string
+ *
+ * This adds a complete pre-formatted JSON array string to the JSON object.
+ *
+ * Eg. json_gen_push_object_str(jstr, "pre-formatted", "[1,2,3]");
+ * This will add "pre-formatted":[1,2,3]
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the JSON array string
+ * \param[in] array_str The pre-formatted JSON array string
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that.
+ */
+int json_gen_push_array_str(json_gen_str_t *jstr, const char *name, const char *array_str);
+
+/** Push a JSON array string, with explicit lengths
+ *
+ * Same as json_gen_push_array_str() but the name and the pre-formatted JSON
+ * array string are passed along with their lengths, so they need not be NULL
+ * terminated and are not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the JSON array string
+ * \param[in] name_len Length of the name
+ * \param[in] array_str The pre-formatted JSON array string
+ * \param[in] array_len Length of the pre-formatted JSON array string
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_push_array_str_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+		const char *array_str, size_t array_len);
+
+/** Add a pre-formatted value to an array
+ *
+ * This adds complete, pre-formatted data as an element of the array, with the
+ * separators as required. Eg. a cached JSON object, or a chunk of JSON received from
+ * the network. It need not be NULL terminated. For binary formats, it should be a
+ * single complete value in the same format.
+ *
+ * Data at least as large as the buffer is not copied into it, if the output can take
+ * it directly. The buffer is flushed out and the data is passed on to the flush callback
+ * of type \ref json_gen_flush_cb_v2_t, the write callback of json_gen_str_start_async()
+ * or the write() of the sink. This is not done with record aligned flushes, or while
+ * a MessagePack object or array is open.
+ *
+ * json_gen_push_object_str_n() and json_gen_push_array_str_n() do the same in objects.
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] raw The pre-formatted value
+ * \param[in] len Length of the value
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_push_raw(json_gen_str_t *jstr, const char *raw, size_t len);
+
+/** Start a custom value in an object
+ *
+ * This adds the separators and the name for a value which will then be written
+ * by the caller, using json_gen_reserve()/json_gen_commit(). Eg. "name":
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_start_value(json_gen_str_t *jstr, const char *name);
+
+/** Start a custom value in an object, with explicit name length
+ *
+ * Same as json_gen_obj_start_value() but the name is passed along with its length, so
+ * it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_start_value_n(json_gen_str_t *jstr, const char *name, size_t name_len);
+
+/** Add only the name of an element in an object
+ *
+ * This adds the separators and the name, Eg. "name": and the next value added with
+ * the array APIs (Eg. json_gen_arr_set_int() or json_gen_start_object()) becomes
+ * its value. This is useful for wrappers with a single, type based, write path.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_name_n(json_gen_str_t *jstr, const char *name, size_t name_len);
+
+/** Start a custom value in an array
+ *
+ * This adds the separator for a value which will then be written by the caller,
+ * using json_gen_reserve()/json_gen_commit().
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_start_value(json_gen_str_t *jstr);
+
+/** Add a boolean element to an object
+ *
+ * This adds a boolean element to an object. Eg. "bool_val":true
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] val Boolean value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_bool(json_gen_str_t *jstr, const char *name, bool val);
+
+/** Add a boolean element to an object, with explicit name length
+ *
+ * Same as json_gen_obj_set_bool() but the name is passed along with its length, so
+ * it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ * \param[in] val Boolean value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_bool_n(json_gen_str_t *jstr, const char *name, size_t name_len, bool val);
+
+/** Add an integer element to an object
+ *
+ * This adds an integer element to an object. Eg. "int_val":28
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] val Integer value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_int(json_gen_str_t *jstr, const char *name, int val);
+
+/** Add an integer element to an object, with explicit name length
+ *
+ * Same as json_gen_obj_set_int() but the name is passed along with its length, so
+ * it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ * \param[in] val Integer value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_int_n(json_gen_str_t *jstr, const char *name, size_t name_len, int val);
+
+/** Add an int64 (long long integer) element to an object
+ *
+ * This adds an integer element to an object. Eg. "int64_val":28
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] val int64 (long long integer) value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_int64(json_gen_str_t *jstr, const char *name, int64_t val);
+
+/** Add an int64 (long long integer) element to an object, with explicit name length
+ *
+ * Same as json_gen_obj_set_int64() but the name is passed along with its length, so
+ * it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ * \param[in] val int64 (long long integer) value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_int64_n(json_gen_str_t *jstr, const char *name, size_t name_len, int64_t val);
+
+/** Add a uint32_t (unsigned integer) element to an object
+ *
+ * This adds an unsigned integer element to an object. Eg. "uint32_val":28
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] val uint32_t value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_uint32(json_gen_str_t *jstr, const char *name, uint32_t val);
+
+/** Add a uint32_t (unsigned integer) element to an object, with explicit name length
+ *
+ * Same as json_gen_obj_set_uint32() but the name is passed along with its length, so
+ * it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ * \param[in] val uint32_t value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_uint32_n(json_gen_str_t *jstr, const char *name, size_t name_len, uint32_t val);
+
+/** Add a uint64_t (unsigned integer) element to an object
+ *
+ * This adds an unsigned integer element to an object. Eg. "uint64_val":28
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] val uint64_t value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_uint64(json_gen_str_t *jstr, const char *name, uint64_t val);
+
+/** Add a uint64_t (unsigned integer) element to an object, with explicit name length
+ *
+ * Same as json_gen_obj_set_uint64() but the name is passed along with its length, so
+ * it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ * \param[in] val uint64_t value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_uint64_n(json_gen_str_t *jstr, const char *name, size_t name_len, uint64_t val);
+
+/** Add a float element to an object
+ *
+ * This adds a float element to an object. Eg. "float_val":23.8
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] val Float value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_float(json_gen_str_t *jstr, const char *name, float val);
+
+/** Add a float element to an object, with explicit name length
+ *
+ * Same as json_gen_obj_set_float() but the name is passed along with its length, so
+ * it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ * \param[in] val Float value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_float_n(json_gen_str_t *jstr, const char *name, size_t name_len, float val);
+
+/** Add a double element to an object
+ *
+ * This adds a double precision floating point element to an object. Eg. "double_val":23.8
+ * By default, the shortest representation that reads back to the same value is used.
+ * See json_gen_str_set_float_format().
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] val Double value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_double(json_gen_str_t *jstr, const char *name, double val);
+
+/** Add a double element to an object, with explicit name length
+ *
+ * Same as json_gen_obj_set_double() but the name is passed along with its length, so
+ * it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ * \param[in] val Double value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_double_n(json_gen_str_t *jstr, const char *name, size_t name_len, double val);
+
+/** Add a string element to an object
+ *
+ * This adds a string element to an object. Eg. "string_val":"my_string"
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] val Null terminated string value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_string(json_gen_str_t *jstr, const char *name, const char *val);
+
+/** Add a string element to an object, with explicit lengths
+ *
+ * Same as json_gen_obj_set_string() but the name and value are passed along
+ * with their lengths, so they need not be NULL terminated and are not scanned
+ * with strlen(). Useful for string views or protobuf fields.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ * \param[in] val String value of the element
+ * \param[in] val_len Length of the string value
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_string_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+		const char *val, size_t val_len);
+
+/** Add a NULL element to an object
+ *
+ * This adds a NULL element to an object. Eg. "null_val":null
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_null(json_gen_str_t *jstr, const char *name);
+
+/** Add a NULL element to an object, with explicit name length
+ *
+ * Same as json_gen_obj_set_null() but the name is passed along with its length, so
+ * it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_null_n(json_gen_str_t *jstr, const char *name, size_t name_len);
+
+/** Add a boolean element to an array
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] val Boolean value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_bool(json_gen_str_t *jstr, bool val);
+
+/** Add an integer element to an array
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] val Integer value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_int(json_gen_str_t *jstr, int val);
+
+/** Add a int64 (long long integer) element to an array
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] val int64 (long long integer) value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_int64(json_gen_str_t *jstr, int64_t val);
+
+/** Add a uint32_t (unsigned integer) element to an array
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] val uint32_t value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_uint32(json_gen_str_t *jstr, uint32_t val);
+
+/** Add a uint64_t (unsigned integer) element to an array
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] val uint64_t value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_uint64(json_gen_str_t *jstr, uint64_t val);
+
+/** Add a float element to an array
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] val Float value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_float(json_gen_str_t *jstr, float val);
+
+/** Add a double element to an array
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] val Double value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_double(json_gen_str_t *jstr, double val);
+
+/** Add a string element to an array
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] val Null terminated string value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_string(json_gen_str_t *jstr, const char *val);
+
+/** Add a string element to an array, with explicit length
+ *
+ * Same as json_gen_arr_set_string() but the value is passed along with its
+ * length, so it need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] val String value of the element
+ * \param[in] val_len Length of the string value
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_string_n(json_gen_str_t *jstr, const char *val, size_t val_len);
+
+/** Add binary data to an object, as a base64 string
+ *
+ * The data is encoded straight into the buffer, in as many chunks as required across
+ * the flushes, using the standard base64 alphabet with padding (RFC 4648). SIMD is used
+ * if built for it, ie. with SSSE3 or NEON. For binary formats, the data is added as a
+ * byte string, without any encoding.
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] data The binary data
+ * \param[in] len Length of the data
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_base64(json_gen_str_t *jstr, const char *name, const void *data, size_t len);
+
+/** Add binary data to an object, as a base64 string, with an explicit name length
+ *
+ * Same as json_gen_obj_set_base64() but the name is passed along with its length, so it
+ * need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ * \param[in] data The binary data
+ * \param[in] len Length of the data
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_base64_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+        const void *data, size_t len);
+
+/** Add binary data to an array, as a base64 string
+ *
+ * Same as json_gen_obj_set_base64(), but for an element of an array.
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] data The binary data
+ * \param[in] len Length of the data
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_base64(json_gen_str_t *jstr, const void *data, size_t len);
+
+/** Add binary data to an object, as a hex string
+ *
+ * Same as json_gen_obj_set_base64(), but the data is encoded as lowercase hex, two
+ * characters per byte. SIMD is used if built for it, ie. with SSE2 or NEON.
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] data The binary data
+ * \param[in] len Length of the data
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_hex(json_gen_str_t *jstr, const char *name, const void *data, size_t len);
+
+/** Add binary data to an object, as a hex string, with an explicit name length
+ *
+ * Same as json_gen_obj_set_hex() but the name is passed along with its length, so it
+ * need not be NULL terminated and is not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ * \param[in] data The binary data
+ * \param[in] len Length of the data
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_hex_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+        const void *data, size_t len);
+
+/** Add binary data to an array, as a hex string
+ *
+ * Same as json_gen_obj_set_hex(), but for an element of an array.
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] data The binary data
+ * \param[in] len Length of the data
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_hex(json_gen_str_t *jstr, const void *data, size_t len);
+
+/** Add a NULL element to an array
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_null(json_gen_str_t *jstr);
+
+/** Add an array of integers to an array
+ *
+ * This adds all the values to an array in one go, which is much faster than calling
+ * json_gen_arr_set_int() for each of them. The values are formatted straight into
+ * the buffer, as many at a time as fit. Eg. 1,2,3
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] vals Pointer to the values
+ * \param[in] count Number of values
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_int_array(json_gen_str_t *jstr, const int32_t *vals, size_t count);
+
+/** Add an array of int64 values to an array
+ *
+ * Same as json_gen_arr_set_int_array(), but for int64 values
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] vals Pointer to the values
+ * \param[in] count Number of values
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_int64_array(json_gen_str_t *jstr, const int64_t *vals, size_t count);
+
+/** Add an array of doubles to an array
+ *
+ * Same as json_gen_arr_set_int_array(), but for doubles. The values are printed
+ * as per json_gen_str_set_float_format().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] vals Pointer to the values
+ * \param[in] count Number of values
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_double_array(json_gen_str_t *jstr, const double *vals, size_t count);
+
+/** Add an array of booleans to an array
+ *
+ * Same as json_gen_arr_set_int_array(), but for booleans
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] vals Pointer to the values
+ * \param[in] count Number of values
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_bool_array(json_gen_str_t *jstr, const bool *vals, size_t count);
+
+/** Add an array of strings to an array
+ *
+ * Same as calling json_gen_arr_set_string() for each of the strings. NULL entries
+ * are added as null.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] vals Pointer to the NULL terminated strings
+ * \param[in] count Number of strings
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_set_string_array(json_gen_str_t *jstr, const char **vals, size_t count);
+
+/** Start a Long string in an object
+ *
+ * This starts a string in an object, but does not end it (i.e., does not add the
+ * terminating quotes. This is useful for long strings. Eg. "string_val":"my_string.
+ * The API json_gen_add_to_long_string() must be used to add to this string and the API
+ * json_gen_end_long_string() must be used to terminate it (i.e. add the ending quotes).
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] val Null terminated initial part of the string value. It can also be NULL
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_start_long_string(json_gen_str_t *jstr, const char *name, const char *val);
+
+/** Start a Long string in an object, with explicit lengths
+ *
+ * Same as json_gen_obj_start_long_string() but the name and the initial part
+ * of the value are passed along with their lengths, so they need not be NULL
+ * terminated and are not scanned with strlen().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
+ * \param[in] name_len Length of the name
+ * \param[in] val Initial part of the string value. It can be NULL if val_len is 0
+ * \param[in] val_len Length of the initial part of the string value
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_start_long_string_n(json_gen_str_t *jstr, const char *name, size_t name_len,
+		const char *val, size_t val_len);
+
+/** Start a Long string in an array
+ *
+ * This starts a string in an arrayt, but does not end it (i.e., does not add the
+ * terminating quotes. This is useful for long strings.
+ * The API json_gen_add_to_long_string() must be used to add to this string and the API
+ * json_gen_end_long_string() must be used to terminate it (i.e. add the ending quotes).
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] val Null terminated initial part of the string value. It can also be NULL
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_start_long_string(json_gen_str_t *jstr, const char *val);
+
+/** Start a Long string in an array, with explicit length
+ *
+ * Same as json_gen_arr_start_long_string() but the initial part of the string is
+ * passed along with its length, so it need not be NULL terminated.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] val Initial part of the string value. It can be NULL if val_len is 0.
+ * \param[in] val_len Length of the initial part
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_arr_start_long_string_n(json_gen_str_t *jstr, const char *val, size_t val_len);
+
+/** Add to a JSON Long string
+ *
+ * This extends the string initialised by json_gen_obj_start_long_string() or
+ * json_gen_arr_start_long_string(). After the entire string is created, it should be terminated
+ * with json_gen_end_long_string().
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by json_gen_str_start()
+ * \param[in] val Null terminated extending part of the string value.
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_add_to_long_string(json_gen_str_t *jstr, const char *val);
+
+/** Add to a JSON Long string, with explicit length
+ *
+ * Same as json_gen_add_to_long_string() but the part is passed along with its length,
+ * so it need not be NULL terminated. Eg. a chunk straight from a network buffer.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by json_gen_str_start()
+ * \param[in] val Extending part of the string value
+ * \param[in] val_len Length of the part
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_add_to_long_string_n(json_gen_str_t *jstr, const char *val, size_t val_len);
+
+/** End a JSON Long string
+ *
+ * This ends the string initialised by json_gen_obj_start_long_string() or
+ * json_gen_arr_start_long_string() by adding the ending quotes.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by json_gen_str_start()
+ *
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_end_long_string(json_gen_str_t *jstr);
+
+/** Pre-rendered key
+ *
+ * Keys known at compile time can be pre-rendered along with the quotes, colon and
+ * the preceding comma, using JSON_GEN_KEY(). The _k variants of the APIs then add the
+ * separators and the key with a single copy, without any strlen(). Eg.
+ *
+ *     static const json_gen_key_t temp_key = JSON_GEN_KEY("temperature");
+ *     json_gen_obj_set_float_k(&jstr, &temp_key, 25.5);
+ *
+ * \note The key is added as is, even if escaping is enabled with
+ * json_gen_str_set_escape(). So, it must not contain characters which need escaping.
+ */
+typedef struct {
+    /** The key rendered as ,"name": */
+    const char *str;
+    /** Length of the above */
+    size_t len;
+} json_gen_key_t;
+
+/** Initializer for a \ref json_gen_key_t. The name must be a string literal */
+#define JSON_GEN_KEY(name) { ",\"" name "\":", sizeof(name) + 3 }
+
+/** Start a custom value in an object, with a pre-rendered key
+ *
+ * Same as json_gen_obj_start_value() but with a pre-rendered key. See \ref json_gen_key_t.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] key Pre-rendered key of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_start_value_k(json_gen_str_t *jstr, const json_gen_key_t *key);
+
+/** Add only the name of an element in an object, with a pre-rendered key
+ *
+ * Same as json_gen_obj_set_name_n() but with a pre-rendered key. See \ref json_gen_key_t.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] key Pre-rendered key of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_name_k(json_gen_str_t *jstr, const json_gen_key_t *key);
+
+/** Push a nested JSON object, with a pre-rendered key
+ *
+ * Same as json_gen_push_object() but with a pre-rendered key. See \ref json_gen_key_t.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] key Pre-rendered key of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_push_object_k(json_gen_str_t *jstr, const json_gen_key_t *key);
+
+/** Push a nested JSON array, with a pre-rendered key
+ *
+ * Same as json_gen_push_array() but with a pre-rendered key. See \ref json_gen_key_t.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] key Pre-rendered key of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_push_array_k(json_gen_str_t *jstr, const json_gen_key_t *key);
+
+/** Add a boolean element to an object, with a pre-rendered key
+ *
+ * Same as json_gen_obj_set_bool() but with a pre-rendered key. See \ref json_gen_key_t.
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] key Pre-rendered key of the element
+ * \param[in] val Boolean value of the element
+ *
+ * \return 0 on Success
+ * \return -1 if buffer is out of space (possible only if no callback function
+ * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
+ * added after that
+ */
+int json_gen_obj_set_bool_k(json_gen_str_t *jstr, const json_gen_key_t *key, bool val);
 
-/** End a JSON object
+/** Add an integer element to an object, with a pre-rendered key
  *
- * This ends a JSON object by adding a ']'
+ * Same as json_gen_obj_set_int() but with a pre-rendered key. See \ref json_gen_key_t.
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
+ * \param[in] key Pre-rendered key of the element
+ * \param[in] val Integer value of the element
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_end_array(json_gen_str_t *jstr);
+int json_gen_obj_set_int_k(json_gen_str_t *jstr, const json_gen_key_t *key, int val);
 
-/** Push a named JSON object
+/** Add an int64 element to an object, with a pre-rendered key
  *
- * This adds a JSON object like "name":{
+ * Same as json_gen_obj_set_int64() but with a pre-rendered key. See \ref json_gen_key_t.
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
- * \param[in] name Name of the object
+ * \param[in] key Pre-rendered key of the element
+ * \param[in] val int64 value of the element
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_push_object(json_gen_str_t *jstr, const char *name);
+int json_gen_obj_set_int64_k(json_gen_str_t *jstr, const json_gen_key_t *key, int64_t val);
 
-/** Pop a named JSON object
+/** Add a uint32 element to an object, with a pre-rendered key
  *
- * This ends a JSON object by adding a '}'. This is basically same as
- * json_gen_end_object() but included so as to complement json_gen_push_object()
+ * Same as json_gen_obj_set_uint32() but with a pre-rendered key. See \ref json_gen_key_t.
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
+ * \param[in] key Pre-rendered key of the element
+ * \param[in] val uint32 value of the element
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_pop_object(json_gen_str_t *jstr);
+int json_gen_obj_set_uint32_k(json_gen_str_t *jstr, const json_gen_key_t *key, uint32_t val);
 
-/** Push a JSON object string
- *
- * This adds a complete pre-formatted JSON object string to the JSON object.
+/** Add a uint64 element to an object, with a pre-rendered key
  *
- * Eg. json_gen_push_object_str(jstr, "pre-formatted", "{\"a\":1,\"b\":2}");
- * This will add "pre-formatted":{"a":1,"b":2}
+ * Same as json_gen_obj_set_uint64() but with a pre-rendered key. See \ref json_gen_key_t.
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
- * \param[in] name Name of the JSON object string
- * \param[in] object_str The pre-formatted JSON object string
+ * \param[in] key Pre-rendered key of the element
+ * \param[in] val uint64 value of the element
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
- * added after that.
+ * added after that
  */
-int json_gen_push_object_str(json_gen_str_t *jstr, const char *name, const char *object_str);
+int json_gen_obj_set_uint64_k(json_gen_str_t *jstr, const json_gen_key_t *key, uint64_t val);
 
-/** Push a named JSON array
+/** Add a float element to an object, with a pre-rendered key
  *
- * This adds a JSON array like "name":[
+ * Same as json_gen_obj_set_float() but with a pre-rendered key. See \ref json_gen_key_t.
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
- * \param[in] name Name of the array
+ * \param[in] key Pre-rendered key of the element
+ * \param[in] val Float value of the element
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_push_array(json_gen_str_t *jstr, const char *name);
+int json_gen_obj_set_float_k(json_gen_str_t *jstr, const json_gen_key_t *key, float val);
 
-/** Pop a named JSON array
+/** Add a double element to an object, with a pre-rendered key
  *
- * This ends a JSON array by adding a ']'. This is basically same as
- * json_gen_end_array() but included so as to complement json_gen_push_array()
+ * Same as json_gen_obj_set_double() but with a pre-rendered key. See \ref json_gen_key_t.
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
+ * \param[in] key Pre-rendered key of the element
+ * \param[in] val Double value of the element
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_pop_array(json_gen_str_t *jstr);
+int json_gen_obj_set_double_k(json_gen_str_t *jstr, const json_gen_key_t *key, double val);
 
-/** Push a JSON array string
- *
- * This adds a complete pre-formatted JSON array string to the JSON object.
+/** Add a string element to an object, with a pre-rendered key
  *
- * Eg. json_gen_push_object_str(jstr, "pre-formatted", "[1,2,3]");
- * This will add "pre-formatted":[1,2,3]
+ * Same as json_gen_obj_set_string() but with a pre-rendered key. See \ref json_gen_key_t.
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
- * \param[in] name Name of the JSON array string
- * \param[in] array_str The pre-formatted JSON array string
+ * \param[in] key Pre-rendered key of the element
+ * \param[in] val Null terminated string value of the element
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
- * added after that.
+ * added after that
  */
-int json_gen_push_array_str(json_gen_str_t *jstr, const char *name, const char *array_str);
+int json_gen_obj_set_string_k(json_gen_str_t *jstr, const json_gen_key_t *key, const char *val);
 
-/** Add a boolean element to an object
- *
- * This adds a boolean element to an object. Eg. "bool_val":true
+/** Add a string element of explicit length to an object, with a pre-rendered key
  *
- * \note This must be called between json_gen_start_object()/json_gen_push_object()
- * and json_gen_end_object()/json_gen_pop_object()
+ * Same as json_gen_obj_set_string_n() but with a pre-rendered key. See \ref json_gen_key_t.
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
- * \param[in] name Name of the element
- * \param[in] val Boolean value of the element
+ * \param[in] key Pre-rendered key of the element
+ * \param[in] val String value of the element
+ * \param[in] val_len Length of the string value
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_obj_set_bool(json_gen_str_t *jstr, const char *name, bool val);
+int json_gen_obj_set_string_k_n(json_gen_str_t *jstr, const json_gen_key_t *key,
+		const char *val, size_t val_len);
 
-/** Add an integer element to an object
- *
- * This adds an integer element to an object. Eg. "int_val":28
+/** Add a NULL element to an object, with a pre-rendered key
  *
- * \note This must be called between json_gen_start_object()/json_gen_push_object()
- * and json_gen_end_object()/json_gen_pop_object()
+ * Same as json_gen_obj_set_null() but with a pre-rendered key. See \ref json_gen_key_t.
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
- * \param[in] name Name of the element
- * \param[in] val Integer value of the element
+ * \param[in] key Pre-rendered key of the element
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_obj_set_int(json_gen_str_t *jstr, const char *name, int val);
+int json_gen_obj_set_null_k(json_gen_str_t *jstr, const json_gen_key_t *key);
 
-/** Add an int64 (long long integer) element to an object
- *
- * This adds an integer element to an object. Eg. "int64_val":28
+/** Start a Long string in an object, with a pre-rendered key
  *
- * \note This must be called between json_gen_start_object()/json_gen_push_object()
- * and json_gen_end_object()/json_gen_pop_object()
+ * Same as json_gen_obj_start_long_string() but with a pre-rendered key. See \ref json_gen_key_t.
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
- * \param[in] name Name of the element
- * \param[in] val int64 (long long integer) value of the element
+ * \param[in] key Pre-rendered key of the element
+ * \param[in] val Null terminated initial part of the string value. It can also be NULL
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_obj_set_int64(json_gen_str_t *jstr, const char *name, int64_t val);
+int json_gen_obj_start_long_string_k(json_gen_str_t *jstr, const json_gen_key_t *key,
+		const char *val);
 
-/** Add a float element to an object
+/** Maximum number of different structs used in arrays within a struct, including itself */
+#ifndef JSON_GEN_MAX_STRUCT_DESCS
+#define JSON_GEN_MAX_STRUCT_DESCS 16
+#endif
+
+/** Types of fields in a struct */
+typedef enum {
+    /** bool */
+    JSON_GEN_FIELD_BOOL = 0,
+    /** int32_t */
+    JSON_GEN_FIELD_INT32,
+    /** int64_t */
+    JSON_GEN_FIELD_INT64,
+    /** uint32_t */
+    JSON_GEN_FIELD_UINT32,
+    /** uint64_t */
+    JSON_GEN_FIELD_UINT64,
+    /** float */
+    JSON_GEN_FIELD_FLOAT,
+    /** double */
+    JSON_GEN_FIELD_DOUBLE,
+    /** Pointer to a NULL terminated string (const char *). NULL is added as null */
+    JSON_GEN_FIELD_STRING,
+    /** Character array (char [N]), NULL terminated unless full */
+    JSON_GEN_FIELD_CHARS,
+    /** Embedded struct, described by the desc of the field */
+    JSON_GEN_FIELD_OBJECT,
+    /** Array of elements of the elem_type of the field. The number of elements is in
+     * a size_t member of the struct.
+     */
+    JSON_GEN_FIELD_ARRAY,
+} json_gen_field_type_t;
+
+typedef struct json_gen_struct_desc json_gen_struct_desc_t;
+
+/** Field descriptor
  *
- * This adds a float element to an object. Eg. "float_val":23.8
+ * Describes a member of a struct to be added to the JSON string. Normally created
+ * using the JSON_GEN_FIELD*() macros below.
+ */
+typedef struct {
+    /** Name of the element */
+    const char *name;
+    /** Type of the member */
+    json_gen_field_type_t type;
+    /** Offset of the member in the struct */
+    size_t offset;
+    /** Type of the elements, for \ref JSON_GEN_FIELD_ARRAY */
+    json_gen_field_type_t elem_type;
+    /** Offset of the size_t member with the number of elements, for \ref JSON_GEN_FIELD_ARRAY */
+    size_t count_offset;
+    /** Size of the member, for \ref JSON_GEN_FIELD_CHARS and arrays embedded in the
+     * struct. 0 if the member is a pointer to the elements.
+     */
+    size_t capacity;
+    /** Descriptor for \ref JSON_GEN_FIELD_OBJECT and arrays of objects */
+    const json_gen_struct_desc_t *desc;
+} json_gen_field_t;
+
+/** Scalar or string member, named same as the member */
+#define JSON_GEN_FIELD(type, st, member) \
+    { #member, type, offsetof(st, member), JSON_GEN_FIELD_BOOL, 0, 0, NULL }
+
+/** Character array member, named same as the member */
+#define JSON_GEN_FIELD_CHARS_OF(st, member) \
+    { #member, JSON_GEN_FIELD_CHARS, offsetof(st, member), JSON_GEN_FIELD_BOOL, 0, \
+        sizeof(((st *)0)->member), NULL }
+
+/** Embedded struct member, named same as the member */
+#define JSON_GEN_FIELD_OBJECT_OF(st, member, member_desc) \
+    { #member, JSON_GEN_FIELD_OBJECT, offsetof(st, member), JSON_GEN_FIELD_BOOL, 0, 0, \
+        member_desc }
+
+/** Member pointing to an array of count elements, named same as the member */
+#define JSON_GEN_FIELD_ARRAY_OF(st, member, count, elem_type, elem_desc) \
+    { #member, JSON_GEN_FIELD_ARRAY, offsetof(st, member), elem_type, offsetof(st, count), \
+        0, elem_desc }
+
+/** Array member embedded in the struct, with count elements in use, named same as the member */
+#define JSON_GEN_FIELD_INLINE_ARRAY_OF(st, member, count, elem_type, elem_desc) \
+    { #member, JSON_GEN_FIELD_ARRAY, offsetof(st, member), elem_type, offsetof(st, count), \
+        sizeof(((st *)0)->member), elem_desc }
+
+/** Struct descriptor
+ *
+ * Describes a struct to be added to the JSON string as an object, with one
+ * \ref json_gen_field_t per element. It must be compiled once using
+ * json_gen_struct_compile() before use. Compiling pre-renders the keys, merges
+ * all the constant parts of the JSON (Eg. ,"loc":{"lat": for an embedded struct)
+ * into single literals and resolves the type of each value. Encoding a struct
+ * is then just copying these literals and formatting the values.
+ *
+ * Eg.
+ *
+ *     typedef struct { int32_t id; double temp; const char *name; } sensor_t;
+ *     static const json_gen_field_t sensor_fields[] = {
+ *         JSON_GEN_FIELD(JSON_GEN_FIELD_INT32, sensor_t, id),
+ *         JSON_GEN_FIELD(JSON_GEN_FIELD_DOUBLE, sensor_t, temp),
+ *         JSON_GEN_FIELD(JSON_GEN_FIELD_STRING, sensor_t, name),
+ *     };
+ *     static json_gen_struct_desc_t sensor_desc = JSON_GEN_STRUCT_DESC(sensor_t, sensor_fields);
+ *
+ *     json_gen_struct_compile(&sensor_desc);
+ *     json_gen_encode_struct(&jstr, &sensor_desc, &sensor);
+ *
+ * \note The names are added as is, even if escaping is enabled with
+ * json_gen_str_set_escape(). String values are escaped as configured.
+ */
+struct json_gen_struct_desc {
+    /** Descriptors of the fields, in the order in which they should be added */
+    const json_gen_field_t *fields;
+    /** Number of fields */
+    size_t num_fields;
+    /** Size of the struct, for arrays of the struct */
+    size_t size;
+    /** (For Internal use only) */
+    struct json_gen_struct_op *ops;
+    /** (For Internal use only) */
+    char *lits;
+};
+
+/** Initializer for a \ref json_gen_struct_desc_t, with a static array of fields */
+#define JSON_GEN_STRUCT_DESC(st, fields) \
+    { fields, sizeof(fields) / sizeof((fields)[0]), sizeof(st), NULL, NULL }
+
+/** Compile a struct descriptor
  *
- * \note This must be called between json_gen_start_object()/json_gen_push_object()
- * and json_gen_end_object()/json_gen_pop_object()
+ * This should be called once before the descriptor is used for encoding. The
+ * descriptors of embedded structs and arrays of structs need not be compiled
+ * separately. The struct can refer to itself in arrays, Eg. for trees.
  *
- * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
- * json_gen_str_start()
- * \param[in] name Name of the element
- * \param[in] val Float value of the element
+ * \note This is not thread safe, but encoding with a compiled descriptor is.
+ *
+ * \param[in] desc Pointer to the descriptor
  *
  * \return 0 on Success
- * \return -1 if buffer is out of space (possible only if no callback function
- * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
- * added after that
+ * \return -1 if the descriptor is invalid or memory allocation failed
  */
-int json_gen_obj_set_float(json_gen_str_t *jstr, const char *name, float val);
+int json_gen_struct_compile(json_gen_struct_desc_t *desc);
 
-/** Add a string element to an object
+/** Free the memory allocated by json_gen_struct_compile()
  *
- * This adds a string element to an object. Eg. "string_val":"my_string"
+ * \param[in] desc Pointer to the descriptor
+ */
+void json_gen_struct_free(json_gen_struct_desc_t *desc);
+
+/** Add a struct as an object
  *
- * \note This must be called between json_gen_start_object()/json_gen_push_object()
- * and json_gen_end_object()/json_gen_pop_object()
+ * This adds all the fields of the struct as an object. It can be used for the top
+ * level object or for an element of an array. Eg. {"id":1,"temp":25.5}
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
- * \param[in] name Name of the element
- * \param[in] val Null terminated string value of the element
+ * \param[in] desc Pointer to the descriptor compiled by json_gen_struct_compile()
+ * \param[in] obj Pointer to the struct
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
- * added after that
+ * added after that. Also if the descriptor is not compiled.
  */
-int json_gen_obj_set_string(json_gen_str_t *jstr, const char *name, const char *val);
+int json_gen_encode_struct(json_gen_str_t *jstr, const json_gen_struct_desc_t *desc, const void *obj);
 
-/** Add a NULL element to an object
- *
- * This adds a NULL element to an object. Eg. "null_val":null
+/** Add a struct as an object element of an object
  *
- * \note This must be called between json_gen_start_object()/json_gen_push_object()
- * and json_gen_end_object()/json_gen_pop_object()
+ * Same as json_gen_encode_struct(), but adds the struct with the given name to an
+ * object. Eg. "sensor":{"id":1,"temp":25.5}
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
  * \param[in] name Name of the element
+ * \param[in] desc Pointer to the descriptor compiled by json_gen_struct_compile()
+ * \param[in] obj Pointer to the struct
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
- * added after that
+ * added after that. Also if the descriptor is not compiled.
  */
-int json_gen_obj_set_null(json_gen_str_t *jstr, const char *name);
+int json_gen_obj_set_struct(json_gen_str_t *jstr, const char *name,
+		const json_gen_struct_desc_t *desc, const void *obj);
 
-/** Add a boolean element to an array
+/** Types of values */
+typedef enum {
+    /** null */
+    JSON_GEN_VALUE_NULL = 0,
+    /** bool, in b */
+    JSON_GEN_VALUE_BOOL,
+    /** int64_t, in i64 */
+    JSON_GEN_VALUE_INT64,
+    /** uint64_t, in u64 */
+    JSON_GEN_VALUE_UINT64,
+    /** float, in d. Printed as per the format for floats */
+    JSON_GEN_VALUE_FLOAT,
+    /** double, in d */
+    JSON_GEN_VALUE_DOUBLE,
+    /** String of length str.len, in str. Escaped if escaping is enabled */
+    JSON_GEN_VALUE_STRING,
+    /** JSON text of length str.len, in str. Added as is, Eg. a pre-rendered object */
+    JSON_GEN_VALUE_RAW,
+} json_gen_value_type_t;
+
+/** A value of any type */
+typedef struct {
+    /** Type of the value */
+    json_gen_value_type_t type;
+    /** The value, as per the type */
+    union {
+        bool b;
+        int64_t i64;
+        uint64_t u64;
+        double d;
+        struct {
+            const char *ptr;
+            size_t len;
+        } str;
+    } u;
+} json_gen_value_t;
+
+/** A slot in a prepared document */
+typedef struct {
+    /** Offset of the slot in the text */
+    size_t offset;
+    /** Type of the value expected */
+    json_gen_value_type_t type;
+} json_gen_slot_t;
+
+/** Prepared document
  *
- * \note This must be called between json_gen_start_array()/json_gen_push_array()
- * and json_gen_end_array()/json_gen_pop_array()
+ * Messages which have the same structure and differ only in a few values can be
+ * prepared once, with slots for the values, and then rendered any number of times.
+ * Rendering just copies the constant parts of the JSON in between the slots and
+ * formats the values in the slots, without any of the per element overheads.
  *
- * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
- * json_gen_str_start()
- * \param[in] val Boolean value of the element
+ * The document is built using the regular APIs, between json_gen_prepare_start()
+ * and json_gen_prepare_end(), with json_gen_obj_set_slot()/json_gen_arr_set_slot()
+ * in place of the values that change. Eg.
+ *
+ *     json_gen_prepare_start(&jstr, &prep);
+ *     json_gen_start_object(&jstr);
+ *     json_gen_obj_set_string(&jstr, "type", "reading");
+ *     json_gen_obj_set_slot(&jstr, "temp", JSON_GEN_VALUE_DOUBLE);
+ *     json_gen_end_object(&jstr);
+ *     json_gen_prepare_end(&jstr);
+ *
+ *     json_gen_value_t val = {.type = JSON_GEN_VALUE_DOUBLE, .u.d = 25.5};
+ *     json_gen_render(&prep, &val, &out);
+ *
+ * Please do not set/modify any elements.
+ */
+struct json_gen_prepared {
+    /** The constant text, with the slots in between */
+    char *text;
+    /** Length of the text */
+    size_t text_len;
+    /** The slots, in order */
+    json_gen_slot_t *slots;
+    /** Number of slots */
+    size_t num_slots;
+    /** (For Internal use only) */
+    json_gen_growable_t gbuf;
+    /** (For Internal use only) */
+    bool failed;
+};
+
+/** Start building a prepared document
+ *
+ * This starts a JSON string in an internal buffer, which will become the prepared
+ * document on json_gen_prepare_end().
+ *
+ * \param[out] jstr Pointer to an allocated \ref json_gen_str_t structure.
+ * \param[out] prep Pointer to an allocated \ref json_gen_prepared_t structure.
  *
  * \return 0 on Success
- * \return -1 if buffer is out of space (possible only if no callback function
- * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
- * added after that
+ * \return -1 if memory allocation failed
  */
-int json_gen_arr_set_bool(json_gen_str_t *jstr, bool val);
+int json_gen_prepare_start(json_gen_str_t *jstr, json_gen_prepared_t *prep);
 
-/** Add an integer element to an array
+/** Finish building a prepared document
  *
- * \note This must be called between json_gen_start_array()/json_gen_push_array()
- * and json_gen_end_array()/json_gen_pop_array()
+ * This ends the JSON string started by json_gen_prepare_start(). The prepared
+ * document can then be rendered using json_gen_render().
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
- * json_gen_str_start()
- * \param[in] val Integer value of the element
+ * json_gen_prepare_start()
  *
  * \return 0 on Success
- * \return -1 if buffer is out of space (possible only if no callback function
- * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
- * added after that
+ * \return -1 if memory allocation failed at any point
  */
-int json_gen_arr_set_int(json_gen_str_t *jstr, int val);
+int json_gen_prepare_end(json_gen_str_t *jstr);
 
-/** Add a int64 (long long integer) element to an array
+/** Free the memory of a prepared document
  *
- * \note This must be called between json_gen_start_array()/json_gen_push_array()
- * and json_gen_end_array()/json_gen_pop_array()
+ * \param[in] prep Pointer to the \ref json_gen_prepared_t structure
+ */
+void json_gen_prepared_free(json_gen_prepared_t *prep);
+
+/** Add a slot to an object in a prepared document
+ *
+ * This adds the name for an element, with the value to be filled in by json_gen_render().
+ *
+ * \note This must be called between json_gen_start_object()/json_gen_push_object()
+ * and json_gen_end_object()/json_gen_pop_object()
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
- * json_gen_str_start()
- * \param[in] val int64 (long long integer) value of the element
+ * json_gen_prepare_start()
+ * \param[in] name Name of the element
+ * \param[in] type Type of the value. Either the value of this type or a
+ * \ref JSON_GEN_VALUE_NULL value can be rendered in the slot.
  *
- * \return 0 on Success
- * \return -1 if buffer is out of space (possible only if no callback function
- * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
- * added after that
+ * \return Index of the slot, in the values passed to json_gen_render()
+ * \return -1 if the JSON string was not started by json_gen_prepare_start() or
+ * memory allocation failed
  */
-int json_gen_arr_set_int64(json_gen_str_t *jstr, int64_t val);
+int json_gen_obj_set_slot(json_gen_str_t *jstr, const char *name, json_gen_value_type_t type);
 
-/** Add a float element to an array
+/** Add a slot to an array in a prepared document
+ *
+ * Same as json_gen_obj_set_slot(), but for an element of an array.
  *
  * \note This must be called between json_gen_start_array()/json_gen_push_array()
  * and json_gen_end_array()/json_gen_pop_array()
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
- * json_gen_str_start()
- * \param[in] val Float value of the element
+ * json_gen_prepare_start()
+ * \param[in] type Type of the value
  *
- * \return 0 on Success
- * \return -1 if buffer is out of space (possible only if no callback function
- * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
- * added after that
+ * \return Index of the slot, in the values passed to json_gen_render()
+ * \return -1 if the JSON string was not started by json_gen_prepare_start() or
+ * memory allocation failed
  */
-int json_gen_arr_set_float(json_gen_str_t *jstr, float val);
+int json_gen_arr_set_slot(json_gen_str_t *jstr, json_gen_value_type_t type);
 
-/** Add a string element to an array
+/** Render a prepared document
  *
- * \note This must be called between json_gen_start_array()/json_gen_push_array()
- * and json_gen_end_array()/json_gen_pop_array()
+ * This adds the prepared document with the given values in the slots. It can be
+ * used for the top level value or for an element of an array.
  *
+ * \param[in] prep Pointer to the document prepared by json_gen_prepare_end()
+ * \param[in] values Values for the slots, in order. One per slot.
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
- * \param[in] val Null terminated string value of the element
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
+ * \return -1 without adding anything if the type of any value does not match its slot
  */
-int json_gen_arr_set_string(json_gen_str_t *jstr, const char *val);
+int json_gen_render(const json_gen_prepared_t *prep, const json_gen_value_t *values,
+		json_gen_str_t *jstr);
 
-/** Add a NULL element to an array
+/** Render a prepared document as an element of an object
  *
- * \note This must be called between json_gen_start_array()/json_gen_push_array()
- * and json_gen_end_array()/json_gen_pop_array()
+ * Same as json_gen_render(), but adds the document with the given name to an object.
  *
+ * \param[in] prep Pointer to the document prepared by json_gen_prepare_end()
+ * \param[in] values Values for the slots, in order. One per slot.
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
+ * \param[in] name Name of the element
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
+ * \return -1 without adding anything if the type of any value does not match its slot
  */
-int json_gen_arr_set_null(json_gen_str_t *jstr);
+int json_gen_obj_render(const json_gen_prepared_t *prep, const json_gen_value_t *values,
+		json_gen_str_t *jstr, const char *name);
 
-/** Start a Long string in an object
+/** Add members to an object from parallel arrays of keys and values
  *
- * This starts a string in an object, but does not end it (i.e., does not add the
- * terminating quotes. This is useful for long strings. Eg. "string_val":"my_string.
- * The API json_gen_add_to_long_string() must be used to add to this string and the API
- * json_gen_end_long_string() must be used to terminate it (i.e. add the ending quotes).
+ * This is meant for serialising maps. The members are added in the order of the arrays,
+ * in one pass. For each member, the space needed at most is worked out from the lengths
+ * of the key and the value, and as long as that is available in the buffer, the member
+ * is written straight into it, without any further checks. Only the members which do
+ * not fit, or need escaping, go through the regular path, which flushes the buffer.
+ *
+ * Duplicate keys are handled as per json_gen_str_set_dup_keys().
  *
  * \note This must be called between json_gen_start_object()/json_gen_push_object()
  * and json_gen_end_object()/json_gen_pop_object()
  *
  * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
  * json_gen_str_start()
- * \param[in] name Name of the element
- * \param[in] val Null terminated initial part of the string value. It can also be NULL
+ * \param[in] keys Keys of the members
+ * \param[in] key_lens Lengths of the keys. Can be NULL for NULL terminated keys.
+ * \param[in] values Values of the members. JSON_GEN_VALUE_RAW values are added as is.
+ * \param[in] count Number of members
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
+ * \return -1 if the type of a value is not valid. The members before it have been added.
+ * \return JSON_GEN_ERR_INVALID if a key is a duplicate and those are rejected
  */
-int json_gen_obj_start_long_string(json_gen_str_t *jstr, const char *name, const char *val);
+int json_gen_obj_set_map(json_gen_str_t *jstr, const char **keys, const size_t *key_lens,
+        const json_gen_value_t *values, size_t count);
 
-/** Start a Long string in an array
+/** (For Internal use only) A slot in a retained document */
+typedef struct {
+    /** Offset of the value in the text */
+    size_t offset;
+    /** Length of the value */
+    size_t len;
+    /** Type of the value expected */
+    json_gen_value_type_t type;
+    /** The value last set */
+    json_gen_value_t value;
+} json_gen_retained_slot_t;
+
+/** Retained document
  *
- * This starts a string in an arrayt, but does not end it (i.e., does not add the
- * terminating quotes. This is useful for long strings.
- * The API json_gen_add_to_long_string() must be used to add to this string and the API
- * json_gen_end_long_string() must be used to terminate it (i.e. add the ending quotes).
+ * State which is republished periodically, with only a few values changing every
+ * time, can be kept rendered. A prepared document is rendered once into the retained
+ * text, which remembers where the value of each slot is. json_gen_retained_update()
+ * then formats only the values which changed and patches them in place. The rest of
+ * the text moves only if the length of a value changed. Eg.
  *
- * \note This must be called between json_gen_start_array()/json_gen_push_array()
- * and json_gen_end_array()/json_gen_pop_array()
+ *     json_gen_retained_start(&doc, &prep, values, NULL);
+ *     while (running) {
+ *         values[0].u.d = read_temp();
+ *         json_gen_retained_update(&doc, values);
+ *         send(fd, doc.text, doc.text_len, 0);
+ *     }
  *
- * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
- * json_gen_str_start()
- * \param[in] val Null terminated initial part of the string value. It can also be NULL
+ * Please do not set/modify any elements.
+ */
+typedef struct {
+    /** The current text, not NULL terminated */
+    char *text;
+    /** Length of the text */
+    size_t text_len;
+    /** (For Internal use only) */
+    size_t text_cap;
+    /** (For Internal use only) */
+    json_gen_retained_slot_t *slots;
+    /** Number of slots */
+    size_t num_slots;
+    /** (For Internal use only) The value being formatted */
+    char *scratch;
+    /** (For Internal use only) */
+    size_t scratch_len;
+    /** (For Internal use only) */
+    size_t scratch_cap;
+    /** (For Internal use only) */
+    json_gen_float_fmt_t float_fmt;
+    /** (For Internal use only) */
+    uint8_t float_precision;
+    /** (For Internal use only) */
+    bool escape;
+} json_gen_retained_t;
+
+/** Start a retained document
+ *
+ * This renders the prepared document with the given values into the retained text.
+ * The prepared document is not needed after this.
+ *
+ * \param[out] doc Pointer to an allocated \ref json_gen_retained_t structure.
+ * \param[in] prep Pointer to the document prepared by json_gen_prepare_end()
+ * \param[in] values Values for the slots, in order. One per slot.
+ * \param[in] fmt JSON string whose float format and escaping are to be used for the
+ * values, Eg. the one the document will be rendered into. Can be NULL for the defaults.
  *
  * \return 0 on Success
- * \return -1 if buffer is out of space (possible only if no callback function
- * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
- * added after that
+ * \return -1 if the type of any value does not match its slot, or memory allocation failed
  */
-int json_gen_arr_start_long_string(json_gen_str_t *jstr, const char *val);
+int json_gen_retained_start(json_gen_retained_t *doc, const json_gen_prepared_t *prep,
+        const json_gen_value_t *values, const json_gen_str_t *fmt);
 
-/** Add to a JSON Long string
+/** Set the value of a slot in a retained document
  *
- * This extends the string initialised by json_gen_obj_start_long_string() or
- * json_gen_arr_start_long_string(). After the entire string is created, it should be terminated
- * with json_gen_end_long_string().
+ * The value is patched into the text only if it changed. Values of the same type
+ * which are equal to the last ones are not even formatted, other than strings.
  *
- * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by json_gen_str_start()
- * \param[in] val Null terminated extending part of the string value.
+ * \param[in] doc Pointer to the \ref json_gen_retained_t structure initialised by
+ * json_gen_retained_start()
+ * \param[in] slot Index of the slot
+ * \param[in] value The value
+ *
+ * \return 1 if the text changed
+ * \return 0 if the value is the same as in the text
+ * \return -1 if the slot does not exist, the type of the value does not match it or
+ * memory allocation failed. The text is left as is.
+ */
+int json_gen_retained_set(json_gen_retained_t *doc, size_t slot, const json_gen_value_t *value);
+
+/** Update all the values of a retained document
+ *
+ * This is the same as json_gen_retained_set() for all the slots.
+ *
+ * \param[in] doc Pointer to the \ref json_gen_retained_t structure initialised by
+ * json_gen_retained_start()
+ * \param[in] values Values for the slots, in order. One per slot.
+ *
+ * \return Number of slots whose values changed in the text
+ * \return -1 without changing anything if the type of any value does not match its slot
+ * \return -1 if memory allocation failed. The values before the failing one are updated.
+ */
+int json_gen_retained_update(json_gen_retained_t *doc, const json_gen_value_t *values);
+
+/** Free the memory of a retained document
+ *
+ * \param[in] doc Pointer to the \ref json_gen_retained_t structure
+ */
+void json_gen_retained_free(json_gen_retained_t *doc);
+
+/** Render a retained document
+ *
+ * This adds the retained text as is. It can be used for the top level value or for
+ * an element of an array.
+ *
+ * \param[in] doc Pointer to the \ref json_gen_retained_t structure initialised by
+ * json_gen_retained_start()
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_add_to_long_string(json_gen_str_t *jstr, const char *val);
+int json_gen_render_retained(const json_gen_retained_t *doc, json_gen_str_t *jstr);
 
-/** End a JSON Long string
+/** Render a retained document as an element of an object
  *
- * This ends the string initialised by json_gen_obj_start_long_string() or
- * json_gen_arr_start_long_string() by adding the ending quotes.
- *
- * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by json_gen_str_start()
+ * Same as json_gen_render_retained(), but adds the document with the given name to an object.
  *
+ * \param[in] doc Pointer to the \ref json_gen_retained_t structure initialised by
+ * json_gen_retained_start()
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] name Name of the element
  *
  * \return 0 on Success
  * \return -1 if buffer is out of space (possible only if no callback function
  * is passed to json_gen_str_start(). Else, buffer will be flushed out and new data
  * added after that
  */
-int json_gen_end_long_string(json_gen_str_t *jstr);
+int json_gen_obj_render_retained(const json_gen_retained_t *doc, json_gen_str_t *jstr,
+        const char *name);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,565 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * JSON String Generator - C++ front end
+ *
+ * This is a header only wrapper over the C APIs, for C++17 and later. All the
+ * dispatching is resolved at compile time, into calls to the same C APIs that
+ * would otherwise be written by hand.
+ *
+ *     static constexpr auto temp_key = json_gen::make_key("temp");
+ *
+ *     json_gen::writer w(jstr);
+ *     {
+ *         auto obj = w.object();
+ *         w.set(temp_key, 25.5);
+ *         w.set("samples", std::vector<int32_t>{1, 2, 3});
+ *         w.set("unit", std::optional<std::string_view>{});
+ *     }
+ *
+ * Custom types can be added by specializing json_gen::serializer.
+ *
+ * With C++20 coroutines, encoders writing to a non blocking output can co_await
+ * json_gen::drain() and json_gen::end() for the backpressure.
+ *
+ */
+#ifndef _JSON_GENERATOR_HPP
+#define _JSON_GENERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define JSON_GEN_HAVE_COROUTINES 1
+#endif
+#include <json_generator.h>
+
+namespace json_gen {
+
+/** Key pre-rendered at compile time, as ,"name":
+ *
+ * This is the C++ equivalent of JSON_GEN_KEY(), which also works with constexpr
+ * character arrays. Create it using make_key().
+ */
+template <std::size_t N>
+struct static_key {
+    /** The rendered key */
+    char str[N + 3];
+
+    constexpr static_key(const char (&name)[N]) : str{}
+    {
+        str[0] = ',';
+        str[1] = '"';
+        for (std::size_t i = 0; i + 1 < N; i++) {
+            str[i + 2] = name[i];
+        }
+        str[N + 1] = '"';
+        str[N + 2] = ':';
+    }
+
+    /** The key in the form accepted by the _k C APIs */
+    json_gen_key_t c_key() const
+    {
+        return json_gen_key_t{str, N + 3};
+    }
+
+    /** The name, without the separators */
+    constexpr std::string_view name() const
+    {
+        return std::string_view(str + 2, N - 1);
+    }
+};
+
+/** Create a key pre-rendered at compile time. Eg. constexpr auto k = make_key("temp") */
+template <std::size_t N>
+constexpr static_key<N> make_key(const char (&name)[N])
+{
+    return static_key<N>(name);
+}
+
+class writer;
+
+/** Customization point for user types
+ *
+ * Specialize this with a static write() function to make a type serializable:
+ *
+ *     template <> struct json_gen::serializer<point> {
+ *         static int write(json_gen::writer &w, const point &p)
+ *         {
+ *             auto obj = w.object();
+ *             w.set(x_key, p.x);
+ *             return w.set(y_key, p.y);
+ *         }
+ *     };
+ *
+ * write() should add exactly one value, as an array element would be added.
+ */
+template <typename T, typename Enable = void>
+struct serializer {
+};
+
+namespace detail {
+
+template <typename T, typename = void>
+struct has_serializer : std::false_type {};
+
+template <typename T>
+struct has_serializer<T, std::void_t<decltype(serializer<T>::write(
+        std::declval<writer &>(), std::declval<const T &>()))>> : std::true_type {};
+
+template <typename T>
+struct is_optional : std::false_type {};
+
+template <typename T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+template <typename T, typename = void>
+struct is_range : std::false_type {};
+
+template <typename T>
+struct is_range<T, std::void_t<decltype(std::begin(std::declval<const T &>())),
+        decltype(std::end(std::declval<const T &>()))>> : std::true_type {};
+
+template <typename T, typename = void>
+struct is_contiguous : std::false_type {};
+
+template <typename T>
+struct is_contiguous<T, std::void_t<decltype(std::data(std::declval<const T &>())),
+        decltype(std::size(std::declval<const T &>()))>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_string_v = std::is_convertible_v<const T &, std::string_view>;
+
+/** NULL terminated C string, Eg. a string literal or a char pointer */
+template <typename T>
+constexpr bool is_c_string_v = std::is_same_v<std::remove_cv_t<std::remove_pointer_t<
+        std::decay_t<T>>>, char> && (std::is_pointer_v<T> || std::is_array_v<T>);
+
+/** Element type which can be added with one of the bulk array APIs */
+template <typename T>
+constexpr bool is_bulk_v = std::is_same_v<T, int32_t> || std::is_same_v<T, int64_t> ||
+        std::is_same_v<T, double> || std::is_same_v<T, bool>;
+
+template <typename T>
+struct always_false : std::false_type {};
+
+} /* namespace detail */
+
+/** RAII scope for an object or array
+ *
+ * The object or array is ended when the scope is destroyed. Returned by
+ * writer::object() and writer::array().
+ */
+class scope {
+public:
+    scope(json_gen_str_t *jstr, bool is_array) : jstr_(jstr), is_array_(is_array) {}
+    scope(const scope &) = delete;
+    scope &operator=(const scope &) = delete;
+    scope(scope &&other) noexcept : jstr_(other.jstr_), is_array_(other.is_array_)
+    {
+        other.jstr_ = nullptr;
+    }
+    ~scope()
+    {
+        close();
+    }
+
+    /** End the object or array before the scope is destroyed */
+    int close()
+    {
+        int ret = 0;
+        if (jstr_) {
+            ret = is_array_ ? json_gen_end_array(jstr_) : json_gen_end_object(jstr_);
+            jstr_ = nullptr;
+        }
+        return ret;
+    }
+
+private:
+    json_gen_str_t *jstr_;
+    bool is_array_;
+};
+
+/** Writer for a JSON string
+ *
+ * This wraps a \ref json_gen_str_t started with any of the json_gen_str_start*()
+ * APIs. It does not own it, so json_gen_str_end() should be called as usual.
+ *
+ * All the APIs return the same values as the C APIs they map to.
+ */
+class writer {
+public:
+    explicit writer(json_gen_str_t &jstr) : jstr_(&jstr) {}
+
+    /** The underlying JSON string, for using the C APIs directly */
+    json_gen_str_t *get() const
+    {
+        return jstr_;
+    }
+
+    /** Start an object, as the top level value or an array element */
+    [[nodiscard]] scope object()
+    {
+        json_gen_start_object(jstr_);
+        return scope(jstr_, false);
+    }
+
+    /** Start an object element of an object */
+    [[nodiscard]] scope object(std::string_view name)
+    {
+        json_gen_push_object_n(jstr_, name.data(), name.size());
+        return scope(jstr_, false);
+    }
+
+    /** Start an object element of an object, with a pre-rendered key */
+    template <std::size_t N>
+    [[nodiscard]] scope object(const static_key<N> &key)
+    {
+        json_gen_key_t k = key.c_key();
+        json_gen_push_object_k(jstr_, &k);
+        return scope(jstr_, false);
+    }
+
+    /** Start an array, as the top level value or an array element */
+    [[nodiscard]] scope array()
+    {
+        json_gen_start_array(jstr_);
+        return scope(jstr_, true);
+    }
+
+    /** Start an array element of an object */
+    [[nodiscard]] scope array(std::string_view name)
+    {
+        json_gen_push_array_n(jstr_, name.data(), name.size());
+        return scope(jstr_, true);
+    }
+
+    /** Start an array element of an object, with a pre-rendered key */
+    template <std::size_t N>
+    [[nodiscard]] scope array(const static_key<N> &key)
+    {
+        json_gen_key_t k = key.c_key();
+        json_gen_push_array_k(jstr_, &k);
+        return scope(jstr_, true);
+    }
+
+    /** Add a value to an array
+     *
+     * Supports bool, integers, floating point numbers, strings, nullptr,
+     * std::optional (null if empty), ranges (added as arrays) and the types with
+     * a \ref serializer specialization.
+     */
+    template <typename T>
+    int write(const T &val)
+    {
+        using U = std::remove_cv_t<T>;
+        if constexpr (detail::has_serializer<U>::value) {
+            return serializer<U>::write(*this, val);
+        } else if constexpr (std::is_same_v<U, bool>) {
+            return json_gen_arr_set_bool(jstr_, val);
+        } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+            if constexpr (sizeof(U) <= sizeof(int32_t)) {
+                return json_gen_arr_set_int(jstr_, val);
+            } else {
+                return json_gen_arr_set_int64(jstr_, val);
+            }
+        } else if constexpr (std::is_integral_v<U>) {
+            if constexpr (sizeof(U) <= sizeof(uint32_t)) {
+                return json_gen_arr_set_uint32(jstr_, val);
+            } else {
+                return json_gen_arr_set_uint64(jstr_, val);
+            }
+        } else if constexpr (std::is_same_v<U, float>) {
+            return json_gen_arr_set_float(jstr_, val);
+        } else if constexpr (std::is_floating_point_v<U>) {
+            return json_gen_arr_set_double(jstr_, (double)val);
+        } else if constexpr (std::is_same_v<U, std::nullptr_t>) {
+            return json_gen_arr_set_null(jstr_);
+        } else if constexpr (detail::is_c_string_v<U>) {
+            if constexpr (std::is_pointer_v<U>) {
+                if (!val) {
+                    return json_gen_arr_set_null(jstr_);
+                }
+            }
+            return json_gen_arr_set_string(jstr_, val);
+        } else if constexpr (detail::is_string_v<U>) {
+            std::string_view str(val);
+            return json_gen_arr_set_string_n(jstr_, str.data(), str.size());
+        } else if constexpr (detail::is_optional<U>::value) {
+            if (!val) {
+                return json_gen_arr_set_null(jstr_);
+            }
+            return write(*val);
+        } else if constexpr (detail::is_range<U>::value) {
+            scope arr = array();
+            return write_elements(val);
+        } else {
+            static_assert(detail::always_false<U>::value, "Type cannot be serialized. "
+                    "Specialize json_gen::serializer for it.");
+            return -1;
+        }
+    }
+
+    /** Add all the elements of a range to the current array
+     *
+     * Contiguous ranges of int32_t, int64_t, double and bool are added using
+     * the bulk array APIs.
+     */
+    template <typename R>
+    int write_elements(const R &range)
+    {
+        if constexpr (detail::is_contiguous<R>::value) {
+            using E = std::remove_cv_t<std::remove_pointer_t<decltype(std::data(range))>>;
+            if constexpr (detail::is_bulk_v<E>) {
+                return write_bulk(std::data(range), std::size(range));
+            }
+        }
+        int ret = 0;
+        for (const auto &elem : range) {
+            if (int r = write(elem)) {
+                ret = r;
+            }
+        }
+        return ret;
+    }
+
+    /** Add an element to an object
+     *
+     * Supports the same types as write(). The name is not scanned with strlen().
+     */
+    template <typename T>
+    int set(std::string_view name, const T &val)
+    {
+        using U = std::remove_cv_t<T>;
+        const char *n = name.data();
+        std::size_t len = name.size();
+        if constexpr (detail::has_serializer<U>::value) {
+            json_gen_obj_set_name_n(jstr_, n, len);
+            return write(val);
+        } else if constexpr (std::is_same_v<U, bool>) {
+            return json_gen_obj_set_bool_n(jstr_, n, len, val);
+        } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+            if constexpr (sizeof(U) <= sizeof(int32_t)) {
+                return json_gen_obj_set_int_n(jstr_, n, len, val);
+            } else {
+                return json_gen_obj_set_int64_n(jstr_, n, len, val);
+            }
+        } else if constexpr (std::is_integral_v<U>) {
+            if constexpr (sizeof(U) <= sizeof(uint32_t)) {
+                return json_gen_obj_set_uint32_n(jstr_, n, len, val);
+            } else {
+                return json_gen_obj_set_uint64_n(jstr_, n, len, val);
+            }
+        } else if constexpr (std::is_same_v<U, float>) {
+            return json_gen_obj_set_float_n(jstr_, n, len, val);
+        } else if constexpr (std::is_floating_point_v<U>) {
+            return json_gen_obj_set_double_n(jstr_, n, len, (double)val);
+        } else if constexpr (detail::is_string_v<U> && !detail::is_c_string_v<U>) {
+            std::string_view str(val);
+            return json_gen_obj_set_string_n(jstr_, n, len, str.data(), str.size());
+        } else {
+            json_gen_obj_set_name_n(jstr_, n, len);
+            return write(val);
+        }
+    }
+
+    /** Add an element to an object, with a pre-rendered key */
+    template <std::size_t N, typename T>
+    int set(const static_key<N> &key, const T &val)
+    {
+        using U = std::remove_cv_t<T>;
+        json_gen_key_t k = key.c_key();
+        if constexpr (detail::has_serializer<U>::value) {
+            json_gen_obj_set_name_k(jstr_, &k);
+            return write(val);
+        } else if constexpr (std::is_same_v<U, bool>) {
+            return json_gen_obj_set_bool_k(jstr_, &k, val);
+        } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+            if constexpr (sizeof(U) <= sizeof(int32_t)) {
+                return json_gen_obj_set_int_k(jstr_, &k, val);
+            } else {
+                return json_gen_obj_set_int64_k(jstr_, &k, val);
+            }
+        } else if constexpr (std::is_integral_v<U>) {
+            if constexpr (sizeof(U) <= sizeof(uint32_t)) {
+                return json_gen_obj_set_uint32_k(jstr_, &k, val);
+            } else {
+                return json_gen_obj_set_uint64_k(jstr_, &k, val);
+            }
+        } else if constexpr (std::is_same_v<U, float>) {
+            return json_gen_obj_set_float_k(jstr_, &k, val);
+        } else if constexpr (std::is_floating_point_v<U>) {
+            return json_gen_obj_set_double_k(jstr_, &k, (double)val);
+        } else if constexpr (detail::is_string_v<U> && !detail::is_c_string_v<U>) {
+            std::string_view str(val);
+            return json_gen_obj_set_string_k_n(jstr_, &k, str.data(), str.size());
+        } else {
+            json_gen_obj_set_name_k(jstr_, &k);
+            return write(val);
+        }
+    }
+
+private:
+    int write_bulk(const int32_t *vals, std::size_t count)
+    {
+        return json_gen_arr_set_int_array(jstr_, vals, count);
+    }
+
+    int write_bulk(const int64_t *vals, std::size_t count)
+    {
+        return json_gen_arr_set_int64_array(jstr_, vals, count);
+    }
+
+    int write_bulk(const double *vals, std::size_t count)
+    {
+        return json_gen_arr_set_double_array(jstr_, vals, count);
+    }
+
+    int write_bulk(const bool *vals, std::size_t count)
+    {
+        return json_gen_arr_set_bool_array(jstr_, vals, count);
+    }
+
+    json_gen_str_t *jstr_;
+};
+
+#ifdef JSON_GEN_HAVE_COROUTINES
+/** Awaitable for the backpressure of a non blocking output
+ *
+ * This is for a JSON string started with json_gen_str_start_async(), and is created
+ * by json_gen::drain() or json_gen::end(). co_await completes right away if the
+ * output takes all the data. Else, the coroutine is suspended and the wait function
+ * is called with a \ref writable, which should be invoked once the output is writable
+ * again, Eg. by an event loop polling the socket. The coroutine is resumed once all
+ * the data has been written out, or on failure.
+ *
+ *     auto wait = [&](auto writable) { loop.on_writable(fd, writable); };
+ *     w.set("samples", samples);
+ *     if (co_await json_gen::drain(jstr, wait) != 0) { ... }
+ */
+template <typename Wait>
+class backpressure {
+public:
+    /** Passed to the wait function, to be invoked once the output is writable */
+    class writable {
+    public:
+        void operator()() const
+        {
+            backpressure *bp = bp_;
+            bp->ret_ = bp->step();
+            if (bp->ret_ == JSON_GEN_AGAIN) {
+                bp->wait_(*this);
+            } else {
+                bp->handle_.resume();
+            }
+        }
+
+    private:
+        friend class backpressure;
+        explicit writable(backpressure *bp) : bp_(bp) {}
+        backpressure *bp_;
+    };
+
+    backpressure(json_gen_str_t *jstr, Wait wait, bool end) :
+        jstr_(jstr), wait_(std::move(wait)), end_(end) {}
+
+    bool await_ready()
+    {
+        ret_ = step();
+        return ret_ != JSON_GEN_AGAIN;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        handle_ = handle;
+        wait_(writable(this));
+    }
+
+    /** The return value of json_gen_str_resume() or json_gen_str_end() */
+    int64_t await_resume() const noexcept
+    {
+        return ret_;
+    }
+
+private:
+    int64_t step()
+    {
+        return end_ ? json_gen_str_end(jstr_) : json_gen_str_resume(jstr_);
+    }
+
+    json_gen_str_t *jstr_;
+    Wait wait_;
+    bool end_;
+    int64_t ret_ = 0;
+    std::coroutine_handle<> handle_;
+};
+
+/** Wait till all the data held back for a non blocking output is written out
+ *
+ * co_await gives 0 on Success, or -1 if the write callback failed.
+ */
+template <typename Wait>
+[[nodiscard]] backpressure<Wait> drain(json_gen_str_t &jstr, Wait wait)
+{
+    return backpressure<Wait>(&jstr, std::move(wait), false);
+}
+
+/** End a JSON string with a non blocking output, waiting till all the data is written out
+ *
+ * co_await gives the same values as json_gen_str_end(), other than JSON_GEN_AGAIN.
+ */
+template <typename Wait>
+[[nodiscard]] backpressure<Wait> end(json_gen_str_t &jstr, Wait wait)
+{
+    return backpressure<Wait>(&jstr, std::move(wait), true);
+}
+#endif /* JSON_GEN_HAVE_COROUTINES */
+
+/** Serialize a value into a std::string
+ *
+ * \return The JSON string, or an empty string on failure
+ */
+template <typename T>
+std::string to_string(const T &val)
+{
+    json_gen_str_t jstr;
+    json_gen_growable_t gbuf;
+    if (json_gen_str_start_growable(&jstr, &gbuf, 0, nullptr) != 0) {
+        return std::string();
+    }
+    writer w(jstr);
+    w.write(val);
+    std::size_t len = 0;
+    char *str = json_gen_str_end_growable(&jstr, &len);
+    if (!str) {
+        return std::string();
+    }
+    std::string ret(str, len);
+    std::free(str);
+    return ret;
+}
+
+} /* namespace json_gen */
+
+#endif
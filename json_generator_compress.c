@@ -0,0 +1,283 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <json_generator_compress.h>
+
+/* The output buffer is passed on only once full, or at the end */
+static int json_gen_compress_emit(json_gen_compress_t *comp, bool force)
+{
+	if (comp->out_used == comp->config.buf_size || (force && comp->out_used)) {
+		if (comp->flush_cb(comp->out_buf, comp->out_used, comp->priv) != 0) {
+			return -1;
+		}
+		comp->out_len += comp->out_used;
+		comp->out_used = 0;
+	}
+	return 0;
+}
+
+#ifdef JSON_GEN_HAVE_ZSTD
+static int json_gen_compress_zstd(json_gen_compress_t *comp, const char *data, size_t len, bool last)
+{
+	ZSTD_inBuffer in = { data, len, 0 };
+	ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+	while (1) {
+		ZSTD_outBuffer out = { comp->out_buf, comp->config.buf_size, comp->out_used };
+		size_t remaining = ZSTD_compressStream2(comp->zstd, &out, &in, mode);
+		if (ZSTD_isError(remaining)) {
+			return -1;
+		}
+		comp->out_used = out.pos;
+		bool done = last ? remaining == 0 : in.pos == in.size;
+		if (json_gen_compress_emit(comp, done && last) != 0) {
+			return -1;
+		}
+		if (done) {
+			return 0;
+		}
+	}
+}
+#endif /* JSON_GEN_HAVE_ZSTD */
+
+static int json_gen_compress_zlib(json_gen_compress_t *comp, const char *data, size_t len, bool last)
+{
+	comp->zs.next_in = (Bytef *)data;
+	comp->zs.avail_in = (uInt)len;
+	int flush = last ? Z_FINISH : Z_NO_FLUSH;
+	while (1) {
+		comp->zs.next_out = (Bytef *)comp->out_buf + comp->out_used;
+		comp->zs.avail_out = (uInt)(comp->config.buf_size - comp->out_used);
+		int ret = deflate(&comp->zs, flush);
+		if (ret == Z_STREAM_ERROR) {
+			return -1;
+		}
+		comp->out_used = comp->config.buf_size - comp->zs.avail_out;
+		/* deflate() is done with the input once it leaves some output space unused */
+		bool done = last ? ret == Z_STREAM_END : comp->zs.avail_out != 0;
+		if (json_gen_compress_emit(comp, done && last) != 0) {
+			return -1;
+		}
+		if (done) {
+			return 0;
+		}
+	}
+}
+
+static int json_gen_compress_block(json_gen_compress_t *comp, const char *data, size_t len, bool last)
+{
+	if (comp->err || (!len && !last)) {
+		return comp->err;
+	}
+#ifdef JSON_GEN_HAVE_ZSTD
+	if (comp->config.format == JSON_GEN_COMPRESS_ZSTD) {
+		comp->err = json_gen_compress_zstd(comp, data, len, last);
+		return comp->err;
+	}
+#endif /* JSON_GEN_HAVE_ZSTD */
+	comp->err = json_gen_compress_zlib(comp, data, len, last);
+	return comp->err;
+}
+
+static void *json_gen_compress_thread(void *arg)
+{
+	json_gen_compress_t *comp = (json_gen_compress_t *)arg;
+	bool last = false;
+	pthread_mutex_lock(&comp->lock);
+	while (!last) {
+		while (!comp->busy) {
+			pthread_cond_wait(&comp->cond, &comp->lock);
+		}
+		last = comp->pending_last;
+		pthread_mutex_unlock(&comp->lock);
+		json_gen_compress_block(comp, comp->pending, comp->pending_len, last);
+		pthread_mutex_lock(&comp->lock);
+		comp->busy = false;
+		pthread_cond_broadcast(&comp->cond);
+	}
+	pthread_mutex_unlock(&comp->lock);
+	return NULL;
+}
+
+/* Hand over a buffer to the background thread, once it is done with the previous one */
+static int json_gen_compress_submit(json_gen_compress_t *comp, const char *data, size_t len, bool last)
+{
+	pthread_mutex_lock(&comp->lock);
+	while (comp->busy) {
+		pthread_cond_wait(&comp->cond, &comp->lock);
+	}
+	int err = comp->err;
+	if (!err || last) {
+		comp->pending = data;
+		comp->pending_len = len;
+		comp->pending_last = last;
+		comp->busy = true;
+		pthread_cond_broadcast(&comp->cond);
+	}
+	pthread_mutex_unlock(&comp->lock);
+	return err;
+}
+
+static int json_gen_compress_flush(json_gen_sink_t *sink, const char *data, size_t len, size_t need,
+		char **buf, size_t *buf_size)
+{
+	json_gen_compress_t *comp = (json_gen_compress_t *)sink;
+	if (data) {
+		int err;
+		if (comp->config.background) {
+			err = json_gen_compress_submit(comp, data, len, false);
+			/* The other buffer is free, since the previous one has been compressed */
+			comp->cur ^= 1;
+		} else {
+			err = json_gen_compress_block(comp, data, len, false);
+		}
+		if (err) {
+			return -1;
+		}
+	}
+	int cur = comp->cur;
+	if (need > comp->in_size[cur]) {
+		char *new_buf = realloc(comp->in_buf[cur], need);
+		if (!new_buf) {
+			return -1;
+		}
+		comp->in_buf[cur] = new_buf;
+		comp->in_size[cur] = need;
+	}
+	*buf = comp->in_buf[cur];
+	*buf_size = comp->in_size[cur];
+	return 0;
+}
+
+static void json_gen_compress_free(json_gen_compress_t *comp)
+{
+#ifdef JSON_GEN_HAVE_ZSTD
+	if (comp->zstd) {
+		ZSTD_freeCCtx(comp->zstd);
+		comp->zstd = NULL;
+	}
+#endif /* JSON_GEN_HAVE_ZSTD */
+	if (comp->config.format != JSON_GEN_COMPRESS_ZSTD) {
+		deflateEnd(&comp->zs);
+	}
+	if (comp->config.background) {
+		pthread_cond_destroy(&comp->cond);
+		pthread_mutex_destroy(&comp->lock);
+	}
+	for (int i = 0; i < 2; i++) {
+		free(comp->in_buf[i]);
+		comp->in_buf[i] = NULL;
+	}
+	free(comp->out_buf);
+	comp->out_buf = NULL;
+}
+
+static int json_gen_compress_end(json_gen_sink_t *sink, const char *data, size_t len)
+{
+	json_gen_compress_t *comp = (json_gen_compress_t *)sink;
+	if (comp->config.background) {
+		json_gen_compress_submit(comp, data, len, true);
+		pthread_join(comp->thread, NULL);
+	} else {
+		json_gen_compress_block(comp, data, len, true);
+	}
+	json_gen_compress_free(comp);
+	return comp->err ? -1 : 0;
+}
+
+static int json_gen_compress_init(json_gen_compress_t *comp)
+{
+	int level = comp->config.level;
+	switch (comp->config.format) {
+		case JSON_GEN_COMPRESS_GZIP:
+		case JSON_GEN_COMPRESS_DEFLATE:
+		case JSON_GEN_COMPRESS_RAW_DEFLATE: {
+			/* The window bits select the wrapper, as documented for deflateInit2() */
+			int window_bits = 15;
+			if (comp->config.format == JSON_GEN_COMPRESS_GZIP) {
+				window_bits += 16;
+			} else if (comp->config.format == JSON_GEN_COMPRESS_RAW_DEFLATE) {
+				window_bits = -window_bits;
+			}
+			if (!level) {
+				level = Z_DEFAULT_COMPRESSION;
+			}
+			return deflateInit2(&comp->zs, level, Z_DEFLATED, window_bits, 8,
+					Z_DEFAULT_STRATEGY) == Z_OK ? 0 : -1;
+		}
+#ifdef JSON_GEN_HAVE_ZSTD
+		case JSON_GEN_COMPRESS_ZSTD:
+			comp->zstd = ZSTD_createCCtx();
+			if (!comp->zstd) {
+				return -1;
+			}
+			if (level && ZSTD_isError(ZSTD_CCtx_setParameter(comp->zstd,
+							ZSTD_c_compressionLevel, level))) {
+				ZSTD_freeCCtx(comp->zstd);
+				comp->zstd = NULL;
+				return -1;
+			}
+			return 0;
+#endif /* JSON_GEN_HAVE_ZSTD */
+		default:
+			return -1;
+	}
+}
+
+int json_gen_str_start_compressed(json_gen_str_t *jstr, json_gen_compress_t *comp,
+        const json_gen_compress_config_t *config, json_gen_flush_cb_v2_t flush_cb, void *priv)
+{
+	memset(comp, 0, sizeof(json_gen_compress_t));
+	if (config) {
+		comp->config = *config;
+	}
+	if (!comp->config.buf_size) {
+		comp->config.buf_size = JSON_GEN_COMPRESS_BUF_SIZE;
+	}
+	comp->flush_cb = flush_cb;
+	comp->priv = priv;
+	if (json_gen_compress_init(comp) != 0) {
+		return -1;
+	}
+	int num_bufs = comp->config.background ? 2 : 1;
+	for (int i = 0; i < num_bufs; i++) {
+		comp->in_buf[i] = malloc(comp->config.buf_size);
+		comp->in_size[i] = comp->config.buf_size;
+	}
+	comp->out_buf = malloc(comp->config.buf_size);
+	if (!comp->in_buf[0] || !comp->in_buf[num_bufs - 1] || !comp->out_buf) {
+		comp->config.background = false;
+		json_gen_compress_free(comp);
+		return -1;
+	}
+	if (comp->config.background) {
+		pthread_mutex_init(&comp->lock, NULL);
+		pthread_cond_init(&comp->cond, NULL);
+		if (pthread_create(&comp->thread, NULL, json_gen_compress_thread, comp) != 0) {
+			json_gen_compress_free(comp);
+			return -1;
+		}
+	}
+	comp->sink.flush = json_gen_compress_flush;
+	comp->sink.end = json_gen_compress_end;
+	if (json_gen_str_start_sink(jstr, &comp->sink) != 0) {
+		json_gen_compress_end(&comp->sink, NULL, 0);
+		return -1;
+	}
+	return 0;
+}
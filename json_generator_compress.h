@@ -0,0 +1,151 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * JSON String Generator - Compressed output
+ *
+ * This module compresses the JSON string as it gets generated, one buffer at a time,
+ * and passes the compressed data to a flush callback. gzip and deflate are supported
+ * using zlib. zstd is supported if built with JSON_GEN_HAVE_ZSTD defined, using libzstd.
+ * Compression can optionally run on a background thread, overlapping with the
+ * generation. This requires zlib and POSIX threads and is optional. The core JSON
+ * generator does not depend on it.
+ *
+ */
+#ifndef _JSON_GENERATOR_COMPRESS_H
+#define _JSON_GENERATOR_COMPRESS_H
+
+#include <pthread.h>
+#include <zlib.h>
+#ifdef JSON_GEN_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include <json_generator.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Default size of the input and output buffers for compression */
+#ifndef JSON_GEN_COMPRESS_BUF_SIZE
+#define JSON_GEN_COMPRESS_BUF_SIZE 16384
+#endif
+
+/** Compression formats */
+typedef enum {
+    /** gzip (RFC 1952), Eg. for "Content-Encoding: gzip" */
+    JSON_GEN_COMPRESS_GZIP = 0,
+    /** zlib wrapped deflate (RFC 1950), Eg. for "Content-Encoding: deflate" */
+    JSON_GEN_COMPRESS_DEFLATE,
+    /** Raw deflate (RFC 1951), without any header or trailer */
+    JSON_GEN_COMPRESS_RAW_DEFLATE,
+    /** zstd. Available only if built with JSON_GEN_HAVE_ZSTD */
+    JSON_GEN_COMPRESS_ZSTD,
+} json_gen_compress_format_t;
+
+/** Configuration for json_gen_str_start_compressed() */
+typedef struct {
+    /** Compression format */
+    json_gen_compress_format_t format;
+    /** Compression level. 0 for the default of the format */
+    int level;
+    /** Size of the input and output buffers. 0 for JSON_GEN_COMPRESS_BUF_SIZE */
+    size_t buf_size;
+    /** Compress on a background thread, while the next buffer is being generated */
+    bool background;
+} json_gen_compress_config_t;
+
+/** Compressed output state
+ *
+ * Please do not set/modify any elements.
+ * Just define this structure and pass a pointer to it to json_gen_str_start_compressed().
+ * It should stay valid till json_gen_str_end().
+ */
+typedef struct {
+    /** (For Internal use only) */
+    json_gen_sink_t sink;
+    /** (For Internal use only) */
+    json_gen_compress_config_t config;
+    /** (For Internal use only) */
+    json_gen_flush_cb_v2_t flush_cb;
+    /** (For Internal use only) */
+    void *priv;
+    /** (For Internal use only) Buffers for the JSON string, two if compressing in background */
+    char *in_buf[2];
+    /** (For Internal use only) */
+    size_t in_size[2];
+    /** (For Internal use only) Index of the buffer being generated */
+    int cur;
+    /** (For Internal use only) */
+    char *out_buf;
+    /** (For Internal use only) */
+    size_t out_used;
+    /** (For Internal use only) */
+    z_stream zs;
+#ifdef JSON_GEN_HAVE_ZSTD
+    /** (For Internal use only) */
+    ZSTD_CCtx *zstd;
+#endif
+    /** (For Internal use only) */
+    pthread_t thread;
+    /** (For Internal use only) */
+    pthread_mutex_t lock;
+    /** (For Internal use only) */
+    pthread_cond_t cond;
+    /** (For Internal use only) Data handed over to the background thread */
+    const char *pending;
+    /** (For Internal use only) */
+    size_t pending_len;
+    /** (For Internal use only) */
+    bool pending_last;
+    /** (For Internal use only) */
+    bool busy;
+    /** Length of the compressed data. Valid after json_gen_str_end() too */
+    uint64_t out_len;
+    /** 0, or -1 if the compression or the flush callback failed. Valid after
+     * json_gen_str_end() too
+     */
+    int err;
+} json_gen_compress_t;
+
+/** Start a compressed JSON String
+ *
+ * The JSON string is generated in a buffer allocated internally. Whenever this gets full,
+ * its contents are compressed and the compressed data is passed on to the flush callback
+ * in chunks of up to buf_size. json_gen_str_end() finishes the compressed stream.
+ *
+ * If the compression or the flush callback fails at any point, json_gen_str_end()
+ * returns -1. It still returns the length of the uncompressed JSON string on success.
+ * The length of the compressed data is available in the out_len member.
+ *
+ * \param[out] jstr Pointer to an allocated \ref json_gen_str_t structure.
+ * \param[out] comp Pointer to an allocated \ref json_gen_compress_t structure.
+ * \param[in] config Configuration. Can be NULL for gzip at the default level.
+ * \param[in] flush_cb Callback function for the compressed data
+ * \param[in] priv Private data to be passed to the callback
+ *
+ * \return 0 on Success
+ * \return -1 if the format is not supported, or the buffers, the compressor or the
+ * background thread could not be set up
+ */
+int json_gen_str_start_compressed(json_gen_str_t *jstr, json_gen_compress_t *comp,
+        const json_gen_compress_config_t *config, json_gen_flush_cb_v2_t flush_cb, void *priv);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
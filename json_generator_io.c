@@ -0,0 +1,336 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <json_generator_io.h>
+
+/* Write out all the pending chunks, retrying partial writes */
+static int json_gen_io_write_all(json_gen_io_sink_t *sink)
+{
+	if (sink->file) {
+		for (int i = 0; i < sink->num_segs; i++) {
+			errno = 0;
+			if (fwrite(sink->segs[i].base, 1, sink->segs[i].len, sink->file) != sink->segs[i].len) {
+				/* errno is set by the stream only if it has reported an error */
+				sink->err = ferror(sink->file) && errno ? errno : EIO;
+				return -1;
+			}
+		}
+		sink->num_segs = 0;
+		return 0;
+	}
+	struct iovec iov[JSON_GEN_IO_MAX_SEGS];
+	int num_iov = sink->num_segs;
+	for (int i = 0; i < num_iov; i++) {
+		iov[i].iov_base = (void *)sink->segs[i].base;
+		iov[i].iov_len = sink->segs[i].len;
+	}
+	struct iovec *cur = iov;
+	while (num_iov) {
+		ssize_t written = writev(sink->fd, cur, num_iov);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			sink->err = errno;
+			return -1;
+		}
+		bool progress = written > 0;
+		/* Skip over whatever got written and retry the rest */
+		while (num_iov && (size_t)written >= cur->iov_len) {
+			written -= cur->iov_len;
+			cur++;
+			num_iov--;
+		}
+		if (num_iov) {
+			/* Retrying would never end if nothing can be written */
+			if (!progress) {
+				sink->err = EIO;
+				return -1;
+			}
+			cur->iov_base = (char *)cur->iov_base + written;
+			cur->iov_len -= written;
+		}
+	}
+	sink->num_segs = 0;
+	return 0;
+}
+
+static int json_gen_io_add_seg(json_gen_io_sink_t *sink, const char *data, size_t len)
+{
+	if (sink->num_segs) {
+		json_gen_io_seg_t *last = &sink->segs[sink->num_segs - 1];
+		if (last->base + last->len == data) {
+			last->len += len;
+			return 0;
+		}
+	}
+	if (sink->num_segs == JSON_GEN_IO_MAX_SEGS && json_gen_io_write_all(sink) != 0) {
+		return -1;
+	}
+	sink->segs[sink->num_segs].base = data;
+	sink->segs[sink->num_segs].len = len;
+	sink->num_segs++;
+	return 0;
+}
+
+/* Chunks flushed out before the buffer is full are just queued and the rest of
+ * the buffer is handed back, so that they get written together later.
+ */
+static int json_gen_io_flush(json_gen_sink_t *s, const char *data, size_t len, size_t need,
+		char **buf, size_t *buf_size)
+{
+	json_gen_io_sink_t *sink = (json_gen_io_sink_t *)s;
+	if (sink->err) {
+		return -1;
+	}
+	char *next = sink->buf;
+	if (data) {
+		if (len && json_gen_io_add_seg(sink, data, len) != 0) {
+			return -1;
+		}
+		next = (char *)data + len;
+	}
+	size_t remaining = sink->buf + sink->buf_size - next;
+	/* Do not bother continuing with a nearly full buffer */
+	if (remaining < need || remaining < sink->buf_size / 4) {
+		if (json_gen_io_write_all(sink) != 0) {
+			return -1;
+		}
+		next = sink->buf;
+		remaining = sink->buf_size;
+	}
+	*buf = next;
+	*buf_size = remaining;
+	return 0;
+}
+
+/* Large blobs are written out right away, along with the queued chunks */
+static int json_gen_io_write(json_gen_sink_t *s, const char *data, size_t len)
+{
+	json_gen_io_sink_t *sink = (json_gen_io_sink_t *)s;
+	if (sink->err || json_gen_io_add_seg(sink, data, len) != 0) {
+		return -1;
+	}
+	return json_gen_io_write_all(sink);
+}
+
+static int json_gen_io_end(json_gen_sink_t *s, const char *data, size_t len)
+{
+	json_gen_io_sink_t *sink = (json_gen_io_sink_t *)s;
+	if (!sink->err) {
+		if (len == 0 || json_gen_io_add_seg(sink, data, len) == 0) {
+			json_gen_io_write_all(sink);
+		}
+	}
+	free(sink->buf);
+	sink->buf = NULL;
+	sink->num_segs = 0;
+	return sink->err ? -1 : 0;
+}
+
+static int json_gen_io_start(json_gen_str_t *jstr, json_gen_io_sink_t *sink, size_t buf_size)
+{
+	if (!buf_size) {
+		buf_size = JSON_GEN_IO_BUF_SIZE;
+	}
+	sink->buf = malloc(buf_size);
+	if (!sink->buf) {
+		return -1;
+	}
+	sink->buf_size = buf_size;
+	sink->sink.flush = json_gen_io_flush;
+	sink->sink.end = json_gen_io_end;
+	sink->sink.write = json_gen_io_write;
+	if (json_gen_str_start_sink(jstr, &sink->sink) != 0) {
+		free(sink->buf);
+		sink->buf = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+int json_gen_str_start_fd(json_gen_str_t *jstr, json_gen_io_sink_t *sink, int fd, size_t buf_size)
+{
+	memset(sink, 0, sizeof(json_gen_io_sink_t));
+	sink->fd = fd;
+	return json_gen_io_start(jstr, sink, buf_size);
+}
+
+int json_gen_str_start_file(json_gen_str_t *jstr, json_gen_io_sink_t *sink, FILE *file, size_t buf_size)
+{
+	memset(sink, 0, sizeof(json_gen_io_sink_t));
+	sink->fd = -1;
+	sink->file = file;
+	return json_gen_io_start(jstr, sink, buf_size);
+}
+
+/* The file only ever grows till the end, in steps of at least the extent */
+static int json_gen_mmap_grow(json_gen_mmap_sink_t *sink, uint64_t size)
+{
+	if (size <= sink->file_size) {
+		return 0;
+	}
+	uint64_t new_size = sink->file_size + sink->config.extent;
+	if (new_size < size) {
+		new_size = size;
+	}
+	if (ftruncate(sink->fd, (off_t)new_size) != 0) {
+		sink->err = errno;
+		return -1;
+	}
+	sink->file_size = new_size;
+	return 0;
+}
+
+static void json_gen_mmap_unmap_prev(json_gen_mmap_sink_t *sink)
+{
+	if (sink->prev) {
+		munmap(sink->prev, sink->prev_size);
+		sink->prev = NULL;
+	}
+}
+
+/* Nothing before sink->used gets written any more */
+static void json_gen_mmap_complete(json_gen_mmap_sink_t *sink)
+{
+	size_t done = (size_t)(sink->used - sink->win_off);
+	if (done > sink->win_size) {
+		done = sink->win_size;
+	}
+	if (!done) {
+		return;
+	}
+	if (sink->config.sync) {
+		msync(sink->win, done, MS_ASYNC);
+	}
+	if (sink->config.advise) {
+		posix_fadvise(sink->fd, (off_t)sink->win_off, (off_t)done, POSIX_FADV_DONTNEED);
+	}
+}
+
+/* Map a new window starting at the page of sink->used, with space for need bytes */
+static int json_gen_mmap_map(json_gen_mmap_sink_t *sink, size_t need)
+{
+	uint64_t off = sink->used - sink->used % sink->page_size;
+	size_t in_page = (size_t)(sink->used - off);
+	size_t size = sink->config.extent;
+	if (in_page + need > size) {
+		size = (in_page + need + sink->page_size - 1) / sink->page_size * sink->page_size;
+	}
+	if (json_gen_mmap_grow(sink, off + size) != 0) {
+		return -1;
+	}
+	char *win = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, sink->fd, (off_t)off);
+	if (win == MAP_FAILED) {
+		sink->err = errno;
+		return -1;
+	}
+	if (sink->config.advise) {
+		madvise(win, size, MADV_SEQUENTIAL);
+	}
+	if (sink->win) {
+		json_gen_mmap_complete(sink);
+		sink->prev = sink->win;
+		sink->prev_size = sink->win_size;
+	}
+	sink->win = win;
+	sink->win_off = off;
+	sink->win_size = size;
+	return 0;
+}
+
+/* The data is already in the file. A new window is mapped only once the current
+ * one is (nearly) full.
+ */
+static int json_gen_mmap_flush(json_gen_sink_t *s, const char *data, size_t len, size_t need,
+		char **buf, size_t *buf_size)
+{
+	json_gen_mmap_sink_t *sink = (json_gen_mmap_sink_t *)s;
+	if (sink->err) {
+		return -1;
+	}
+	json_gen_mmap_unmap_prev(sink);
+	sink->used += len;
+	size_t remaining = 0;
+	if (sink->win) {
+		remaining = (size_t)(sink->win_off + sink->win_size - sink->used);
+	}
+	if (!remaining || remaining < need || remaining < sink->win_size / 4) {
+		if (json_gen_mmap_map(sink, need ? need : 1) != 0) {
+			return -1;
+		}
+		remaining = (size_t)(sink->win_off + sink->win_size - sink->used);
+	}
+	*buf = sink->win + (sink->used - sink->win_off);
+	*buf_size = remaining;
+	return 0;
+}
+
+static int json_gen_mmap_end(json_gen_sink_t *s, const char *data, size_t len)
+{
+	json_gen_mmap_sink_t *sink = (json_gen_mmap_sink_t *)s;
+	json_gen_mmap_unmap_prev(sink);
+	if (!sink->err) {
+		sink->used += len;
+	}
+	if (sink->win) {
+		json_gen_mmap_complete(sink);
+		munmap(sink->win, sink->win_size);
+		sink->win = NULL;
+	}
+	if (!sink->err && ftruncate(sink->fd, (off_t)sink->used) != 0) {
+		sink->err = errno;
+	}
+	return sink->err ? -1 : 0;
+}
+
+int json_gen_str_start_mmap(json_gen_str_t *jstr, json_gen_mmap_sink_t *sink, int fd,
+        const json_gen_mmap_config_t *config)
+{
+	memset(sink, 0, sizeof(json_gen_mmap_sink_t));
+	if (config) {
+		sink->config = *config;
+	}
+	sink->fd = fd;
+	sink->page_size = (size_t)sysconf(_SC_PAGESIZE);
+	if (!sink->config.extent) {
+		sink->config.extent = JSON_GEN_MMAP_EXTENT;
+	}
+	sink->config.extent = (sink->config.extent + sink->page_size - 1) / sink->page_size *
+			sink->page_size;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		sink->err = errno;
+		return -1;
+	}
+	sink->file_size = (uint64_t)st.st_size;
+	if (sink->config.size_hint && json_gen_mmap_grow(sink, sink->config.size_hint) != 0) {
+		return -1;
+	}
+	sink->sink.flush = json_gen_mmap_flush;
+	sink->sink.end = json_gen_mmap_end;
+	return json_gen_str_start_sink(jstr, &sink->sink);
+}
@@ -0,0 +1,201 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * JSON String Generator - File and socket outputs
+ *
+ * This module provides ready to use sinks for writing the JSON string
+ * to a file descriptor (Eg. a file, pipe or socket) or a FILE stream.
+ * The sinks manage their own buffer and batch the writes. Files can also be
+ * memory mapped, so that the JSON string is generated directly in the file.
+ * This requires POSIX and is optional. The core JSON generator does
+ * not depend on it.
+ *
+ */
+#ifndef _JSON_GENERATOR_IO_H
+#define _JSON_GENERATOR_IO_H
+
+#include <stdio.h>
+#include <json_generator.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Default buffer size for the file outputs */
+#ifndef JSON_GEN_IO_BUF_SIZE
+#define JSON_GEN_IO_BUF_SIZE 16384
+#endif
+
+/** Maximum number of chunks batched into a single writev() */
+#ifndef JSON_GEN_IO_MAX_SEGS
+#define JSON_GEN_IO_MAX_SEGS 16
+#endif
+
+/** A chunk of data pending to be written out */
+typedef struct {
+    /** (For Internal use only) */
+    const char *base;
+    /** (For Internal use only) */
+    size_t len;
+} json_gen_io_seg_t;
+
+/** File output state
+ *
+ * Please do not set/modify any elements.
+ * Just define this structure and pass a pointer to it to json_gen_str_start_fd()
+ * or json_gen_str_start_file(). It should stay valid till json_gen_str_end().
+ */
+typedef struct {
+    /** (For Internal use only) */
+    json_gen_sink_t sink;
+    /** (For Internal use only) */
+    int fd;
+    /** (For Internal use only) */
+    FILE *file;
+    /** (For Internal use only) */
+    char *buf;
+    /** (For Internal use only) */
+    size_t buf_size;
+    /** (For Internal use only) */
+    json_gen_io_seg_t segs[JSON_GEN_IO_MAX_SEGS];
+    /** (For Internal use only) */
+    int num_segs;
+    /** errno of the first failed write, or 0. Valid after json_gen_str_end() too */
+    int err;
+} json_gen_io_sink_t;
+
+/** Start a JSON String written to a file descriptor
+ *
+ * This allocates a buffer of the given size and writes the JSON string to the file
+ * descriptor as it gets generated. Data flushed before the buffer is full (Eg. by
+ * json_gen_reserve()) is batched and written with a single writev(). Partial
+ * writes and interruptions are retried.
+ *
+ * If any write fails, json_gen_str_end() returns -1 and the errno is available
+ * in the err member of the sink. The file descriptor is not closed.
+ *
+ * \param[out] jstr Pointer to an allocated \ref json_gen_str_t structure.
+ * \param[out] sink Pointer to an allocated \ref json_gen_io_sink_t structure.
+ * \param[in] fd File descriptor, opened for writing. Should be in blocking mode.
+ * \param[in] buf_size Size of the buffer to allocate. 0 for JSON_GEN_IO_BUF_SIZE
+ *
+ * \return 0 on Success
+ * \return -1 if the buffer could not be allocated
+ */
+int json_gen_str_start_fd(json_gen_str_t *jstr, json_gen_io_sink_t *sink, int fd, size_t buf_size);
+
+/** Start a JSON String written to a FILE stream
+ *
+ * This is the same as json_gen_str_start_fd(), except that the data is written
+ * with fwrite(). The stream is neither flushed nor closed.
+ *
+ * \param[out] jstr Pointer to an allocated \ref json_gen_str_t structure.
+ * \param[out] sink Pointer to an allocated \ref json_gen_io_sink_t structure.
+ * \param[in] file FILE stream, opened for writing
+ * \param[in] buf_size Size of the buffer to allocate. 0 for JSON_GEN_IO_BUF_SIZE
+ *
+ * \return 0 on Success
+ * \return -1 if the buffer could not be allocated
+ */
+int json_gen_str_start_file(json_gen_str_t *jstr, json_gen_io_sink_t *sink, FILE *file, size_t buf_size);
+
+/** Default size of the windows of a memory mapped file, which is also the step in
+ * which the file grows
+ */
+#ifndef JSON_GEN_MMAP_EXTENT
+#define JSON_GEN_MMAP_EXTENT (16 * 1024 * 1024)
+#endif
+
+/** Configuration for json_gen_str_start_mmap(). All members can be 0 for defaults. */
+typedef struct {
+    /** Size of the mapped windows and the step in which the file grows. Rounded up to
+     * the page size. 0 for JSON_GEN_MMAP_EXTENT
+     */
+    size_t extent;
+    /** Expected size of the JSON string, to which the file is grown at the start.
+     * 0 if not known
+     */
+    uint64_t size_hint;
+    /** Start writing back each completed window with msync(MS_ASYNC) */
+    bool sync;
+    /** Advise the kernel about the sequential access with madvise(), and that the
+     * completed parts of the file will not be needed again with posix_fadvise()
+     */
+    bool advise;
+} json_gen_mmap_config_t;
+
+/** Memory mapped file output state
+ *
+ * Please do not set/modify any elements.
+ * Just define this structure and pass a pointer to it to json_gen_str_start_mmap().
+ * It should stay valid till json_gen_str_end().
+ */
+typedef struct {
+    /** (For Internal use only) */
+    json_gen_sink_t sink;
+    /** (For Internal use only) */
+    json_gen_mmap_config_t config;
+    /** (For Internal use only) */
+    int fd;
+    /** (For Internal use only) */
+    size_t page_size;
+    /** (For Internal use only) Current file size, including the space not yet used */
+    uint64_t file_size;
+    /** (For Internal use only) Length of the data completed */
+    uint64_t used;
+    /** (For Internal use only) The window being filled */
+    char *win;
+    /** (For Internal use only) */
+    uint64_t win_off;
+    /** (For Internal use only) */
+    size_t win_size;
+    /** (For Internal use only) The previous window, unmapped at the next flush, since
+     * data from it may still be carried over to the new one
+     */
+    char *prev;
+    /** (For Internal use only) */
+    size_t prev_size;
+    /** errno of the first failed call, or 0. Valid after json_gen_str_end() too */
+    int err;
+} json_gen_mmap_sink_t;
+
+/** Start a JSON String generated directly in a memory mapped file
+ *
+ * The file is mapped in windows of the configured extent, which the JSON string is
+ * written into, without any copies or write calls. The file is grown with ftruncate()
+ * as required, and truncated to the exact length of the JSON string by
+ * json_gen_str_end(). It is written from the start, replacing any existing contents.
+ *
+ * If mapping or resizing the file fails, json_gen_str_end() returns -1 and the errno
+ * is available in the err member of the sink. The file descriptor is not closed.
+ *
+ * \param[out] jstr Pointer to an allocated \ref json_gen_str_t structure.
+ * \param[out] sink Pointer to an allocated \ref json_gen_mmap_sink_t structure.
+ * \param[in] fd File descriptor of a regular file, opened for reading and writing
+ * \param[in] config Configuration. Can be NULL for defaults.
+ *
+ * \return 0 on Success
+ * \return -1 if the file could not be resized or mapped
+ */
+int json_gen_str_start_mmap(json_gen_str_t *jstr, json_gen_mmap_sink_t *sink, int fd,
+        const json_gen_mmap_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,227 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <json_generator_par.h>
+
+typedef enum {
+	JSON_GEN_PAR_FREE = 0,
+	JSON_GEN_PAR_BUSY,
+	JSON_GEN_PAR_DONE,
+} json_gen_par_slot_state_t;
+
+/* A completed fragment, waiting to be spliced */
+typedef struct {
+	json_gen_par_slot_state_t state;
+	char *data;
+	size_t len;
+} json_gen_par_slot_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+	/* Signalled when a chunk completes */
+	pthread_cond_t done;
+	/* Signalled when a chunk gets spliced, freeing up its slot */
+	pthread_cond_t space;
+	json_gen_par_slot_t *slots;
+	size_t max_pending;
+	size_t num_chunks;
+	size_t chunk_size;
+	size_t count;
+	/* Next chunk to be picked up by a worker */
+	size_t next_chunk;
+	/* Next chunk to be spliced */
+	size_t spliced;
+	bool abort;
+	json_gen_par_cb_t cb;
+	void *priv;
+	json_gen_float_fmt_t float_fmt;
+	int float_precision;
+	bool escape;
+	json_gen_format_t format;
+} json_gen_par_t;
+
+/* Encode a chunk into a fragment of its own. The fragment is at the top level,
+ * so it has no leading comma.
+ */
+static int json_gen_par_encode(json_gen_par_t *par, size_t chunk, json_gen_par_slot_t *slot)
+{
+	json_gen_str_t frag;
+	json_gen_growable_t gbuf;
+	if (json_gen_str_start_growable(&frag, &gbuf, 0, NULL) != 0) {
+		return -1;
+	}
+	json_gen_str_set_float_format(&frag, par->float_fmt, par->float_precision);
+	json_gen_str_set_escape(&frag, par->escape);
+	json_gen_str_set_format(&frag, par->format);
+	size_t start = chunk * par->chunk_size;
+	size_t end = start + par->chunk_size;
+	if (end > par->count) {
+		end = par->count;
+	}
+	int ret = par->cb(&frag, start, end, par->priv);
+	slot->data = json_gen_str_end_growable(&frag, &slot->len);
+	if (ret != 0) {
+		free(slot->data);
+		slot->data = NULL;
+	}
+	return slot->data ? 0 : -1;
+}
+
+static void *json_gen_par_worker(void *arg)
+{
+	json_gen_par_t *par = (json_gen_par_t *)arg;
+	pthread_mutex_lock(&par->lock);
+	while (!par->abort && par->next_chunk < par->num_chunks) {
+		/* Do not run too far ahead of the splicing */
+		if (par->next_chunk >= par->spliced + par->max_pending) {
+			pthread_cond_wait(&par->space, &par->lock);
+			continue;
+		}
+		size_t chunk = par->next_chunk++;
+		json_gen_par_slot_t *slot = &par->slots[chunk % par->max_pending];
+		slot->state = JSON_GEN_PAR_BUSY;
+		pthread_mutex_unlock(&par->lock);
+		int ret = json_gen_par_encode(par, chunk, slot);
+		pthread_mutex_lock(&par->lock);
+		if (ret != 0) {
+			par->abort = true;
+		}
+		slot->state = JSON_GEN_PAR_DONE;
+		pthread_cond_broadcast(&par->done);
+	}
+	pthread_mutex_unlock(&par->lock);
+	return NULL;
+}
+
+int json_gen_arr_set_parallel(json_gen_str_t *jstr, size_t count, json_gen_par_cb_t cb,
+        void *priv, const json_gen_par_config_t *config)
+{
+	json_gen_par_config_t cfg = {0};
+	if (config) {
+		cfg = *config;
+	}
+	if (!cfg.chunk_size) {
+		cfg.chunk_size = JSON_GEN_PAR_CHUNK_SIZE;
+	}
+	if (cfg.num_threads <= 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		cfg.num_threads = cpus > 0 ? (int)cpus : 1;
+	}
+	size_t num_chunks = (count + cfg.chunk_size - 1) / cfg.chunk_size;
+	if ((size_t)cfg.num_threads > num_chunks) {
+		cfg.num_threads = (int)num_chunks;
+	}
+	/* Nothing to be gained from the threads. Just add the elements directly. So also
+	 * for MessagePack, as the elements of the array have to be counted in its header,
+	 * and for pretty printing, which needs the indentation of the array.
+	 */
+	if (cfg.num_threads <= 1 || jstr->format == JSON_GEN_FORMAT_MSGPACK || jstr->indent) {
+		if (count && cb(jstr, 0, count, priv) != 0) {
+			return json_gen_str_fail(jstr, -1);
+		}
+		return jstr->err;
+	}
+	if (!cfg.max_pending) {
+		cfg.max_pending = 2 * (size_t)cfg.num_threads;
+	}
+
+	json_gen_par_t par = {
+		.max_pending = cfg.max_pending,
+		.num_chunks = num_chunks,
+		.chunk_size = cfg.chunk_size,
+		.count = count,
+		.cb = cb,
+		.priv = priv,
+		.float_fmt = jstr->float_fmt,
+		.float_precision = jstr->float_precision,
+		.escape = jstr->escape,
+		.format = jstr->format,
+	};
+	par.slots = calloc(cfg.max_pending, sizeof(json_gen_par_slot_t));
+	pthread_t *threads = calloc(cfg.num_threads, sizeof(pthread_t));
+	if (!par.slots || !threads) {
+		free(par.slots);
+		free(threads);
+		return json_gen_str_fail(jstr, -1);
+	}
+	pthread_mutex_init(&par.lock, NULL);
+	pthread_cond_init(&par.done, NULL);
+	pthread_cond_init(&par.space, NULL);
+	int ret = 0;
+	int num_started = 0;
+	for (; num_started < cfg.num_threads; num_started++) {
+		if (pthread_create(&threads[num_started], NULL, json_gen_par_worker, &par) != 0) {
+			break;
+		}
+	}
+	if (!num_started) {
+		ret = -1;
+	}
+
+	/* Splice the fragments in order as they complete */
+	pthread_mutex_lock(&par.lock);
+	while (ret == 0 && par.spliced < num_chunks) {
+		json_gen_par_slot_t *slot = &par.slots[par.spliced % par.max_pending];
+		if (par.abort) {
+			ret = -1;
+			break;
+		}
+		if (slot->state != JSON_GEN_PAR_DONE) {
+			pthread_cond_wait(&par.done, &par.lock);
+			continue;
+		}
+		pthread_mutex_unlock(&par.lock);
+		if (slot->len) {
+			ret = json_gen_arr_push_raw(jstr, slot->data, slot->len);
+			/* Backpressure of a non blocking output is reported at the end */
+			if (ret == JSON_GEN_AGAIN) {
+				ret = 0;
+			}
+		}
+		free(slot->data);
+		slot->data = NULL;
+		pthread_mutex_lock(&par.lock);
+		slot->state = JSON_GEN_PAR_FREE;
+		par.spliced++;
+		pthread_cond_broadcast(&par.space);
+	}
+	par.abort = true;
+	pthread_cond_broadcast(&par.space);
+	pthread_mutex_unlock(&par.lock);
+
+	for (int i = 0; i < num_started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	/* Fragments completed after a failure are never spliced */
+	for (size_t i = 0; i < par.max_pending; i++) {
+		free(par.slots[i].data);
+	}
+	pthread_cond_destroy(&par.space);
+	pthread_cond_destroy(&par.done);
+	pthread_mutex_destroy(&par.lock);
+	free(threads);
+	free(par.slots);
+	/* The array would be left with only some of the elements */
+	if (ret != 0) {
+		return json_gen_str_fail(jstr, ret);
+	}
+	return json_gen_str_backlog(jstr) ? JSON_GEN_AGAIN : 0;
+}
@@ -0,0 +1,107 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * JSON String Generator - Parallel arrays
+ *
+ * This module generates the elements of a large array on multiple threads.
+ * The elements are split into chunks, each of which is encoded by a worker
+ * thread into a fragment of its own. The calling thread splices the fragments,
+ * in order, into the parent JSON string as they complete.
+ * This requires POSIX threads and is optional. The core JSON generator does
+ * not depend on it.
+ *
+ */
+#ifndef _JSON_GENERATOR_PAR_H
+#define _JSON_GENERATOR_PAR_H
+
+#include <json_generator.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Default number of array elements per chunk */
+#ifndef JSON_GEN_PAR_CHUNK_SIZE
+#define JSON_GEN_PAR_CHUNK_SIZE 1024
+#endif
+
+/** Chunk callback prototype
+ *
+ * This is called on a worker thread and should add the array elements from start
+ * (inclusive) to end (exclusive) to the fragment, using the array APIs, Eg.
+ * json_gen_arr_set_int() or json_gen_start_object(). The commas are handled
+ * internally. Nothing needs to be added for elements which are to be skipped.
+ *
+ * \param[in] jstr Fragment for the chunk. It must not be ended by the callback.
+ * \param[in] start Index of the first element of the chunk
+ * \param[in] end Index after the last element of the chunk
+ * \param[in] priv Private data passed to json_gen_arr_set_parallel()
+ *
+ * \return 0 on Success
+ * \return Any other value on failure, which stops the generation.
+ */
+typedef int (*json_gen_par_cb_t)(json_gen_str_t *jstr, size_t start, size_t end, void *priv);
+
+/** Configuration for json_gen_arr_set_parallel(). All members can be 0 for defaults. */
+typedef struct {
+    /** Number of elements per chunk. 0 for JSON_GEN_PAR_CHUNK_SIZE */
+    size_t chunk_size;
+    /** Number of worker threads. 0 for the number of online CPUs */
+    int num_threads;
+    /** Maximum number of completed chunks waiting to be spliced. This bounds the
+     * memory used. 0 for twice the number of threads.
+     */
+    size_t max_pending;
+} json_gen_par_config_t;
+
+/** Add elements to an array in parallel
+ *
+ * The elements 0 to count - 1 are split into chunks, which are encoded by worker
+ * threads using the callback. The fragments are added to the array in order
+ * of the element indices, with the commas as required, and get flushed out through
+ * the buffer, callback or sink of the JSON string as usual. This returns after
+ * all the elements have been added.
+ *
+ * The fragments use the same float format, escaping and output format as the JSON
+ * string. MessagePack and pretty printed arrays are always generated on the calling thread.
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[in] count Number of array elements
+ * \param[in] cb Callback function to encode a chunk of elements
+ * \param[in] priv Private data to be passed to the callback
+ * \param[in] config Configuration. Can be NULL for defaults.
+ *
+ * \return 0 on Success
+ * \return -1 if a callback failed, a fragment could not be allocated or the threads
+ * could not be created. As the array may have been partially written, this is set
+ * as the error of the JSON string too, with json_gen_str_fail().
+ * \return Error of the JSON string, Eg. JSON_GEN_ERR_LIMIT, if adding a fragment failed
+ * \return JSON_GEN_AGAIN if the non blocking output of the JSON string stopped taking data
+ * at any point. All the elements have still been added.
+ */
+int json_gen_arr_set_parallel(json_gen_str_t *jstr, size_t count, json_gen_par_cb_t cb,
+        void *priv, const json_gen_par_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
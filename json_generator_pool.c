@@ -0,0 +1,188 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <json_generator_pool.h>
+
+typedef struct {
+	/* Must be the first member, so that the entry can be found from the JSON string */
+	json_gen_str_t jstr;
+	json_gen_growable_t gbuf;
+	/* Buffer retained across uses */
+	char *buf;
+	size_t cap;
+	/* Largest buffer needed since the last shrink */
+	size_t high_water;
+	uint32_t uses;
+	bool in_use;
+	bool heap;
+} json_gen_pool_entry_t;
+
+typedef struct {
+	json_gen_pool_entry_t entries[JSON_GEN_POOL_SIZE];
+} json_gen_pool_t;
+
+static __thread json_gen_pool_t *json_gen_pool;
+static pthread_key_t json_gen_pool_key;
+static pthread_once_t json_gen_pool_once = PTHREAD_ONCE_INIT;
+
+/* The growable buffer allocates through the entry, which just hands out the
+ * retained buffer if it is large enough. Freeing is deferred to the shrinking.
+ */
+static void *json_gen_pool_realloc(void *ptr, size_t size, void *ctx)
+{
+	json_gen_pool_entry_t *entry = (json_gen_pool_entry_t *)ctx;
+	if (size <= entry->cap) {
+		return entry->buf;
+	}
+	char *buf = realloc(entry->buf, size);
+	if (!buf) {
+		return NULL;
+	}
+	entry->buf = buf;
+	entry->cap = size;
+	return buf;
+}
+
+static void json_gen_pool_free(void *ptr, void *ctx)
+{
+}
+
+static void json_gen_pool_free_entry(json_gen_pool_entry_t *entry)
+{
+	free(entry->buf);
+	entry->buf = NULL;
+	entry->cap = 0;
+	entry->high_water = 0;
+	entry->uses = 0;
+}
+
+static void json_gen_pool_destroy(void *arg)
+{
+	json_gen_pool_t *pool = (json_gen_pool_t *)arg;
+	for (int i = 0; i < JSON_GEN_POOL_SIZE; i++) {
+		json_gen_pool_free_entry(&pool->entries[i]);
+	}
+	free(pool);
+}
+
+static void json_gen_pool_init_key(void)
+{
+	pthread_key_create(&json_gen_pool_key, json_gen_pool_destroy);
+}
+
+static json_gen_pool_t *json_gen_pool_get(void)
+{
+	if (!json_gen_pool) {
+		pthread_once(&json_gen_pool_once, json_gen_pool_init_key);
+		json_gen_pool_t *pool = calloc(1, sizeof(json_gen_pool_t));
+		if (!pool) {
+			return NULL;
+		}
+		/* Only for freeing the pool when the thread exits */
+		pthread_setspecific(json_gen_pool_key, pool);
+		json_gen_pool = pool;
+	}
+	return json_gen_pool;
+}
+
+json_gen_str_t *json_gen_pool_acquire(void)
+{
+	json_gen_pool_t *pool = json_gen_pool_get();
+	if (!pool) {
+		return NULL;
+	}
+	json_gen_pool_entry_t *entry = NULL;
+	for (int i = 0; i < JSON_GEN_POOL_SIZE; i++) {
+		if (!pool->entries[i].in_use) {
+			entry = &pool->entries[i];
+			break;
+		}
+	}
+	if (!entry) {
+		entry = calloc(1, sizeof(json_gen_pool_entry_t));
+		if (!entry) {
+			return NULL;
+		}
+		entry->heap = true;
+	}
+	json_gen_allocator_t alloc = {
+		json_gen_pool_realloc,
+		json_gen_pool_free,
+		entry,
+	};
+	size_t size = entry->cap > JSON_GEN_POOL_BUF_SIZE ? entry->cap : JSON_GEN_POOL_BUF_SIZE;
+	if (json_gen_str_start_growable(&entry->jstr, &entry->gbuf, size, &alloc) != 0) {
+		if (entry->heap) {
+			json_gen_pool_free_entry(entry);
+			free(entry);
+		}
+		return NULL;
+	}
+	entry->in_use = true;
+	return &entry->jstr;
+}
+
+char *json_gen_pool_end(json_gen_str_t *jstr, size_t *len)
+{
+	return json_gen_str_end_growable(jstr, len);
+}
+
+void json_gen_pool_release(json_gen_str_t *jstr)
+{
+	json_gen_pool_entry_t *entry = (json_gen_pool_entry_t *)jstr;
+	if (entry->jstr.sink) {
+		json_gen_str_end_growable(jstr, NULL);
+	}
+	entry->in_use = false;
+	if (entry->heap) {
+		json_gen_pool_free_entry(entry);
+		free(entry);
+		return;
+	}
+	if (entry->gbuf.len + 1 > entry->high_water) {
+		entry->high_water = entry->gbuf.len + 1;
+	}
+	if (++entry->uses < JSON_GEN_POOL_SHRINK_INTERVAL) {
+		return;
+	}
+	size_t target = entry->high_water > JSON_GEN_POOL_BUF_SIZE ?
+			entry->high_water : JSON_GEN_POOL_BUF_SIZE;
+	if (entry->cap > 2 * target) {
+		char *buf = realloc(entry->buf, target);
+		if (buf) {
+			entry->buf = buf;
+			entry->cap = target;
+		}
+	}
+	entry->high_water = 0;
+	entry->uses = 0;
+}
+
+void json_gen_pool_trim(void)
+{
+	if (!json_gen_pool) {
+		return;
+	}
+	for (int i = 0; i < JSON_GEN_POOL_SIZE; i++) {
+		if (!json_gen_pool->entries[i].in_use) {
+			json_gen_pool_free_entry(&json_gen_pool->entries[i]);
+		}
+	}
+}
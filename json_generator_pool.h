@@ -0,0 +1,101 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * JSON String Generator - Generator pool
+ *
+ * This module keeps a small pool of JSON strings per thread, each with a
+ * growable buffer that is retained across uses. Once the buffers have grown
+ * to the typical size of the output, generating a JSON string needs no memory
+ * allocation at all. Buffers much larger than what has been needed recently
+ * are shrunk back.
+ * This requires POSIX threads and is optional. The core JSON generator does
+ * not depend on it.
+ *
+ */
+#ifndef _JSON_GENERATOR_POOL_H
+#define _JSON_GENERATOR_POOL_H
+
+#include <json_generator.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Number of pooled JSON strings per thread. More can be acquired, but those are
+ * allocated and freed on every use.
+ */
+#ifndef JSON_GEN_POOL_SIZE
+#define JSON_GEN_POOL_SIZE 4
+#endif
+
+/** Initial, and minimum, size of the pooled buffers */
+#ifndef JSON_GEN_POOL_BUF_SIZE
+#define JSON_GEN_POOL_BUF_SIZE 4096
+#endif
+
+/** Number of uses of a pooled buffer after which it is shrunk, if it is more than
+ * twice the largest output generated in that period.
+ */
+#ifndef JSON_GEN_POOL_SHRINK_INTERVAL
+#define JSON_GEN_POOL_SHRINK_INTERVAL 256
+#endif
+
+/** Acquire a JSON string from the pool of the calling thread
+ *
+ * The JSON string is already started, in a growable buffer, and can be used with all
+ * the APIs, just like one started with json_gen_str_start_growable().
+ * It should be ended with json_gen_pool_end() and must then be given back with
+ * json_gen_pool_release(), on the same thread.
+ *
+ * \return Pointer to the JSON string on Success
+ * \return NULL if memory allocation failed
+ */
+json_gen_str_t *json_gen_pool_acquire(void);
+
+/** End a pooled JSON string
+ *
+ * This is the same as json_gen_str_end_growable(), except that the buffer still
+ * belongs to the pool.
+ *
+ * \param[in] jstr Pointer to the JSON string returned by json_gen_pool_acquire()
+ * \param[out] len Length of the JSON string, excluding the NULL termination. Can be NULL.
+ *
+ * \return Pointer to the NULL terminated JSON string on Success. It is valid till
+ * json_gen_pool_release().
+ * \return NULL if memory allocation failed at any point or the size limit was reached
+ */
+char *json_gen_pool_end(json_gen_str_t *jstr, size_t *len);
+
+/** Give a JSON string back to the pool
+ *
+ * The JSON string is ended if that has not been done yet.
+ *
+ * \param[in] jstr Pointer to the JSON string returned by json_gen_pool_acquire()
+ */
+void json_gen_pool_release(json_gen_str_t *jstr);
+
+/** Free the buffers of all the unused JSON strings in the pool of the calling thread
+ *
+ * This is done automatically when a thread exits.
+ */
+void json_gen_pool_trim(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
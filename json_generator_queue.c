@@ -0,0 +1,191 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#include <json_generator_pool.h>
+#include <json_generator_queue.h>
+
+/* A bounded ring as per Dmitry Vyukov's MPMC queue. The sequence number of a slot
+ * tells whether it is free for the producer at a position (seq == pos) or holds
+ * the record for the consumer (seq == pos + 1). Producers claim a position with a
+ * compare and swap on the head, so they never take a lock.
+ */
+typedef struct {
+	atomic_size_t seq;
+	/* Owned by the producer which claimed the slot, till the record is published,
+	 * and then by the consumer, till the slot is freed
+	 */
+	char *buf;
+	size_t cap;
+	size_t len;
+} json_gen_queue_slot_t;
+
+struct json_gen_queue {
+	json_gen_queue_slot_t *slots;
+	size_t mask;
+	json_gen_format_t format;
+	/* Kept apart, so that the producers and the consumer do not share a cache line */
+	_Alignas(64) atomic_size_t head;
+	_Alignas(64) size_t tail;
+};
+
+json_gen_queue_t *json_gen_queue_create(const json_gen_queue_config_t *config)
+{
+	size_t capacity = config && config->capacity ? config->capacity : JSON_GEN_QUEUE_CAPACITY;
+	json_gen_format_t format = config ? config->format : JSON_GEN_FORMAT_JSON;
+	/* MessagePack records cannot be spliced, as the array header counts the elements */
+	if (format != JSON_GEN_FORMAT_JSON && format != JSON_GEN_FORMAT_CBOR) {
+		return NULL;
+	}
+	size_t size = 2;
+	while (size < capacity) {
+		size <<= 1;
+	}
+	json_gen_queue_t *queue = aligned_alloc(64, sizeof(json_gen_queue_t));
+	if (!queue) {
+		return NULL;
+	}
+	memset(queue, 0, sizeof(json_gen_queue_t));
+	queue->slots = calloc(size, sizeof(json_gen_queue_slot_t));
+	if (!queue->slots) {
+		free(queue);
+		return NULL;
+	}
+	for (size_t i = 0; i < size; i++) {
+		atomic_init(&queue->slots[i].seq, i);
+	}
+	queue->mask = size - 1;
+	queue->format = format;
+	atomic_init(&queue->head, 0);
+	return queue;
+}
+
+void json_gen_queue_destroy(json_gen_queue_t *queue)
+{
+	if (!queue) {
+		return;
+	}
+	for (size_t i = 0; i <= queue->mask; i++) {
+		free(queue->slots[i].buf);
+	}
+	free(queue->slots);
+	free(queue);
+}
+
+json_gen_str_t *json_gen_queue_record_start(json_gen_queue_t *queue)
+{
+	json_gen_str_t *jstr = json_gen_pool_acquire();
+	if (jstr && json_gen_str_set_format(jstr, queue->format) != 0) {
+		json_gen_pool_release(jstr);
+		return NULL;
+	}
+	return jstr;
+}
+
+/* Claim the next free slot, waiting while the ring is full */
+static json_gen_queue_slot_t *json_gen_queue_claim(json_gen_queue_t *queue, size_t *pos)
+{
+	size_t cur = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	while (1) {
+		json_gen_queue_slot_t *slot = &queue->slots[cur & queue->mask];
+		size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)cur;
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&queue->head, &cur, cur + 1,
+						memory_order_relaxed, memory_order_relaxed)) {
+				*pos = cur;
+				return slot;
+			}
+			/* cur has been updated to the latest head */
+		} else if (diff < 0) {
+			/* Full. The slot still holds the record from one round earlier */
+			sched_yield();
+			cur = atomic_load_explicit(&queue->head, memory_order_relaxed);
+		} else {
+			cur = atomic_load_explicit(&queue->head, memory_order_relaxed);
+		}
+	}
+}
+
+int json_gen_queue_push(json_gen_queue_t *queue, json_gen_str_t *jstr)
+{
+	size_t len;
+	char *data = json_gen_pool_end(jstr, &len);
+	if (!data) {
+		json_gen_pool_release(jstr);
+		return -1;
+	}
+	size_t pos;
+	json_gen_queue_slot_t *slot = json_gen_queue_claim(queue, &pos);
+	int ret = 0;
+	if (len > slot->cap) {
+		char *buf = realloc(slot->buf, len);
+		if (buf) {
+			slot->buf = buf;
+			slot->cap = len;
+		} else {
+			/* The position has been claimed, so it is published as an empty record,
+			 * which the consumer skips
+			 */
+			len = 0;
+			ret = -1;
+		}
+	}
+	if (len) {
+		memcpy(slot->buf, data, len);
+	}
+	slot->len = len;
+	json_gen_pool_release(jstr);
+	atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+	return ret;
+}
+
+int json_gen_queue_drain(json_gen_queue_t *queue, json_gen_str_t *jstr, size_t *count)
+{
+	size_t spliced = 0;
+	int ret = 0;
+	/* Records in another format would corrupt the output */
+	if (jstr->format != queue->format) {
+		ret = -1;
+	}
+	while (ret == 0) {
+		json_gen_queue_slot_t *slot = &queue->slots[queue->tail & queue->mask];
+		size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		if (seq != queue->tail + 1) {
+			break;
+		}
+		if (slot->len) {
+			ret = json_gen_arr_push_raw(jstr, slot->buf, slot->len);
+			/* Backpressure of a non blocking output stops the draining, after the record */
+			spliced += ret == 0 || ret == JSON_GEN_AGAIN;
+		}
+		/* Free for the producer one round later */
+		atomic_store_explicit(&slot->seq, queue->tail + queue->mask + 1, memory_order_release);
+		queue->tail++;
+	}
+	if (count) {
+		*count = spliced;
+	}
+	/* Also when the queue was empty, but data is still waiting from before */
+	if (ret == 0 && json_gen_str_backlog(jstr)) {
+		ret = JSON_GEN_AGAIN;
+	}
+	return ret;
+}
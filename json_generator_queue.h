@@ -0,0 +1,135 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * JSON String Generator - Record queue
+ *
+ * This module lets multiple threads add records to a single JSON array. Each
+ * producer thread encodes its records into fragments of its own, from the
+ * generator pool of the thread, and pushes them onto a lock-free ring. A single
+ * consumer thread splices the records into the JSON string, which gets flushed
+ * out as usual. The producers never touch the JSON string or wait for each other,
+ * except when the ring is full.
+ * This requires C11 atomics and POSIX threads and is optional. The core JSON
+ * generator does not depend on it.
+ *
+ */
+#ifndef _JSON_GENERATOR_QUEUE_H
+#define _JSON_GENERATOR_QUEUE_H
+
+#include <json_generator.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Default number of slots in the ring */
+#ifndef JSON_GEN_QUEUE_CAPACITY
+#define JSON_GEN_QUEUE_CAPACITY 256
+#endif
+
+/** Record queue. The members are internal. */
+typedef struct json_gen_queue json_gen_queue_t;
+
+/** Configuration for json_gen_queue_create(). All members can be 0 for defaults. */
+typedef struct {
+    /** Number of records which can be pending. Rounded up to a power of 2.
+     * 0 for JSON_GEN_QUEUE_CAPACITY
+     */
+    size_t capacity;
+    /** Format of the records, which should be that of the JSON string they are drained
+     * into. 0 for JSON. The MessagePack format is not supported.
+     */
+    json_gen_format_t format;
+} json_gen_queue_config_t;
+
+/** Create a record queue
+ *
+ * \param[in] config Configuration. Can be NULL for defaults.
+ *
+ * \return Pointer to the queue on Success
+ * \return NULL if memory allocation failed, or the format is not supported
+ */
+json_gen_queue_t *json_gen_queue_create(const json_gen_queue_config_t *config);
+
+/** Destroy a record queue
+ *
+ * Records which have not been drained yet are dropped. No producer or consumer
+ * should be using the queue any more.
+ *
+ * \param[in] queue Pointer to the queue returned by json_gen_queue_create()
+ */
+void json_gen_queue_destroy(json_gen_queue_t *queue);
+
+/** Start a record on a producer thread
+ *
+ * This returns a JSON string from the generator pool of the calling thread, to
+ * which exactly one value, Eg. an object started with json_gen_start_object(),
+ * should be added. It is already set to the format of the queue. Options like
+ * json_gen_str_set_escape() can be set before adding the value.
+ * The record must then be pushed with json_gen_queue_push(), on the same thread.
+ *
+ * \param[in] queue Pointer to the queue returned by json_gen_queue_create()
+ *
+ * \return Pointer to the JSON string for the record on Success
+ * \return NULL if memory allocation failed
+ */
+json_gen_str_t *json_gen_queue_record_start(json_gen_queue_t *queue);
+
+/** Push a record onto the queue
+ *
+ * The record is ended and copied into a slot of the ring, and the JSON string
+ * goes back to the pool. If the ring is full, this waits for the consumer to
+ * drain some records.
+ *
+ * \param[in] queue Pointer to the queue returned by json_gen_queue_create()
+ * \param[in] jstr Pointer to the JSON string returned by json_gen_queue_record_start()
+ *
+ * \return 0 on Success
+ * \return -1 if the record could not be generated or copied. Nothing is pushed then.
+ */
+int json_gen_queue_push(json_gen_queue_t *queue, json_gen_str_t *jstr);
+
+/** Splice the pending records into a JSON array
+ *
+ * This adds all the records pushed so far to the array, in the order in which
+ * they were pushed, with the commas as required. Only a single thread may drain
+ * a queue, and it alone should use the JSON string. The records are added as is,
+ * so the JSON string should not be pretty printed, and should be in the format of
+ * the queue.
+ *
+ * \note This must be called between json_gen_start_array()/json_gen_push_array()
+ * and json_gen_end_array()/json_gen_pop_array()
+ *
+ * \param[in] queue Pointer to the queue returned by json_gen_queue_create()
+ * \param[in] jstr Pointer to the \ref json_gen_str_t structure initialised by
+ * json_gen_str_start()
+ * \param[out] count Number of records added. Can be NULL.
+ *
+ * \return 0 on Success, including if there were no records
+ * \return -1 if the JSON string is not in the format of the queue. Nothing is added then.
+ * \return JSON_GEN_AGAIN if the non blocking output of the JSON string stopped taking data.
+ * The records up to that point have been added and the rest are left in the queue.
+ * \return Error of the JSON string, Eg. JSON_GEN_ERR_LIMIT, if adding a record failed.
+ * That record is dropped.
+ */
+int json_gen_queue_drain(json_gen_queue_t *queue, json_gen_str_t *jstr, size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -16,7 +16,18 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 #include <json_generator.h>
+#include <json_generator_io.h>
+#include <json_generator_par.h>
+#include <json_generator_pool.h>
+#include <json_generator_compress.h>
+#include <json_generator_queue.h>
 
 static const char expected_str[] = "{\"first_bool\":true,\"first_int\":30,"\
         "\"first_int64\":-102030405060708090,\"float_val\":54.16430,"\
@@ -25,7 +36,7 @@ static const char expected_str[] = "{\"first_bool\":true,\"first_int\":30,"\
         "}]],\"my_obj\":{\"only_val\":5}}";
 
 typedef struct {
-    char buf[256];
+    char buf[512];
     size_t offset;
 } json_gen_test_result_t;
 
@@ -41,6 +52,18 @@ static void flush_str(char *buf, void *priv)
         result->offset += strlen(buf);
     }
 }
+static int flush_str_v2(const char *buf, size_t len, void *priv)
+{
+    json_gen_test_result_t *result = (json_gen_test_result_t *)priv;
+    if (len >= sizeof(result->buf) - result->offset) {
+        printf("Result Buffer too small\r\n");
+        return -1;
+    }
+    memcpy(result->buf + result->offset, buf, len);
+    result->offset += len;
+    return 0;
+}
+
 /* Creating JSON
 {
     "first_bool": true,
@@ -98,17 +121,1624 @@ static int json_gen_perform_test(json_gen_test_result_t *result, const char *exp
     }
 }
 
-int main(int argc, char **argv)
+static const char expected_len_str[] = "{\"view\":\"abc\",\"n\":7,\"list\":[\"de\",true,\"\"],"\
+        "\"none\":\"\",\"none_k\":\"\",\"raw\":{\"a\":1}}";
+
+/* Same as above, but using the explicit length APIs with inputs which are
+ * not NULL terminated
+ */
+static int json_gen_perform_len_test(json_gen_test_result_t *result, const char *expected)
 {
-    json_gen_test_result_t result;
-	printf("Creating JSON string [may require Line wrap enabled on console]\r\n");
-    int ret = json_gen_perform_test(&result, expected_str);
-    printf("Expected: %s\r\n", expected_str);
-	printf("Generated: %s\r\n", result.buf);
+	char buf[20];
+	const char names[] = "view|n|list|raw";
+	const char vals[] = "abcdef{\"a\":1}";
+	static const json_gen_key_t key_none = JSON_GEN_KEY("none_k");
+    memset(result, 0, sizeof(json_gen_test_result_t));
+	json_gen_str_t jstr;
+	json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+	json_gen_start_object(&jstr);
+	json_gen_obj_set_string_n(&jstr, names, 4, vals, 3);
+	json_gen_obj_set_int_n(&jstr, names + 5, 1, 7);
+	json_gen_push_array_n(&jstr, names + 7, 4);
+	json_gen_arr_set_string_n(&jstr, vals + 3, 2);
+	json_gen_arr_set_bool(&jstr, true);
+	/* NULL strings are added as empty strings */
+	json_gen_arr_set_string(&jstr, NULL);
+	json_gen_pop_array(&jstr);
+	json_gen_obj_set_string(&jstr, "none", NULL);
+	json_gen_obj_set_string_k(&jstr, &key_none, NULL);
+	json_gen_push_object_str_n(&jstr, names + 12, 3, vals + 6, 7);
+	json_gen_end_object(&jstr);
+	json_gen_str_end(&jstr);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_key_str[] = "{\"id\":12,\"ok\":false,\"temp\":25.5,"\
+        "\"name\":\"probe\",\"loc\":{\"id\":3,\"name\":null},\"list\":[1]}";
+
+static int json_gen_perform_key_test(json_gen_test_result_t *result, const char *expected)
+{
+	char buf[20];
+	static const json_gen_key_t key_id = JSON_GEN_KEY("id");
+	static const json_gen_key_t key_name = JSON_GEN_KEY("name");
+	static const json_gen_key_t key_ok = JSON_GEN_KEY("ok");
+	static const json_gen_key_t key_temp = JSON_GEN_KEY("temp");
+	static const json_gen_key_t key_loc = JSON_GEN_KEY("loc");
+	static const json_gen_key_t key_list = JSON_GEN_KEY("list");
+    memset(result, 0, sizeof(json_gen_test_result_t));
+	json_gen_str_t jstr;
+	json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+	json_gen_start_object(&jstr);
+	json_gen_obj_set_int_k(&jstr, &key_id, 12);
+	json_gen_obj_set_bool_k(&jstr, &key_ok, false);
+	json_gen_obj_set_double_k(&jstr, &key_temp, 25.5);
+	json_gen_obj_set_string_k(&jstr, &key_name, "probe");
+	json_gen_push_object_k(&jstr, &key_loc);
+	json_gen_obj_set_uint32_k(&jstr, &key_id, 3);
+	json_gen_obj_set_null_k(&jstr, &key_name);
+	json_gen_pop_object(&jstr);
+	json_gen_push_array_k(&jstr, &key_list);
+	json_gen_arr_set_int(&jstr, 1);
+	json_gen_pop_array(&jstr);
+	json_gen_end_object(&jstr);
+	json_gen_str_end(&jstr);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+typedef struct {
+    double lat;
+    double lon;
+} test_loc_t;
+
+typedef struct test_node {
+    int32_t id;
+    bool active;
+    uint64_t serial;
+    float temp;
+    const char *name;
+    char tag[8];
+    test_loc_t loc;
+    int32_t readings[4];
+    size_t num_readings;
+    const struct test_node *children;
+    size_t num_children;
+} test_node_t;
+
+static const json_gen_field_t test_loc_fields[] = {
+    JSON_GEN_FIELD(JSON_GEN_FIELD_DOUBLE, test_loc_t, lat),
+    JSON_GEN_FIELD(JSON_GEN_FIELD_DOUBLE, test_loc_t, lon),
+};
+static json_gen_struct_desc_t test_loc_desc = JSON_GEN_STRUCT_DESC(test_loc_t, test_loc_fields);
+
+static json_gen_struct_desc_t test_node_desc;
+static const json_gen_field_t test_node_fields[] = {
+    JSON_GEN_FIELD(JSON_GEN_FIELD_INT32, test_node_t, id),
+    JSON_GEN_FIELD(JSON_GEN_FIELD_BOOL, test_node_t, active),
+    JSON_GEN_FIELD(JSON_GEN_FIELD_UINT64, test_node_t, serial),
+    JSON_GEN_FIELD(JSON_GEN_FIELD_FLOAT, test_node_t, temp),
+    JSON_GEN_FIELD(JSON_GEN_FIELD_STRING, test_node_t, name),
+    JSON_GEN_FIELD_CHARS_OF(test_node_t, tag),
+    JSON_GEN_FIELD_OBJECT_OF(test_node_t, loc, &test_loc_desc),
+    JSON_GEN_FIELD_INLINE_ARRAY_OF(test_node_t, readings, num_readings, JSON_GEN_FIELD_INT32, NULL),
+    JSON_GEN_FIELD_ARRAY_OF(test_node_t, children, num_children, JSON_GEN_FIELD_OBJECT, &test_node_desc),
+};
+static json_gen_struct_desc_t test_node_desc = JSON_GEN_STRUCT_DESC(test_node_t, test_node_fields);
+
+static const char expected_struct_str[] = "[{\"id\":1,\"active\":true,\"serial\":18446744073709551615,"\
+        "\"temp\":21.50000,\"name\":\"root\",\"tag\":\"abcdefgh\",\"loc\":{\"lat\":12.5,\"lon\":-7.25},"\
+        "\"readings\":[3,4],\"children\":[{\"id\":2,\"active\":false,\"serial\":0,\"temp\":0.00000,"\
+        "\"name\":null,\"tag\":\"x\",\"loc\":{\"lat\":0.0,\"lon\":0.0},\"readings\":[],\"children\":[]},"\
+        "{\"id\":3,\"active\":false,\"serial\":0,\"temp\":0.00000,\"name\":null,\"tag\":\"\","\
+        "\"loc\":{\"lat\":0.0,\"lon\":0.0},\"readings\":[1,2,3,4],\"children\":[]}]},"\
+        "{\"only\":{\"lat\":1.0,\"lon\":2.0}}]";
+
+static int json_gen_perform_struct_test(json_gen_test_result_t *result, const char *expected)
+{
+	char buf[40];
+	test_node_t children[2] = {
+		{.id = 2, .tag = "x"},
+		{.id = 3, .readings = {1, 2, 3, 4}, .num_readings = 9},
+	};
+	test_node_t root = {
+		.id = 1, .active = true, .serial = UINT64_MAX, .temp = 21.5f, .name = "root",
+		.tag = {'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h'}, .loc = {12.5, -7.25},
+		.readings = {3, 4}, .num_readings = 2, .children = children, .num_children = 2,
+	};
+	test_loc_t loc = {1, 2};
+	if (json_gen_struct_compile(&test_node_desc) != 0 ||
+			json_gen_struct_compile(&test_loc_desc) != 0) {
+		return -1;
+	}
+    memset(result, 0, sizeof(json_gen_test_result_t));
+	json_gen_str_t jstr;
+	json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+	json_gen_start_array(&jstr);
+	json_gen_encode_struct(&jstr, &test_node_desc, &root);
+	json_gen_start_object(&jstr);
+	json_gen_obj_set_struct(&jstr, "only", &test_loc_desc, &loc);
+	json_gen_end_object(&jstr);
+	json_gen_end_array(&jstr);
+	json_gen_str_end(&jstr);
+	json_gen_struct_free(&test_node_desc);
+	json_gen_struct_free(&test_loc_desc);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_int_str[] = "[0,9,10,99,100,-1,-2147483648,2147483647,"\
+        "-9223372036854775808,9223372036854775807,4294967295,4294967296,"\
+        "100000000,10000000000000000,18446744073709551615]";
+
+static int json_gen_perform_int_test(json_gen_test_result_t *result, const char *expected)
+{
+	/* Large enough for some numbers to be formatted in place */
+	char buf[64];
+    memset(result, 0, sizeof(json_gen_test_result_t));
+	json_gen_str_t jstr;
+	json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+	json_gen_start_array(&jstr);
+	json_gen_arr_set_int(&jstr, 0);
+	json_gen_arr_set_int(&jstr, 9);
+	json_gen_arr_set_int(&jstr, 10);
+	json_gen_arr_set_uint32(&jstr, 99);
+	json_gen_arr_set_uint32(&jstr, 100);
+	json_gen_arr_set_int(&jstr, -1);
+	json_gen_arr_set_int(&jstr, INT32_MIN);
+	json_gen_arr_set_int(&jstr, INT32_MAX);
+	json_gen_arr_set_int64(&jstr, INT64_MIN);
+	json_gen_arr_set_int64(&jstr, INT64_MAX);
+	json_gen_arr_set_uint32(&jstr, UINT32_MAX);
+	json_gen_arr_set_uint64(&jstr, 4294967296ULL);
+	json_gen_arr_set_uint64(&jstr, 100000000ULL);
+	json_gen_arr_set_uint64(&jstr, 10000000000000000ULL);
+	json_gen_arr_set_uint64(&jstr, UINT64_MAX);
+	json_gen_end_array(&jstr);
+	json_gen_str_end(&jstr);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_bulk_str[] = "[[1,-2,2147483647,-2147483648,0,1,-2,2147483647,"\
+        "-2147483648,0],[-9223372036854775807,18],[0.5,1e21,-3.25],[true,false,true],"\
+        "[\"ab\",null,\"\"],[7,8],[]]";
+
+static int json_gen_perform_bulk_test(json_gen_test_result_t *result, const char *expected)
+{
+	char buf[32];
+	static const int32_t ints[] = {1, -2, 2147483647, -2147483647 - 1, 0};
+	static const int64_t int64s[] = {-9223372036854775807LL, 18};
+	static const double doubles[] = {0.5, 1e21, -3.25};
+	static const bool bools[] = {true, false, true};
+	static const char *strs[] = {"ab", NULL, ""};
+    memset(result, 0, sizeof(json_gen_test_result_t));
+	json_gen_str_t jstr;
+	json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+	json_gen_start_array(&jstr);
+	json_gen_start_array(&jstr);
+	json_gen_arr_set_int_array(&jstr, ints, 5);
+	json_gen_arr_set_int_array(&jstr, ints, 5);
+	json_gen_end_array(&jstr);
+	json_gen_start_array(&jstr);
+	json_gen_arr_set_int64_array(&jstr, int64s, 2);
+	json_gen_end_array(&jstr);
+	json_gen_start_array(&jstr);
+	json_gen_arr_set_double_array(&jstr, doubles, 3);
+	json_gen_end_array(&jstr);
+	json_gen_start_array(&jstr);
+	json_gen_arr_set_bool_array(&jstr, bools, 3);
+	json_gen_end_array(&jstr);
+	json_gen_start_array(&jstr);
+	json_gen_arr_set_string_array(&jstr, strs, 3);
+	json_gen_end_array(&jstr);
+	json_gen_start_array(&jstr);
+	json_gen_arr_set_int(&jstr, 7);
+	json_gen_arr_set_int_array(&jstr, ints, 0);
+	json_gen_arr_set_int_array(&jstr, (const int32_t []){8}, 1);
+	json_gen_end_array(&jstr);
+	json_gen_start_array(&jstr);
+	json_gen_arr_set_double_array(&jstr, doubles, 0);
+	json_gen_end_array(&jstr);
+	json_gen_end_array(&jstr);
+	json_gen_str_end(&jstr);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_float_str[] = "[54.16430,0.1,1e21,-0.0,null,1.2345678901234568e17,"\
+        "45.12,0.001,3.14,2.50,1e20,9035.20312,-0.00000]";
+
+static int json_gen_perform_float_test(json_gen_test_result_t *result, const char *expected)
+{
+	char buf[20];
+    memset(result, 0, sizeof(json_gen_test_result_t));
+	json_gen_str_t jstr;
+	json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+	json_gen_start_array(&jstr);
+	json_gen_arr_set_float(&jstr, 54.1643);
+	json_gen_arr_set_double(&jstr, 0.1);
+	json_gen_arr_set_double(&jstr, 1e21);
+	json_gen_arr_set_double(&jstr, -0.0);
+	json_gen_arr_set_double(&jstr, NAN);
+	json_gen_arr_set_double(&jstr, 123456789012345678.0);
+	json_gen_str_set_float_format(&jstr, JSON_GEN_FLOAT_FMT_SHORTEST, 0);
+	json_gen_arr_set_float(&jstr, 45.12);
+	json_gen_arr_set_float(&jstr, 0.001);
+	json_gen_str_set_float_format(&jstr, JSON_GEN_FLOAT_FMT_FIXED, 2);
+	json_gen_arr_set_double(&jstr, 3.14159);
+	json_gen_arr_set_float(&jstr, 2.5);
+	/* Out of the fixed point range, in the shortest form of a float */
+	json_gen_arr_set_float(&jstr, 1e20f);
+	/* Rounded like printf(), with exact ties to even and the sign kept for -0 */
+	json_gen_str_set_float_format(&jstr, JSON_GEN_FLOAT_FMT_FIXED, 5);
+	json_gen_arr_set_float(&jstr, 9035.203125f);
+	json_gen_arr_set_float(&jstr, -1e-8f);
+	json_gen_end_array(&jstr);
+	json_gen_str_end(&jstr);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_escape_str[] = "{\"say \\\"hi\\\"\":\"line1\\nline2\\ttab\","\
+        "\"ctrl\":\"\\u0001\\\\end\",\"long\":\"part \\\"one\\\", part two\\r\","\
+        "\"raw\":\"pre\\\"escaped\"}";
+
+static int json_gen_perform_escape_test(json_gen_test_result_t *result, const char *expected)
+{
+	char buf[20];
+    memset(result, 0, sizeof(json_gen_test_result_t));
+	json_gen_str_t jstr;
+	json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+	json_gen_str_set_escape(&jstr, true);
+	json_gen_start_object(&jstr);
+	json_gen_obj_set_string(&jstr, "say \"hi\"", "line1\nline2\ttab");
+	json_gen_obj_set_string(&jstr, "ctrl", "\x01\\end");
+	json_gen_obj_start_long_string(&jstr, "long", "part \"one\"");
+	json_gen_add_to_long_string(&jstr, ", part two\r");
+	json_gen_end_long_string(&jstr);
+	/* Already escaped strings can take the raw path */
+	json_gen_str_set_escape(&jstr, false);
+	json_gen_obj_set_string(&jstr, "raw", "pre\\\"escaped");
+	json_gen_end_object(&jstr);
+	json_gen_str_end(&jstr);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_reserve_str[] = "{\"custom\":0x2a,\"list\":[\"in place\",7]}";
+
+static int json_gen_perform_reserve_test(json_gen_test_result_t *result, const char *expected)
+{
+	char buf[20];
+    memset(result, 0, sizeof(json_gen_test_result_t));
+	json_gen_str_t jstr;
+	json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+	json_gen_start_object(&jstr);
+	json_gen_obj_start_value(&jstr, "custom");
+	char *p = json_gen_reserve(&jstr, 4);
+	if (!p) {
+		return -1;
+	}
+	memcpy(p, "0x2a", 4);
+	json_gen_commit(&jstr, 4);
+	json_gen_push_array(&jstr, "list");
+	json_gen_arr_start_value(&jstr);
+	p = json_gen_reserve(&jstr, 16);
+	if (!p) {
+		return -1;
+	}
+	json_gen_commit(&jstr, sprintf(p, "\"in place\""));
+	json_gen_arr_set_int(&jstr, 7);
+	json_gen_pop_array(&jstr);
+	json_gen_end_object(&jstr);
+	json_gen_str_end(&jstr);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+/* Generates a part of the main test JSON, to check the other kinds of outputs */
+static void json_gen_add_partial(json_gen_str_t *jstr)
+{
+	json_gen_start_object(jstr);
+	json_gen_obj_set_bool(jstr, "first_bool", true);
+	json_gen_obj_set_int(jstr, "first_int", 30);
+	json_gen_obj_set_int64(jstr, "first_int64", -102030405060708090);
+	json_gen_obj_set_string(jstr, "my_str", "new_name");
+	json_gen_end_object(jstr);
+}
+
+static const char expected_partial_str[] = "{\"first_bool\":true,\"first_int\":30,"\
+        "\"first_int64\":-102030405060708090,\"my_str\":\"new_name\"}";
+
+static int json_gen_perform_v2_test(json_gen_test_result_t *result, const char *expected)
+{
+	char buf[16];
+    memset(result, 0, sizeof(json_gen_test_result_t));
+	json_gen_str_t jstr;
+	json_gen_str_start_v2(&jstr, buf, sizeof(buf), flush_str_v2, result);
+	json_gen_add_partial(&jstr);
+	json_gen_str_end(&jstr);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+/* Simulates asynchronous writes, which complete in order only when waited upon */
+typedef struct {
+    json_gen_test_result_t *result;
+    json_gen_double_buf_t dbuf;
+    const char *pending_buf[3];
+    size_t pending_len[3];
+    int num_pending;
+} json_gen_async_writer_t;
+
+static int async_write_start(const char *buf, size_t len, void *priv)
+{
+    json_gen_async_writer_t *writer = (json_gen_async_writer_t *)priv;
+    writer->pending_buf[writer->num_pending] = buf;
+    writer->pending_len[writer->num_pending] = len;
+    writer->num_pending++;
+    return 0;
+}
+
+static int async_write_wait(void *priv)
+{
+    json_gen_async_writer_t *writer = (json_gen_async_writer_t *)priv;
+    if (writer->num_pending == 0) {
+        return -1;
+    }
+    flush_str_v2(writer->pending_buf[0], writer->pending_len[0], writer->result);
+    json_gen_double_buf_release(&writer->dbuf, writer->pending_buf[0]);
+    writer->num_pending--;
+    memmove(&writer->pending_buf[0], &writer->pending_buf[1],
+            writer->num_pending * sizeof(writer->pending_buf[0]));
+    memmove(&writer->pending_len[0], &writer->pending_len[1],
+            writer->num_pending * sizeof(writer->pending_len[0]));
+    return 0;
+}
+
+static int json_gen_perform_double_buf_test(json_gen_test_result_t *result, const char *expected)
+{
+	char buf_a[16], buf_b[16];
+	json_gen_async_writer_t writer = {result};
+    memset(result, 0, sizeof(json_gen_test_result_t));
+	json_gen_str_t jstr;
+	if (json_gen_str_start_double_buf(&jstr, &writer.dbuf, buf_a, buf_b, sizeof(buf_a),
+				async_write_start, async_write_wait, &writer) != 0) {
+		return -1;
+	}
+	json_gen_add_partial(&jstr);
+	json_gen_str_end(&jstr);
+    if (strcmp(expected, result->buf) == 0 && writer.num_pending == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static int json_gen_read_back(FILE *file, json_gen_test_result_t *result)
+{
+    rewind(file);
+    result->offset = fread(result->buf, 1, sizeof(result->buf) - 1, file);
+    result->buf[result->offset] = '\0';
+    return ferror(file) ? -1 : 0;
+}
+
+static int json_gen_perform_io_test(json_gen_test_result_t *result, const char *expected)
+{
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_t jstr;
+    json_gen_io_sink_t sink;
+    FILE *file = tmpfile();
+    if (!file) {
+        return -1;
+    }
+    /* File descriptor output, with a small buffer to force multiple writes */
+    if (json_gen_str_start_fd(&jstr, &sink, fileno(file), 24) != 0) {
+        fclose(file);
+        return -1;
+    }
+    json_gen_add_partial(&jstr);
+    int ret = json_gen_str_end(&jstr) > 0 ? 0 : -1;
+    /* FILE stream output, appended to the same file */
+    fseek(file, 0, SEEK_END);
+    if (ret == 0 && json_gen_str_start_file(&jstr, &sink, file, 0) == 0) {
+        json_gen_add_partial(&jstr);
+        ret = json_gen_str_end(&jstr) > 0 ? 0 : -1;
+        fflush(file);
+    }
+    if (ret == 0) {
+        ret = json_gen_read_back(file, result);
+    }
+    fclose(file);
+    /* Write failures should be reported by json_gen_str_end() */
+    if (ret == 0 && json_gen_str_start_fd(&jstr, &sink, -1, 0) == 0) {
+        json_gen_add_partial(&jstr);
+        if (json_gen_str_end(&jstr) != -1 || sink.err == 0) {
+            ret = -1;
+        }
+    }
+    if (ret == 0 && strncmp(expected, result->buf, strlen(expected)) == 0 &&
+            strcmp(expected, result->buf + strlen(expected)) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static void json_gen_add_mmap_records(json_gen_str_t *jstr)
+{
+    for (int i = 0; i < 400; i++) {
+        json_gen_record_begin(jstr);
+        json_gen_start_object(jstr);
+        json_gen_obj_set_int(jstr, "id", i);
+        json_gen_obj_set_string(jstr, "name", "record");
+        json_gen_end_object(jstr);
+        json_gen_record_end(jstr);
+    }
+}
+
+static int json_gen_perform_mmap_test(json_gen_test_result_t *result, const char *expected)
+{
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_t jstr;
+    json_gen_mmap_sink_t sink;
+    /* The smallest extent, so that the records span multiple windows and get carried over */
+    json_gen_mmap_config_t config = { .extent = 1, .sync = true, .advise = true };
+    FILE *file = tmpfile();
+    if (!file) {
+        return -1;
+    }
+    int ret = json_gen_str_start_mmap(&jstr, &sink, fileno(file), &config);
     if (ret == 0) {
-        printf("Test Passed!\r\n");
+        json_gen_str_set_record_aligned(&jstr, true);
+        json_gen_add_mmap_records(&jstr);
+        int64_t len = json_gen_str_end(&jstr);
+        /* Compare with the same records generated in memory */
+        json_gen_growable_t gbuf;
+        size_t mem_len = 0;
+        char *mem = NULL;
+        if (json_gen_str_start_growable(&jstr, &gbuf, 0, NULL) == 0) {
+            json_gen_add_mmap_records(&jstr);
+            mem = json_gen_str_end_growable(&jstr, &mem_len);
+        }
+        char *data = mem ? malloc(mem_len) : NULL;
+        rewind(file);
+        if (len < 0 || !data || (size_t)len != mem_len + 1 || fread(data, 1, mem_len, file) != mem_len ||
+                fgetc(file) != EOF || memcmp(data, mem, mem_len) != 0) {
+            ret = -1;
+        }
+        free(data);
+        free(mem);
+    }
+    /* A short JSON string truncates the file, after the first window */
+    if (ret == 0 && json_gen_str_start_mmap(&jstr, &sink, fileno(file), NULL) == 0) {
+        json_gen_add_partial(&jstr);
+        ret = json_gen_str_end(&jstr) > 0 ? json_gen_read_back(file, result) : -1;
+    }
+    fclose(file);
+    if (ret == 0 && strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *ctx)
+{
+    (*(int *)ctx)++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ptr, void *ctx)
+{
+    free(ptr);
+}
+
+static int json_gen_perform_growable_test(json_gen_test_result_t *result, const char *expected)
+{
+    int num_allocs = 0;
+    json_gen_allocator_t alloc = {counting_realloc, counting_free, &num_allocs};
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_t jstr;
+    json_gen_growable_t gbuf;
+    if (json_gen_str_start_growable(&jstr, &gbuf, 8, &alloc) != 0) {
+        return -1;
+    }
+    json_gen_add_partial(&jstr);
+    size_t len;
+    char *str = json_gen_str_end_growable(&jstr, &len);
+    if (!str) {
+        return -1;
+    }
+    snprintf(result->buf, sizeof(result->buf), "%s", str);
+    free(str);
+    /* 8 -> 16 -> 32 -> 64 -> 128 */
+    if (strcmp(expected, result->buf) == 0 && len == strlen(expected) && num_allocs == 5) {
+        return 0;
     } else {
-        printf("Test Failed!\r\n");
+        return -1;
+    }
+}
+
+static const char expected_prepared_str[] = "[{\"type\":\"reading\",\"id\":-5,\"vals\":[25.5,true],"\
+        "\"unit\":\"C\",\"seq\":1},{\"type\":\"reading\",\"id\":null,\"vals\":[1e-7,false],"\
+        "\"unit\":\"\\\"F\\\"\",\"seq\":2},{\"doc\":{\"type\":\"reading\",\"id\":0,\"vals\":[0.0,false],"\
+        "\"unit\":\"{}\",\"seq\":3}}]";
+
+static int json_gen_perform_prepared_test(json_gen_test_result_t *result, const char *expected)
+{
+	char buf[24];
+	json_gen_str_t jstr;
+	json_gen_prepared_t prep;
+	if (json_gen_prepare_start(&jstr, &prep) != 0) {
+		return -1;
+	}
+	json_gen_start_object(&jstr);
+	json_gen_obj_set_string(&jstr, "type", "reading");
+	json_gen_obj_set_slot(&jstr, "id", JSON_GEN_VALUE_INT64);
+	json_gen_push_array(&jstr, "vals");
+	json_gen_arr_set_slot(&jstr, JSON_GEN_VALUE_DOUBLE);
+	json_gen_arr_set_slot(&jstr, JSON_GEN_VALUE_BOOL);
+	json_gen_pop_array(&jstr);
+	json_gen_obj_set_slot(&jstr, "unit", JSON_GEN_VALUE_STRING);
+	if (json_gen_obj_set_slot(&jstr, "seq", JSON_GEN_VALUE_UINT64) != 4) {
+		return -1;
+	}
+	json_gen_end_object(&jstr);
+	if (json_gen_prepare_end(&jstr) != 0) {
+		return -1;
+	}
+
+	json_gen_value_t vals[5] = {
+		{JSON_GEN_VALUE_INT64, {.i64 = -5}},
+		{JSON_GEN_VALUE_DOUBLE, {.d = 25.5}},
+		{JSON_GEN_VALUE_BOOL, {.b = true}},
+		{JSON_GEN_VALUE_STRING, {.str = {"C", 1}}},
+		{JSON_GEN_VALUE_UINT64, {.u64 = 1}},
+	};
+    memset(result, 0, sizeof(json_gen_test_result_t));
+	json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+	json_gen_str_set_escape(&jstr, true);
+	json_gen_start_array(&jstr);
+	json_gen_render(&prep, vals, &jstr);
+	vals[0].type = JSON_GEN_VALUE_NULL;
+	vals[1].u.d = 1e-7;
+	vals[2].u.b = false;
+	vals[3].u.str.ptr = "\"F\"";
+	vals[3].u.str.len = 3;
+	vals[4].u.u64 = 2;
+	json_gen_render(&prep, vals, &jstr);
+	/* Mismatched types are rejected */
+	vals[4].type = JSON_GEN_VALUE_STRING;
+	if (json_gen_render(&prep, vals, &jstr) != -1) {
+		return -1;
+	}
+	json_gen_value_t others[5] = {
+		{JSON_GEN_VALUE_INT64, {.i64 = 0}},
+		{JSON_GEN_VALUE_DOUBLE, {.d = 0}},
+		{JSON_GEN_VALUE_BOOL, {.b = false}},
+		{JSON_GEN_VALUE_STRING, {.str = {"{}", 2}}},
+		{JSON_GEN_VALUE_UINT64, {.u64 = 3}},
+	};
+	json_gen_start_object(&jstr);
+	json_gen_str_set_escape(&jstr, false);
+	json_gen_obj_render(&prep, others, &jstr, "doc");
+	json_gen_end_object(&jstr);
+	json_gen_end_array(&jstr);
+	json_gen_str_end(&jstr);
+	json_gen_prepared_free(&prep);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_retained_str[] = "[{\"id\":7,\"temp\":25.5,\"ok\":true,\"unit\":\"C\"},"\
+        "{\"id\":7,\"temp\":-3.25,\"ok\":true,\"unit\":\"C\"},"\
+        "{\"state\":{\"id\":null,\"temp\":-3.25,\"ok\":false,\"unit\":\"\\\"F\\\"\"}}]";
+
+static int json_gen_perform_retained_test(json_gen_test_result_t *result, const char *expected)
+{
+    char buf[24];
+    json_gen_str_t jstr;
+    json_gen_prepared_t prep;
+    json_gen_retained_t doc;
+    if (json_gen_prepare_start(&jstr, &prep) != 0) {
+        return -1;
+    }
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_slot(&jstr, "id", JSON_GEN_VALUE_INT64);
+    json_gen_obj_set_slot(&jstr, "temp", JSON_GEN_VALUE_DOUBLE);
+    json_gen_obj_set_slot(&jstr, "ok", JSON_GEN_VALUE_BOOL);
+    json_gen_obj_set_slot(&jstr, "unit", JSON_GEN_VALUE_STRING);
+    json_gen_end_object(&jstr);
+    if (json_gen_prepare_end(&jstr) != 0) {
+        return -1;
+    }
+    json_gen_value_t vals[4] = {
+        {JSON_GEN_VALUE_INT64, {.i64 = 7}},
+        {JSON_GEN_VALUE_DOUBLE, {.d = 25.5}},
+        {JSON_GEN_VALUE_BOOL, {.b = true}},
+        {JSON_GEN_VALUE_STRING, {.str = {"C", 1}}},
+    };
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+    json_gen_str_set_escape(&jstr, true);
+    int ret = json_gen_retained_start(&doc, &prep, vals, &jstr);
+    json_gen_prepared_free(&prep);
+    if (ret != 0) {
+        return -1;
+    }
+    json_gen_start_array(&jstr);
+    json_gen_render_retained(&doc, &jstr);
+    /* Only the changed value is patched, moving the rest as it is longer */
+    vals[1].u.d = -3.25;
+    if (json_gen_retained_update(&doc, vals) != 1) {
+        return -1;
+    }
+    json_gen_render_retained(&doc, &jstr);
+    /* Mismatched types are rejected, leaving the text as is */
+    vals[0].type = JSON_GEN_VALUE_STRING;
+    if (json_gen_retained_update(&doc, vals) != -1) {
+        return -1;
+    }
+    vals[0].type = JSON_GEN_VALUE_NULL;
+    vals[2].u.b = false;
+    vals[3].u.str.ptr = "\"F\"";
+    vals[3].u.str.len = 3;
+    if (json_gen_retained_update(&doc, vals) != 3 || json_gen_retained_set(&doc, 1, &vals[1]) != 0) {
+        return -1;
+    }
+    json_gen_start_object(&jstr);
+    json_gen_obj_render_retained(&doc, &jstr, "state");
+    json_gen_end_object(&jstr);
+    json_gen_end_array(&jstr);
+    json_gen_str_end(&jstr);
+    json_gen_retained_free(&doc);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_raw_str[] = "[{\"a\":1},\"chunked string\",[0,1,2,3,4,5,6,7,8,9],"\
+        "{\"blob\":{\"x\":[10,20,30]}}]";
+
+static const char raw_blob[] = "[0,1,2,3,4,5,6,7,8,9]";
+static int raw_blob_direct;
+
+static int flush_raw(const char *buf, size_t len, void *priv)
+{
+    if (buf == raw_blob) {
+        raw_blob_direct++;
+    }
+    return flush_str_v2(buf, len, priv);
+}
+
+static int json_gen_perform_raw_test(json_gen_test_result_t *result, const char *expected)
+{
+    /* Deliberately not NULL terminated */
+    const char net_buf[] = {'{', '"', 'a', '"', ':', '1', '}', 'c', 'h', 'u', 'n', 'k', 'e', 'd'};
+    const char obj[] = "{\"x\":[10,20,30]}trailing";
+    char buf[16];
+    json_gen_str_t jstr;
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    raw_blob_direct = 0;
+    json_gen_str_start_v2(&jstr, buf, sizeof(buf), flush_raw, result);
+    json_gen_start_array(&jstr);
+    json_gen_arr_push_raw(&jstr, net_buf, 7);
+    json_gen_arr_start_long_string_n(&jstr, net_buf + 7, 3);
+    json_gen_add_to_long_string_n(&jstr, net_buf + 10, 4);
+    json_gen_add_to_long_string_n(&jstr, " string", 7);
+    json_gen_end_long_string(&jstr);
+    /* Larger than the buffer, so passed on without copying */
+    json_gen_arr_push_raw(&jstr, raw_blob, strlen(raw_blob));
+    json_gen_start_object(&jstr);
+    json_gen_push_object_str_n(&jstr, "blob", 4, obj, strlen(obj) - strlen("trailing"));
+    json_gen_end_object(&jstr);
+    json_gen_end_array(&jstr);
+    if (json_gen_str_end(&jstr) != (int64_t)strlen(expected) + 1 || raw_blob_direct != 1) {
+        return -1;
+    }
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_encoded_str[] = "{\"b64\":\"AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8gISIjJCUmJw==\","\
+        "\"b64_1\":\"/w==\",\"b64_2\":\"YWI=\",\"hex\":\"c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"\
+        "e0e1e2e3e4e5e6e7e8e9eaebecedeeef\",\"empty\":[\"\",\"\"]}";
+
+static int json_gen_perform_encoded_test(json_gen_test_result_t *result, const char *expected)
+{
+    uint8_t data[40], high[40];
+    for (int i = 0; i < 40; i++) {
+        data[i] = (uint8_t)i;
+        high[i] = (uint8_t)(200 + i);
+    }
+    /* Encoded in place in the larger buffer, and across the flushes in the smaller one */
+    char buf[256];
+    size_t sizes[] = {sizeof(buf), 16};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        json_gen_str_t jstr;
+        memset(result, 0, sizeof(json_gen_test_result_t));
+        json_gen_str_start_v2(&jstr, buf, sizes[i], flush_str_v2, result);
+        json_gen_start_object(&jstr);
+        json_gen_obj_set_base64(&jstr, "b64", data, sizeof(data));
+        json_gen_obj_set_base64(&jstr, "b64_1", "\xff", 1);
+        json_gen_obj_set_base64_n(&jstr, "b64_2|", 5, "ab", 2);
+        json_gen_obj_set_hex_n(&jstr, "hex|", 3, high, sizeof(high));
+        json_gen_push_array(&jstr, "empty");
+        json_gen_arr_set_base64(&jstr, NULL, 0);
+        json_gen_arr_set_hex(&jstr, NULL, 0);
+        json_gen_pop_array(&jstr);
+        json_gen_end_object(&jstr);
+        if (json_gen_str_end(&jstr) != (int64_t)strlen(expected) + 1 ||
+                strcmp(expected, result->buf) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static const char expected_map_str[] = "{\"a\":1,\"o\":{\"a\":2},\"k1\":\"v\\\"1\",\"k2\":[1,2],"\
+        "\"k3\":2.5,\"k\\n4\":null,\"k5\":true}";
+
+static int json_gen_perform_map_test(json_gen_test_result_t *result, const char *expected)
+{
+    static const json_gen_key_t key_k2 = JSON_GEN_KEY("k2");
+    const char *keys[] = {"k1", "k2", "a", "k3", "k\n4", "k1", "k5"};
+    json_gen_value_t vals[] = {
+        {JSON_GEN_VALUE_STRING, {.str = {"v\"1", 3}}},
+        {JSON_GEN_VALUE_RAW, {.str = {"[1,2]", 5}}},
+        {JSON_GEN_VALUE_INT64, {.i64 = 3}},
+        {JSON_GEN_VALUE_DOUBLE, {.d = 2.5}},
+        {JSON_GEN_VALUE_NULL, {.b = false}},
+        {JSON_GEN_VALUE_INT64, {.i64 = 4}},
+        {JSON_GEN_VALUE_BOOL, {.b = true}},
+    };
+    /* Written in place in the larger buffer, and through the regular path in the smaller one */
+    char buf[256];
+    size_t sizes[] = {sizeof(buf), 16};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        json_gen_str_t jstr;
+        memset(result, 0, sizeof(json_gen_test_result_t));
+        json_gen_str_start_v2(&jstr, buf, sizes[i], flush_str_v2, result);
+        json_gen_str_set_escape(&jstr, true);
+        if (json_gen_str_set_dup_keys(&jstr, JSON_GEN_DUP_KEYS_SKIP) != 0) {
+            return -1;
+        }
+        json_gen_start_object(&jstr);
+        json_gen_obj_set_int(&jstr, "a", 1);
+        json_gen_obj_set_int(&jstr, "a", 5);
+        /* The keys of a nested object are its own */
+        json_gen_push_object(&jstr, "o");
+        json_gen_obj_set_int(&jstr, "a", 2);
+        json_gen_pop_object(&jstr);
+        json_gen_obj_set_string(&jstr, "o", "dup");
+        json_gen_obj_set_map(&jstr, keys, NULL, vals, sizeof(keys) / sizeof(keys[0]));
+        json_gen_obj_set_int_k(&jstr, &key_k2, 6);
+        json_gen_end_object(&jstr);
+        if (json_gen_str_end(&jstr) != (int64_t)strlen(expected) + 1 ||
+                strcmp(expected, result->buf) != 0) {
+            return -1;
+        }
+    }
+    /* Enough keys to grow the table. The same keys are fine in sibling objects. */
+    char names[100][8], big[2048];
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, big, sizeof(big), NULL, NULL);
+    json_gen_str_set_dup_keys(&jstr, JSON_GEN_DUP_KEYS_REJECT);
+    json_gen_start_array(&jstr);
+    for (int pass = 0; pass < 2; pass++) {
+        json_gen_start_object(&jstr);
+        for (int i = 0; i < 100; i++) {
+            snprintf(names[i], sizeof(names[i]), "n%d", i);
+            if (json_gen_obj_set_int(&jstr, names[i], i) != 0) {
+                return -1;
+            }
+        }
+        json_gen_end_object(&jstr);
+    }
+    json_gen_end_array(&jstr);
+    if (json_gen_str_end(&jstr) <= 0) {
+        return -1;
+    }
+    json_gen_str_start(&jstr, big, sizeof(big), NULL, NULL);
+    json_gen_str_set_dup_keys(&jstr, JSON_GEN_DUP_KEYS_SKIP);
+    json_gen_start_object(&jstr);
+    for (int i = 0; i < 100; i++) {
+        json_gen_obj_set_int(&jstr, names[i], i);
+    }
+    /* Objects cannot be skipped, since their contents are added later */
+    if (json_gen_push_object(&jstr, "n50") != JSON_GEN_ERR_INVALID) {
+        return -1;
+    }
+    if (json_gen_str_end(&jstr) != JSON_GEN_ERR_INVALID) {
+        return -1;
+    }
+    /* The keys are copied, so the same buffer can be reused for all of them */
+    char reused[8];
+    json_gen_str_start(&jstr, big, sizeof(big), NULL, NULL);
+    json_gen_str_set_dup_keys(&jstr, JSON_GEN_DUP_KEYS_SKIP);
+    json_gen_start_object(&jstr);
+    for (int i = 0; i < 4; i++) {
+        snprintf(reused, sizeof(reused), "k%d", i % 2);
+        json_gen_obj_set_int(&jstr, reused, i);
+    }
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    return strcmp(big, "{\"k0\":0,\"k1\":1}") == 0 ? 0 : -1;
+}
+
+static const char expected_limit_str[] = "{\"first_bool\":true,\"first_int\":30,\"first";
+
+static int json_gen_perform_limit_test(json_gen_test_result_t *result, const char *expected)
+{
+    char buf[16];
+    json_gen_str_t jstr;
+    /* Exactly at the limit should succeed */
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start_v2(&jstr, buf, sizeof(buf), flush_str_v2, result);
+    json_gen_str_set_max_len(&jstr, strlen(expected_partial_str));
+    json_gen_add_partial(&jstr);
+    if (json_gen_str_end(&jstr) != (int64_t)strlen(expected_partial_str) + 1) {
+        return -1;
+    }
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start_v2(&jstr, buf, sizeof(buf), flush_str_v2, result);
+    json_gen_str_set_max_len(&jstr, 40);
+    json_gen_add_partial(&jstr);
+    if (json_gen_obj_set_int(&jstr, "more", 1) != JSON_GEN_ERR_LIMIT ||
+            json_gen_reserve(&jstr, 1) != NULL) {
+        return -1;
+    }
+    if (json_gen_str_end(&jstr) != JSON_GEN_ERR_LIMIT) {
+        return -1;
+    }
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+typedef struct {
+    const char *title;
+    int (*perform)(json_gen_test_result_t *result, const char *expected);
+    const char *expected;
+} json_gen_test_t;
+
+static const char expected_par_str[] = "[\"head\",0,3,6,9,12,15,18,21,24,27,30,33,36,39,"\
+        "42,45,48,51,54,57,\"tail\"]";
+
+/* Every third element is skipped, so some of the chunks are empty */
+static int json_gen_add_par_chunk(json_gen_str_t *jstr, size_t start, size_t end, void *priv)
+{
+    for (size_t i = start; i < end; i++) {
+        if (i % 3 == 0) {
+            json_gen_arr_set_int(jstr, (int)i);
+        }
+    }
+    return 0;
+}
+
+/* Fails a chunk in the middle, after the earlier ones may have been spliced */
+static int json_gen_fail_par_chunk(json_gen_str_t *jstr, size_t start, size_t end, void *priv)
+{
+    return start == 10 ? -1 : json_gen_add_par_chunk(jstr, start, end, priv);
+}
+
+static int json_gen_perform_par_test(json_gen_test_result_t *result, const char *expected)
+{
+    char buf[16];
+    json_gen_str_t jstr;
+    json_gen_par_config_t config = {
+        .chunk_size = 2,
+        .num_threads = 4,
+        .max_pending = 3,
+    };
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start_v2(&jstr, buf, sizeof(buf), flush_str_v2, result);
+    json_gen_start_array(&jstr);
+    json_gen_arr_set_string(&jstr, "head");
+    if (json_gen_arr_set_parallel(&jstr, 59, json_gen_add_par_chunk, NULL, &config) != 0) {
+        return -1;
+    }
+    json_gen_arr_set_string(&jstr, "tail");
+    json_gen_end_array(&jstr);
+    if (json_gen_str_end(&jstr) < 0) {
+        return -1;
+    }
+    /* A partially written array fails the JSON string */
+    json_gen_test_result_t failed;
+    memset(&failed, 0, sizeof(failed));
+    json_gen_str_start_v2(&jstr, buf, sizeof(buf), flush_str_v2, &failed);
+    json_gen_start_array(&jstr);
+    if (json_gen_arr_set_parallel(&jstr, 59, json_gen_fail_par_chunk, NULL, &config) != -1 ||
+            json_gen_arr_set_int(&jstr, 1) != -1 || json_gen_str_end(&jstr) != -1) {
+        return -1;
+    }
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static int json_gen_perform_pool_test(json_gen_test_result_t *result, const char *expected)
+{
+    char *prev = NULL;
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    /* The buffer should get reused */
+    for (int i = 0; i < 2; i++) {
+        json_gen_str_t *jstr = json_gen_pool_acquire();
+        if (!jstr) {
+            return -1;
+        }
+        json_gen_add_partial(jstr);
+        size_t len;
+        char *str = json_gen_pool_end(jstr, &len);
+        if (!str || len >= sizeof(result->buf) || (prev && str != prev)) {
+            json_gen_pool_release(jstr);
+            return -1;
+        }
+        memcpy(result->buf, str, len + 1);
+        prev = str;
+        json_gen_pool_release(jstr);
+    }
+    json_gen_pool_trim();
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static int json_gen_perform_compress_test(json_gen_test_result_t *result, const char *expected)
+{
+    json_gen_compress_config_t configs[] = {
+        { .format = JSON_GEN_COMPRESS_DEFLATE, .buf_size = 16 },
+        { .format = JSON_GEN_COMPRESS_GZIP, .buf_size = 16, .background = true },
+    };
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        json_gen_test_result_t compressed = {0};
+        json_gen_str_t jstr;
+        json_gen_compress_t comp;
+        if (json_gen_str_start_compressed(&jstr, &comp, &configs[i], flush_str_v2, &compressed) != 0) {
+            return -1;
+        }
+        json_gen_add_partial(&jstr);
+        if (json_gen_str_end(&jstr) != (int64_t)strlen(expected) + 1 ||
+                comp.out_len != compressed.offset) {
+            return -1;
+        }
+        memset(result, 0, sizeof(json_gen_test_result_t));
+        z_stream zs = {0};
+        /* Automatic detection of the zlib or gzip header */
+        if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+            return -1;
+        }
+        zs.next_in = (Bytef *)compressed.buf;
+        zs.avail_in = compressed.offset;
+        zs.next_out = (Bytef *)result->buf;
+        zs.avail_out = sizeof(result->buf) - 1;
+        int ret = inflate(&zs, Z_FINISH);
+        inflateEnd(&zs);
+        if (ret != Z_STREAM_END || strcmp(expected, result->buf) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static const char expected_record_str[] = "{\"id\":0,\"ok\":true}\n{\"id\":1,\"ok\":false}\n"\
+        "{\"id\":2,\"ok\":true}\n{\"id\":3,\"ok\":false}\n";
+
+static bool partial_lines;
+
+/* Each chunk should have only whole lines */
+static int flush_lines(const char *buf, size_t len, void *priv)
+{
+    if (len && buf[len - 1] != '\n') {
+        partial_lines = true;
+    }
+    return flush_str_v2(buf, len, priv);
+}
+
+static int json_gen_perform_record_test(json_gen_test_result_t *result, const char *expected)
+{
+    char buf[48];
+    json_gen_str_t jstr;
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    partial_lines = false;
+    json_gen_str_start_v2(&jstr, buf, sizeof(buf), flush_lines, result);
+    json_gen_str_set_record_aligned(&jstr, true);
+    for (int i = 0; i < 4; i++) {
+        json_gen_record_begin(&jstr);
+        json_gen_start_object(&jstr);
+        json_gen_obj_set_int(&jstr, "id", i);
+        json_gen_obj_set_bool(&jstr, "ok", i % 2 == 0);
+        json_gen_end_object(&jstr);
+        json_gen_record_end(&jstr);
+    }
+    if (json_gen_str_end(&jstr) != (int64_t)strlen(expected) + 1 || partial_lines) {
+        return -1;
+    }
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_binary_str[] = "bf616101616262787961639ff5f639012bfb3ff8000000000000ff"\
+        "61647f6261626163ffff "\
+        "df00000004a16101a162a27879a163dd00000004c3c0d1fed4cb3ff8000000000000a164db00000003616263"\
+        "df00000004a16101a162a27879a163dd00000004c3c0d1fed4cb3ff8000000000000a164db00000003616263";
+
+static void json_gen_add_binary_doc(json_gen_str_t *jstr)
+{
+	json_gen_start_object(jstr);
+	json_gen_obj_set_int(jstr, "a", 1);
+	json_gen_obj_set_string(jstr, "b", "xy");
+	json_gen_push_array(jstr, "c");
+	json_gen_arr_set_bool(jstr, true);
+	json_gen_arr_set_null(jstr);
+	json_gen_arr_set_int(jstr, -300);
+	json_gen_arr_set_double(jstr, 1.5);
+	json_gen_pop_array(jstr);
+	json_gen_obj_start_long_string(jstr, "d", "ab");
+	json_gen_add_to_long_string(jstr, "c");
+	json_gen_end_long_string(jstr);
+	json_gen_end_object(jstr);
+}
+
+static void json_gen_to_hex(json_gen_test_result_t *hex, const json_gen_test_result_t *bin)
+{
+    for (size_t i = 0; i < bin->offset && hex->offset + 2 < sizeof(hex->buf); i++) {
+        hex->offset += sprintf(hex->buf + hex->offset, "%02x", (uint8_t)bin->buf[i]);
+    }
+}
+
+static int json_gen_perform_binary_test(json_gen_test_result_t *result, const char *expected)
+{
+    json_gen_test_result_t bin = {0};
+    json_gen_str_t jstr;
+    char buf[64];
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start_v2(&jstr, buf, 16, flush_str_v2, &bin);
+    if (json_gen_str_set_format(&jstr, JSON_GEN_FORMAT_CBOR) != 0) {
+        return -1;
+    }
+    json_gen_add_binary_doc(&jstr);
+    if (json_gen_str_end(&jstr) < 0) {
+        return -1;
+    }
+    json_gen_to_hex(result, &bin);
+    result->buf[result->offset++] = ' ';
+    /* The headers of the second record are carried over to the next buffer */
+    memset(&bin, 0, sizeof(bin));
+    json_gen_str_start_v2(&jstr, buf, sizeof(buf), flush_str_v2, &bin);
+    if (json_gen_str_set_format(&jstr, JSON_GEN_FORMAT_MSGPACK) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        json_gen_record_begin(&jstr);
+        json_gen_add_binary_doc(&jstr);
+        json_gen_record_end(&jstr);
+    }
+    if (json_gen_str_end(&jstr) < 0) {
+        return -1;
+    }
+    json_gen_to_hex(result, &bin);
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+#ifndef JSON_GEN_TRUSTED
+static const char expected_invalid_str[] = "{\"arr\":[1,{\"str\":\"unterminated\"}]}";
+
+static int json_gen_perform_invalid_test(json_gen_test_result_t *result, const char *expected)
+{
+    char buf[20];
+    json_gen_str_t jstr;
+    /* A named value in an array and a mismatched end */
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+    json_gen_start_array(&jstr);
+    if (json_gen_obj_set_int(&jstr, "val", 1) != JSON_GEN_ERR_INVALID) {
+        return -1;
+    }
+    if (json_gen_str_end(&jstr) != JSON_GEN_ERR_INVALID) {
+        return -1;
+    }
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+    json_gen_start_object(&jstr);
+    json_gen_end_array(&jstr);
+    if (json_gen_str_end(&jstr) != JSON_GEN_ERR_INVALID) {
+        return -1;
+    }
+    /* Nesting beyond JSON_GEN_MAX_DEPTH */
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+    for (int i = 0; i < JSON_GEN_MAX_DEPTH; i++) {
+        json_gen_start_array(&jstr);
+    }
+    if (json_gen_start_array(&jstr) != JSON_GEN_ERR_INVALID) {
+        return -1;
+    }
+    if (json_gen_str_end(&jstr) != JSON_GEN_ERR_INVALID) {
+        return -1;
+    }
+    /* Whatever is left open gets closed at the end */
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start(&jstr, buf, sizeof(buf), flush_str, result);
+    json_gen_start_object(&jstr);
+    json_gen_push_array(&jstr, "arr");
+    json_gen_arr_set_int(&jstr, 1);
+    json_gen_start_object(&jstr);
+    json_gen_obj_start_long_string(&jstr, "str", "unter");
+    json_gen_add_to_long_string(&jstr, "minated");
+    if (json_gen_str_end(&jstr) != JSON_GEN_ERR_INVALID) {
+        return -1;
+    }
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+#endif /* JSON_GEN_TRUSTED */
+
+/* The records from the producers get interleaved arbitrarily. They are checked to be in
+ * order per producer and then sorted, for comparing with the expected string.
+ */
+static const char expected_queue_str[] = "[0,1,2,3,4,5,100,101,102,103,104,105,200,201,202,203,204,205,300,301,302,303,304,305]";
+
+#define QUEUE_TEST_PRODUCERS    4
+#define QUEUE_TEST_RECORDS      6
+
+typedef struct {
+    json_gen_queue_t *queue;
+    int producer;
+} json_gen_queue_test_t;
+
+static void *json_gen_queue_producer(void *arg)
+{
+    json_gen_queue_test_t *test = (json_gen_queue_test_t *)arg;
+    for (int i = 0; i < QUEUE_TEST_RECORDS; i++) {
+        json_gen_str_t *jstr = json_gen_queue_record_start(test->queue);
+        if (!jstr) {
+            return NULL;
+        }
+        json_gen_arr_set_int(jstr, test->producer * 100 + i);
+        json_gen_queue_push(test->queue, jstr);
+    }
+    return NULL;
+}
+
+static int json_gen_cmp_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/* Records are added in the format of the queue, and drained only into that format */
+static int json_gen_check_queue_format(void)
+{
+    json_gen_queue_config_t config = { .capacity = 2, .format = JSON_GEN_FORMAT_MSGPACK };
+    if (json_gen_queue_create(&config)) {
+        return -1;
+    }
+    config.format = JSON_GEN_FORMAT_CBOR;
+    json_gen_queue_t *queue = json_gen_queue_create(&config);
+    json_gen_str_t *rec = queue ? json_gen_queue_record_start(queue) : NULL;
+    if (!rec) {
+        json_gen_queue_destroy(queue);
+        return -1;
+    }
+    json_gen_arr_set_int(rec, 7);
+    json_gen_queue_push(queue, rec);
+    char buf[16], ref[16];
+    json_gen_str_t jstr;
+    size_t count = 0;
+    json_gen_str_start(&jstr, buf, sizeof(buf), NULL, NULL);
+    json_gen_start_array(&jstr);
+    int ret = json_gen_queue_drain(queue, &jstr, &count) == -1 && count == 0 ? 0 : -1;
+    json_gen_str_start(&jstr, buf, sizeof(buf), NULL, NULL);
+    json_gen_str_set_format(&jstr, JSON_GEN_FORMAT_CBOR);
+    json_gen_start_array(&jstr);
+    if (json_gen_queue_drain(queue, &jstr, &count) != 0 || count != 1) {
+        ret = -1;
+    }
+    json_gen_end_array(&jstr);
+    int64_t len = json_gen_str_end(&jstr);
+    json_gen_queue_destroy(queue);
+    json_gen_str_start(&jstr, ref, sizeof(ref), NULL, NULL);
+    json_gen_str_set_format(&jstr, JSON_GEN_FORMAT_CBOR);
+    json_gen_start_array(&jstr);
+    json_gen_arr_set_int(&jstr, 7);
+    json_gen_end_array(&jstr);
+    if (len <= 0 || json_gen_str_end(&jstr) != len || memcmp(buf, ref, (size_t)len) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+static int json_gen_perform_queue_test(json_gen_test_result_t *result, const char *expected)
+{
+    json_gen_queue_config_t config = { .capacity = 4 };
+    json_gen_queue_t *queue = json_gen_queue_create(&config);
+    pthread_t threads[QUEUE_TEST_PRODUCERS];
+    json_gen_queue_test_t producers[QUEUE_TEST_PRODUCERS];
+    char buf[32];
+    json_gen_str_t jstr;
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    if (!queue) {
+        return -1;
+    }
+    json_gen_str_start_v2(&jstr, buf, sizeof(buf), flush_str_v2, result);
+    json_gen_start_array(&jstr);
+    for (int i = 0; i < QUEUE_TEST_PRODUCERS; i++) {
+        producers[i].queue = queue;
+        producers[i].producer = i;
+        pthread_create(&threads[i], NULL, json_gen_queue_producer, &producers[i]);
+    }
+    size_t total = 0;
+    while (total < QUEUE_TEST_PRODUCERS * QUEUE_TEST_RECORDS) {
+        size_t count;
+        if (json_gen_queue_drain(queue, &jstr, &count) != 0) {
+            break;
+        }
+        if (!count) {
+            sched_yield();
+        }
+        total += count;
+    }
+    for (int i = 0; i < QUEUE_TEST_PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    json_gen_queue_destroy(queue);
+    json_gen_end_array(&jstr);
+    if (json_gen_str_end(&jstr) < 0 || json_gen_check_queue_format() != 0) {
+        return -1;
+    }
+    int vals[QUEUE_TEST_PRODUCERS * QUEUE_TEST_RECORDS];
+    int next[QUEUE_TEST_PRODUCERS] = {0};
+    size_t num = 0;
+    const char *p = result->buf + 1;
+    while (num < total && *p) {
+        char *end;
+        vals[num] = (int)strtol(p, &end, 10);
+        int producer = vals[num] / 100;
+        if (end == p || producer >= QUEUE_TEST_PRODUCERS || vals[num] % 100 != next[producer]++) {
+            return -1;
+        }
+        num++;
+        p = end + 1;
+    }
+    qsort(vals, num, sizeof(int), json_gen_cmp_int);
+    result->offset = 0;
+    result->buf[result->offset++] = '[';
+    for (size_t i = 0; i < num; i++) {
+        result->offset += snprintf(result->buf + result->offset, sizeof(result->buf) - result->offset,
+                i ? ",%d" : "%d", vals[i]);
+    }
+    snprintf(result->buf + result->offset, sizeof(result->buf) - result->offset, "]");
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_nb_str[] = "{\"first_bool\":true,\"my_str\":\"new_name\","\
+        "\"long\":\"abcdefghijklmnopqrstuvwxyz\"}";
+
+/* Simulates a non blocking socket, which takes a few bytes every time it is writable */
+typedef struct {
+    json_gen_test_result_t *result;
+    size_t budget;
+    int blocked;
+} json_gen_nb_writer_t;
+
+static int64_t nb_write(const char *buf, size_t len, void *priv)
+{
+    json_gen_nb_writer_t *writer = (json_gen_nb_writer_t *)priv;
+    if (len > writer->budget) {
+        len = writer->budget;
+    }
+    writer->budget -= len;
+    flush_str_v2(buf, len, writer->result);
+    return (int64_t)len;
+}
+
+/* Wait for the output to be writable, till all the data is written out */
+static int nb_wait(json_gen_str_t *jstr, json_gen_nb_writer_t *writer, int ret)
+{
+    while (ret == JSON_GEN_AGAIN) {
+        writer->blocked++;
+        writer->budget = 5;
+        ret = json_gen_str_resume(jstr);
+    }
+    return ret;
+}
+
+static int json_gen_perform_nb_test(json_gen_test_result_t *result, const char *expected)
+{
+    char buf[8];
+    json_gen_nb_writer_t writer = {result, 5, 0};
+    json_gen_str_t jstr;
+    int ret = 0;
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start_async(&jstr, buf, sizeof(buf), nb_write, &writer);
+    ret |= nb_wait(&jstr, &writer, json_gen_start_object(&jstr));
+    ret |= nb_wait(&jstr, &writer, json_gen_obj_set_bool(&jstr, "first_bool", true));
+    /* Not waiting lets the data pile up, without losing any */
+    json_gen_obj_set_string(&jstr, "my_str", "new_name");
+    ret |= nb_wait(&jstr, &writer, json_gen_obj_start_long_string(&jstr, "long", "abcdefghij"));
+    ret |= nb_wait(&jstr, &writer, json_gen_add_to_long_string(&jstr, "klmnopqrstuvwxyz"));
+    ret |= nb_wait(&jstr, &writer, json_gen_end_long_string(&jstr));
+    ret |= nb_wait(&jstr, &writer, json_gen_end_object(&jstr));
+    int64_t len;
+    while ((len = json_gen_str_end(&jstr)) == JSON_GEN_AGAIN) {
+        writer.blocked++;
+        writer.budget = 5;
+    }
+    if (ret != 0 || len != (int64_t)strlen(expected) + 1 || writer.blocked < 10) {
+        return -1;
+    }
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static const char expected_nb_name_str[] = "{\"a_fairly_long_name\":1,\"b\":2}";
+
+/* The output blocks during the name, before the value is added */
+static int json_gen_perform_nb_name_test(json_gen_test_result_t *result, const char *expected)
+{
+    char buf[16];
+    json_gen_nb_writer_t writer = {result, 0, 0};
+    json_gen_str_t jstr;
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start_async(&jstr, buf, sizeof(buf), nb_write, &writer);
+    if (json_gen_start_object(&jstr) != 0) {
+        return -1;
+    }
+    if (json_gen_obj_set_int(&jstr, "a_fairly_long_name", 1) != JSON_GEN_AGAIN ||
+            json_gen_str_backlog(&jstr) == 0) {
+        return -1;
+    }
+    /* Still reported till the data is written out */
+    if (json_gen_obj_set_int(&jstr, "b", 2) != JSON_GEN_AGAIN) {
+        return -1;
+    }
+    if (nb_wait(&jstr, &writer, JSON_GEN_AGAIN) != 0 || json_gen_str_backlog(&jstr) != 0) {
+        return -1;
+    }
+    if (json_gen_end_object(&jstr) != 0) {
+        return -1;
+    }
+    int64_t len;
+    while ((len = json_gen_str_end(&jstr)) == JSON_GEN_AGAIN) {
+        writer.budget = 5;
+    }
+    if (len != (int64_t)strlen(expected) + 1) {
+        return -1;
+    }
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+#ifndef JSON_GEN_NO_PRETTY
+static const char expected_pretty_str[] = "{\n  \"a\": [\n    1,\n    2\n  ],\n  \"b\": {},\n"\
+        "  \"c\": {\n    \"d\": true,\n    \"e\": []\n  },\n  \"id\": 7\n}";
+
+static int json_gen_perform_pretty_test(json_gen_test_result_t *result, const char *expected)
+{
+    static const json_gen_key_t key_id = JSON_GEN_KEY("id");
+    static const int32_t vals[] = {1, 2};
+    char buf[20];
+    json_gen_str_t jstr;
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start_v2(&jstr, buf, sizeof(buf), flush_str_v2, result);
+    if (json_gen_str_set_indent(&jstr, 2) != 0) {
+        return -1;
+    }
+    json_gen_start_object(&jstr);
+    json_gen_push_array(&jstr, "a");
+    json_gen_arr_set_int_array(&jstr, vals, 2);
+    json_gen_pop_array(&jstr);
+    json_gen_push_object(&jstr, "b");
+    json_gen_pop_object(&jstr);
+    json_gen_push_object(&jstr, "c");
+    json_gen_obj_set_bool(&jstr, "d", true);
+    json_gen_push_array(&jstr, "e");
+    json_gen_pop_array(&jstr);
+    json_gen_pop_object(&jstr);
+    json_gen_obj_set_int_k(&jstr, &key_id, 7);
+    json_gen_end_object(&jstr);
+    if (json_gen_str_end(&jstr) != (int64_t)strlen(expected) + 1) {
+        return -1;
+    }
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+#endif /* JSON_GEN_NO_PRETTY */
+
+#ifdef JSON_GEN_ENABLE_STATS
+static const char expected_stats_str[] = "{\"a\":[1,[2]],\"s\":\"hello world\",\"t\":\"abc\"}";
+
+static int json_gen_perform_stats_test(json_gen_test_result_t *result, const char *expected)
+{
+    char buf[16];
+    json_gen_str_t jstr;
+    json_gen_stats_t stats;
+    memset(result, 0, sizeof(json_gen_test_result_t));
+    json_gen_str_start_v2(&jstr, buf, sizeof(buf), flush_str_v2, result);
+    json_gen_start_object(&jstr);
+    json_gen_push_array(&jstr, "a");
+    json_gen_arr_set_int(&jstr, 1);
+    json_gen_start_array(&jstr);
+    json_gen_arr_set_int(&jstr, 2);
+    json_gen_end_array(&jstr);
+    json_gen_pop_array(&jstr);
+    json_gen_obj_set_string(&jstr, "s", "hello world");
+    json_gen_obj_start_long_string(&jstr, "t", "a");
+    json_gen_add_to_long_string(&jstr, "bc");
+    json_gen_end_long_string(&jstr);
+    json_gen_end_object(&jstr);
+    if (json_gen_get_stats(&jstr, &stats) != 0) {
+        return -1;
+    }
+    /* The final flush by json_gen_str_end() is not counted */
+    if (stats.bytes != strlen(expected) || stats.flushes != strlen(expected) / sizeof(buf) ||
+            stats.max_depth != 3 || stats.max_value_len != strlen("\"hello world\"") ||
+            stats.bytes_copied + stats.bytes_in_place != stats.bytes || !stats.bytes_copied) {
+        return -1;
+    }
+    if (json_gen_str_end(&jstr) != (int64_t)strlen(expected) + 1) {
+        return -1;
+    }
+    if (strcmp(expected, result->buf) == 0) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+#endif /* JSON_GEN_ENABLE_STATS */
+
+static const json_gen_test_t tests[] = {
+    {"Creating JSON string [may require Line wrap enabled on console]",
+        json_gen_perform_test, expected_str},
+    {"Creating JSON string with explicit lengths",
+        json_gen_perform_len_test, expected_len_str},
+    {"Creating JSON string with pre-rendered keys",
+        json_gen_perform_key_test, expected_key_str},
+    {"Creating JSON array of integers",
+        json_gen_perform_int_test, expected_int_str},
+    {"Creating JSON array of floats and doubles",
+        json_gen_perform_float_test, expected_float_str},
+    {"Creating JSON string from structs",
+        json_gen_perform_struct_test, expected_struct_str},
+    {"Creating JSON arrays in bulk",
+        json_gen_perform_bulk_test, expected_bulk_str},
+    {"Creating JSON string with escaping",
+        json_gen_perform_escape_test, expected_escape_str},
+    {"Creating JSON string by writing in place",
+        json_gen_perform_reserve_test, expected_reserve_str},
+    {"Creating JSON string with length carrying flush callback",
+        json_gen_perform_v2_test, expected_partial_str},
+    {"Creating JSON string with double buffering",
+        json_gen_perform_double_buf_test, expected_partial_str},
+    {"Writing JSON string to a file descriptor and FILE stream",
+        json_gen_perform_io_test, expected_partial_str},
+    {"Writing JSON string to a memory mapped file",
+        json_gen_perform_mmap_test, expected_partial_str},
+    {"Creating JSON string in a growable buffer",
+        json_gen_perform_growable_test, expected_partial_str},
+    {"Creating JSON string from a prepared document",
+        json_gen_perform_prepared_test, expected_prepared_str},
+    {"Creating JSON string from a retained document",
+        json_gen_perform_retained_test, expected_retained_str},
+    {"Splicing raw JSON without NULL termination",
+        json_gen_perform_raw_test, expected_raw_str},
+    {"Creating JSON string with base64 and hex encoded data",
+        json_gen_perform_encoded_test, expected_encoded_str},
+    {"Creating JSON object from a map with duplicate keys",
+        json_gen_perform_map_test, expected_map_str},
+    {"Creating JSON string with a size limit",
+        json_gen_perform_limit_test, expected_limit_str},
+    {"Creating JSON array in parallel",
+        json_gen_perform_par_test, expected_par_str},
+    {"Creating JSON string with a pooled generator",
+        json_gen_perform_pool_test, expected_partial_str},
+    {"Creating compressed JSON string",
+        json_gen_perform_compress_test, expected_partial_str},
+    {"Creating newline delimited JSON records",
+        json_gen_perform_record_test, expected_record_str},
+    {"Creating CBOR and MessagePack output",
+        json_gen_perform_binary_test, expected_binary_str},
+    {"Creating JSON array from a multi-producer record queue",
+        json_gen_perform_queue_test, expected_queue_str},
+    {"Writing JSON string to a non blocking output",
+        json_gen_perform_nb_test, expected_nb_str},
+    {"Reporting backpressure of a non blocking output within a name",
+        json_gen_perform_nb_name_test, expected_nb_name_str},
+#ifndef JSON_GEN_NO_PRETTY
+    {"Creating pretty printed JSON string",
+        json_gen_perform_pretty_test, expected_pretty_str},
+#endif
+#ifndef JSON_GEN_TRUSTED
+    {"Closing an invalid JSON string",
+        json_gen_perform_invalid_test, expected_invalid_str},
+#endif
+#ifdef JSON_GEN_ENABLE_STATS
+    {"Collecting JSON string stats",
+        json_gen_perform_stats_test, expected_stats_str},
+#endif
+};
+
+int main(int argc, char **argv)
+{
+    json_gen_test_result_t result;
+    int ret = 0;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        printf("%s\r\n", tests[i].title);
+        int test_ret = tests[i].perform(&result, tests[i].expected);
+        printf("Expected: %s\r\n", tests[i].expected);
+        printf("Generated: %s\r\n", result.buf);
+        if (test_ret == 0) {
+            printf("Test Passed!\r\n");
+        } else {
+            printf("Test Failed!\r\n");
+            ret = test_ret;
+        }
     }
 	return ret;
 }
@@ -0,0 +1,226 @@
+/*
+ *    Copyright 2020 Piyush Shah <shahpiyushv@gmail.com>
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <cstdio>
+#include <array>
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <json_generator.hpp>
+#ifdef JSON_GEN_HAVE_COROUTINES
+#include <functional>
+#endif
+
+namespace {
+
+struct point {
+    int32_t x;
+    int32_t y;
+};
+
+constexpr auto x_key = json_gen::make_key("x");
+constexpr auto y_key = json_gen::make_key("y");
+
+} /* namespace */
+
+template <>
+struct json_gen::serializer<point> {
+    static int write(json_gen::writer &w, const point &p)
+    {
+        auto obj = w.object();
+        w.set(x_key, p.x);
+        return w.set(y_key, p.y);
+    }
+};
+
+static const char expected_cpp_str[] = "{\"id\":7,\"big\":18446744073709551615,\"ok\":true,"
+        "\"temp\":25.5,\"ratio\":0.25000,\"name\":\"probe\",\"view\":\"abc\",\"unit\":null,"
+        "\"limit\":3,\"ints\":[1,2,3],\"pts\":[{\"x\":1,\"y\":2},{\"x\":3,\"y\":4}],"
+        "\"origin\":{\"x\":0,\"y\":0},\"words\":[\"a\",null,\"b\"],\"nested\":{\"flags\":[true,false],"
+        "\"lists\":[[1.5],[]]},\"raw\":[-1,null]}";
+
+static std::string json_gen_cpp_test()
+{
+    constexpr auto temp_key = json_gen::make_key("temp");
+    constexpr auto nested_key = json_gen::make_key("nested");
+    static_assert(temp_key.name() == "temp", "Key should be rendered at compile time");
+    const std::string name = "probe";
+    const char view_buf[] = "abcdef";
+
+    json_gen_str_t jstr;
+    json_gen_growable_t gbuf;
+    if (json_gen_str_start_growable(&jstr, &gbuf, 16, nullptr) != 0) {
+        return std::string();
+    }
+    json_gen::writer w(jstr);
+    {
+        auto obj = w.object();
+        w.set("id", 7);
+        w.set("big", UINT64_MAX);
+        w.set("ok", true);
+        w.set(temp_key, 25.5);
+        w.set("ratio", 0.25f);
+        w.set("name", name);
+        w.set("view", std::string_view(view_buf, 3));
+        w.set("unit", std::optional<std::string_view>{});
+        w.set("limit", std::optional<int>{3});
+        w.set("ints", std::vector<int32_t>{1, 2, 3});
+        w.set("pts", std::array<point, 2>{{{1, 2}, {3, 4}}});
+        w.set("origin", point{0, 0});
+        w.set("words", std::vector<const char *>{"a", nullptr, "b"});
+        {
+            auto nested = w.object(nested_key);
+            w.set("flags", std::vector<bool>{true, false});
+            w.set("lists", std::list<std::vector<double>>{{1.5}, {}});
+        }
+        auto raw = w.array("raw");
+        w.write(-1);
+        w.write(nullptr);
+    }
+    size_t len;
+    char *str = json_gen_str_end_growable(&jstr, &len);
+    if (!str) {
+        return std::string();
+    }
+    std::string ret(str, len);
+    free(str);
+    return ret;
+}
+
+#ifdef JSON_GEN_HAVE_COROUTINES
+namespace {
+
+/* Coroutine started eagerly, which just runs till it completes */
+struct task {
+    struct promise_type {
+        task get_return_object()
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception()
+        {
+            std::abort();
+        }
+    };
+};
+
+/* Simulates an event loop over a non blocking socket, which takes a few bytes every
+ * time it is writable
+ */
+struct nb_loop {
+    std::string out;
+    std::size_t budget = 0;
+    std::vector<std::function<void()>> pending;
+
+    void run()
+    {
+        while (!pending.empty()) {
+            auto writable = pending.back();
+            pending.pop_back();
+            budget = 5;
+            writable();
+        }
+    }
+};
+
+int64_t nb_write(const char *buf, size_t len, void *priv)
+{
+    auto *loop = static_cast<nb_loop *>(priv);
+    len = len < loop->budget ? len : loop->budget;
+    loop->budget -= len;
+    loop->out.append(buf, len);
+    return static_cast<int64_t>(len);
+}
+
+task json_gen_cpp_nb_encode(json_gen_str_t &jstr, nb_loop &loop, int64_t &ret)
+{
+    auto wait = [&loop](auto writable) { loop.pending.push_back(writable); };
+    json_gen::writer w(jstr);
+    {
+        auto obj = w.object();
+        w.set("pts", std::vector<point>{{1, 2}, {3, 4}});
+        ret = co_await json_gen::drain(jstr, wait);
+        w.set("name", "a long enough string");
+    }
+    ret |= co_await json_gen::end(jstr, wait);
+}
+
+} /* namespace */
+
+static std::string json_gen_cpp_nb_test()
+{
+    char buf[8];
+    nb_loop loop;
+    int64_t ret = -1;
+    json_gen_str_t jstr;
+    json_gen_str_start_async(&jstr, buf, sizeof(buf), nb_write, &loop);
+    json_gen_cpp_nb_encode(jstr, loop, ret);
+    loop.run();
+    return ret == static_cast<int64_t>(loop.out.size()) + 1 ? loop.out : std::string();
+}
+#endif /* JSON_GEN_HAVE_COROUTINES */
+
+int main(int argc, char **argv)
+{
+    int ret = 0;
+    printf("Creating JSON string with the C++ wrapper\r\n");
+    std::string generated = json_gen_cpp_test();
+    printf("Expected: %s\r\n", expected_cpp_str);
+    printf("Generated: %s\r\n", generated.c_str());
+    if (generated == expected_cpp_str) {
+        printf("Test Passed!\r\n");
+    } else {
+        printf("Test Failed!\r\n");
+        ret = -1;
+    }
+
+    printf("Serializing with json_gen::to_string()\r\n");
+    generated = json_gen::to_string(std::vector<point>{{5, 6}});
+    const char *expected = "[{\"x\":5,\"y\":6}]";
+    printf("Expected: %s\r\n", expected);
+    printf("Generated: %s\r\n", generated.c_str());
+    if (generated == expected) {
+        printf("Test Passed!\r\n");
+    } else {
+        printf("Test Failed!\r\n");
+        ret = -1;
+    }
+#ifdef JSON_GEN_HAVE_COROUTINES
+    printf("Writing to a non blocking output from a coroutine\r\n");
+    generated = json_gen_cpp_nb_test();
+    expected = "{\"pts\":[{\"x\":1,\"y\":2},{\"x\":3,\"y\":4}],\"name\":\"a long enough string\"}";
+    printf("Expected: %s\r\n", expected);
+    printf("Generated: %s\r\n", generated.c_str());
+    if (generated == expected) {
+        printf("Test Passed!\r\n");
+    } else {
+        printf("Test Failed!\r\n");
+        ret = -1;
+    }
+#endif
+    return ret;
+}